@@ -1,10 +1,11 @@
 # Import from internal C++ module
-from ._internal import rehline_internal, rehline_result
+from ._internal import rehline_internal, rehline_result, rehline_result_float32
 
 from ._loss import ReHLoss
-from ._class import ReHLine, ReHLine_solver
-from ._base import relu, rehu, make_fair_classification
+from ._class import ReHLine, ReHLine_solver, ReHLine_batch_solver, ReHLine_lane_solver, ReHLine_path_solver, ReHLine_persistent
+from ._distributed import ReHLine_distributed, rehline_worker, SocketTransport
+from ._base import relu, rehu, make_fair_classification, load_memmap, ReplicatedDesign, CompressedParam
 
-__all__ = ("ReHLine",
+__all__ = ("ReHLine", "ReHLine_distributed",
            "ReHLoss", 
-           "make_fair_classification", "relu", "rehu")
\ No newline at end of file
+           "make_fair_classification", "relu", "rehu", "load_memmap")
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 # License: MIT License
 
+import os
 import numpy as np
 from scipy.special import huber
 from sklearn.datasets import make_classification
@@ -98,4 +99,323 @@ def make_fair_classification(n_samples=100, n_features=5, ind_sensitive=0):
 
     X_sen = X[:, ind_sensitive]
 
-    return X, y, X_sen
\ No newline at end of file
+    return X, y, X_sen
+
+def load_memmap(path, shape=None, dtype=np.float64):
+    """
+    Open a data matrix stored on disk as a read-only memory map, without loading it into RAM.
+
+    Two formats are supported:
+
+    * `.npy` files written by `numpy.save` in C order (`shape` is not needed);
+    * raw binary files, holding the `n_samples * n_features` values of the matrix in
+      row-major (C) order with no header, in native byte order; `shape` must be given.
+
+    The returned array can be passed to `ReHLine.fit` (or set as `U`, `V`, `S`, `T`, `Tau`),
+    and the solver reads it in place.
+
+    Parameters
+    ----------
+    path : str or path-like
+        The file path.
+
+    shape : tuple of (n_samples, n_features), default=None
+        The shape of a raw binary file.
+
+    dtype : {np.float64, np.float32}, default=np.float64
+        The value type of a raw binary file.
+
+    Returns
+    -------
+    np.memmap of shape (n_samples, n_features)
+    """
+    path = os.fspath(path)
+    if shape is None:
+        X = np.load(path, mmap_mode='r')
+    else:
+        X = np.memmap(path, dtype=dtype, mode='r', shape=tuple(shape))
+    _check_memmap(X)
+    return X
+
+def _check_memmap(X):
+    # The solver references a C-ordered float64 or float32 array in place; other
+    # memory-mapped arrays would be silently copied into RAM
+    if isinstance(X, np.memmap):
+        if (not X.flags.c_contiguous) or (X.dtype not in (np.float64, np.float32)):
+            raise ValueError("a memory-mapped array must be C-ordered with dtype float64 or float32, "
+                             "otherwise it would be copied into memory")
+
+def _check_in_place(X, c_order=False):
+    # In the strict mode, X must be referenced by the solver without a copy: a float64
+    # or float32 array of any memory layout (with contiguous rows of float64 if
+    # c_order), or a CSR matrix of float64 or float32 with int32 indices
+    if hasattr(X, 'format') and hasattr(X, 'indptr'):
+        ok = (X.format == 'csr' and X.data.dtype in (np.float64, np.float32) and
+              X.indices.dtype == np.int32 and X.indptr.dtype == np.int32)
+    else:
+        ok = isinstance(X, np.ndarray) and X.ndim == 2 and X.dtype in (np.float64, np.float32)
+        if ok and c_order:
+            ok = X.dtype == np.float64 and (X.shape[1] <= 1 or X.strides[1] == X.itemsize)
+    if not ok:
+        raise ValueError("X would be copied before being passed to the solver (strict=True); "
+                         "pass a float64 or float32 array, or a CSR matrix with int32 indices")
+
+class ReplicatedDesign(object):
+    """
+    The design matrix of multi-quantile regression, without being materialized.
+
+    It represents the `(n_samples * n_qt, n_features + n_qt)` matrix
+    `[X, e_1; X, e_2; ...; X, e_{n_qt}]`, where `X` is repeated for each quantile and
+    `e_l` is the indicator column of the intercept of the l-th quantile. The solver
+    reads `X` in place, so the memory is that of `X` instead of `n_qt` copies of it.
+    It is returned by `ReHLine.make_ReLHLoss` for the check loss.
+
+    Parameters
+    ----------
+    X : {array-like, sparse matrix} of shape (n_samples, n_features)
+        The data matrix.
+
+    n_qt : int
+        The number of quantiles.
+    """
+
+    def __init__(self, X, n_qt):
+        self.X = X
+        self.n_qt = n_qt
+
+    @property
+    def shape(self):
+        n, d = self.X.shape
+        return (n * self.n_qt, d + self.n_qt)
+
+    def dot(self, coef):
+        """The scores `[X, e_l] @ coef` of all quantiles, stacked by quantile."""
+        d = self.X.shape[1]
+        score = self.X @ coef[:d]
+        return np.concatenate([score + coef[d + l] for l in range(self.n_qt)])
+
+    def toarray(self):
+        """The materialized design matrix."""
+        n, d = self.X.shape
+        X = self.X.toarray() if hasattr(self.X, 'toarray') else np.asarray(self.X)
+        X_fake = np.zeros(self.shape, dtype=X.dtype)
+        for l in range(self.n_qt):
+            X_fake[l*n:(l+1)*n, :d] = X
+            X_fake[l*n:(l+1)*n, d+l] = 1.
+        return X_fake
+
+    def __array__(self, dtype=None, copy=None):
+        X_fake = self.toarray()
+        return X_fake if dtype is None else X_fake.astype(dtype)
+
+class CompressedParam(object):
+    """
+    A loss parameter matrix (`U`, `V`, `S`, `T`, or `Tau`) in a compressed form.
+
+    The matrix of shape `(n_rows, n_samples)` is `M[l, i] = coef[l] * vec[i] + offset[l]`,
+    which covers a scalar, a constant for each row (e.g. `V = C` of the SVM), and
+    rank-one matrices (e.g. `U = -C * y` of the SVM) with `O(n_rows + n_samples)`
+    memory. The solver reads the compressed form directly.
+
+    Parameters
+    ----------
+    shape : tuple of (n_rows, n_samples)
+        The shape of the matrix.
+
+    coef : array-like of shape (n_rows,), default=None
+        The coefficients of `vec` in each row, zero by default.
+
+    vec : array-like of shape (n_samples,), default=None
+        The per-sample vector, or None if the matrix is constant in each row.
+
+    offset : array-like of shape (n_rows,), default=None
+        The constant of each row, zero by default.
+    """
+
+    __array_priority__ = 20
+
+    def __init__(self, shape, coef=None, vec=None, offset=None, dtype=np.float64):
+        rows, cols = shape
+        self.shape = (rows, cols)
+        self.coef = np.zeros(rows, dtype=dtype) if coef is None else np.asarray(coef, dtype=dtype).reshape(rows)
+        self.vec = None if vec is None else np.asarray(vec, dtype=dtype).reshape(cols)
+        self.offset = np.zeros(rows, dtype=dtype) if offset is None else np.asarray(offset, dtype=dtype).reshape(rows)
+
+    @property
+    def dtype(self):
+        return self.offset.dtype
+
+    def astype(self, dtype):
+        return CompressedParam(self.shape, self.coef, self.vec, self.offset, dtype=dtype)
+
+    def toarray(self):
+        """The materialized matrix."""
+        M = np.repeat(self.offset[:, np.newaxis], self.shape[1], axis=1)
+        if self.vec is not None:
+            M += np.outer(self.coef, self.vec)
+        return M
+
+    def __array__(self, dtype=None, copy=None):
+        M = self.toarray()
+        return M if dtype is None else M.astype(dtype)
+
+    def __getitem__(self, key):
+        return self.toarray()[key]
+
+    def __mul__(self, w):
+        # Scaling by a scalar or by a per-sample weight keeps the compressed form
+        # when possible, e.g. for sample weights
+        w = np.asarray(w, dtype=self.dtype)
+        if w.ndim == 0:
+            return CompressedParam(self.shape, self.coef * w, self.vec, self.offset * w, dtype=self.dtype)
+        if w.shape == (self.shape[1],):
+            if self.vec is None:
+                return CompressedParam(self.shape, self.offset, w, None, dtype=self.dtype)
+            if not np.any(self.offset):
+                return CompressedParam(self.shape, self.coef, self.vec * w, None, dtype=self.dtype)
+        return self.toarray() * w
+
+    __rmul__ = __mul__
+
+
+def _compress_param(M):
+    # A dense parameter matrix that is constant in each row, or whose rows are all
+    # affine in one of them (e.g. U = [-C * y; C * y]), is passed to the solver in
+    # the compressed form, which is only used if it reproduces M exactly
+    if type(M) is not np.ndarray or M.ndim != 2 or M.shape[1] < 2:
+        return M
+    const = (M == M[:, :1]).all(axis=1)
+    if const.all():
+        return CompressedParam(M.shape, offset=M[:, 0], dtype=M.dtype)
+    if M.shape[0] < 2:
+        return M
+    vec = M[np.argmin(const)]
+    k = np.argmax(vec != vec[0])
+    with np.errstate(all='ignore'):
+        coef = (M[:, k] - M[:, 0]) / (vec[k] - vec[0])
+        offset = M[:, 0] - coef * vec[0]
+    coef[const] = 0
+    offset[const] = M[const, 0]
+    P = CompressedParam(M.shape, coef, vec, offset, dtype=M.dtype)
+    return P if np.array_equal(P.toarray(), M) else M
+
+
+def _param_form(M):
+    if isinstance(M, CompressedParam):
+        return 'constant' if M.vec is None else 'rank-1'
+    return 'dense'
+
+
+def _param_rows(M, rows):
+    # The given rows of a parameter matrix, in the same form
+    if len(rows) == 0:
+        return np.empty(shape=(0, 0))
+    if isinstance(M, CompressedParam):
+        return CompressedParam((len(rows), M.shape[1]), M.coef[rows], M.vec, M.offset[rows], dtype=M.dtype)
+    return M[rows]
+
+
+def _param_row(M, l):
+    if isinstance(M, CompressedParam):
+        row = np.full(M.shape[1], M.offset[l], dtype=M.dtype)
+        if M.vec is not None:
+            row += M.coef[l] * M.vec
+        return row
+    return np.asarray(M[l])
+
+
+def _zero_rows(M):
+    # Rows of a parameter matrix that are all zero; memory-mapped matrices are
+    # not scanned
+    if isinstance(M, CompressedParam):
+        no_vec = (M.coef == 0) if M.vec is not None and M.vec.any() else np.ones(M.shape[0], dtype=bool)
+        return (M.offset == 0) & no_vec
+    if type(M) is np.ndarray and M.ndim == 2 and M.shape[1] > 0:
+        return ~M.any(axis=1)
+    return np.zeros(np.shape(M)[0], dtype=bool)
+
+
+def _plan_loss(U, V, S, T, Tau):
+    """Choose the representation of the loss parameters passed to the solver.
+
+    The inputs are inspected once:
+
+    - A ReLU term with `U[l] = 0` is the constant `relu(V[l])`, and a ReHU term with
+      `S[h] = 0` or `Tau[h] = 0` is the constant `rehu(T[h], Tau[h])`; these terms are
+      dropped from the problem, and their optimal dual variables are filled in the
+      result by `_unplan_result()`.
+    - Rows that are constant, including an infinite `Tau` (a ReHU term that is
+      quadratic on the positive side), or affine in a common vector are compressed,
+      see `_compress_param`.
+
+    Returns the parameters and the plan, a dict recording the kept and dropped rows
+    and the form of each parameter.
+    """
+    U, V, S, T, Tau = [_compress_param(M) for M in (U, V, S, T, Tau)]
+    L, H = U.shape[0], S.shape[0]
+    drop_relu = _zero_rows(U) if L > 0 else np.zeros(0, dtype=bool)
+    drop_rehu = (_zero_rows(S) | _zero_rows(Tau)) if H > 0 else np.zeros(0, dtype=bool)
+    plan = {'relu_rows': np.flatnonzero(~drop_relu), 'rehu_rows': np.flatnonzero(~drop_rehu),
+            'dropped_relu': np.flatnonzero(drop_relu), 'dropped_rehu': np.flatnonzero(drop_rehu)}
+    if drop_relu.any():
+        U, V = [_param_rows(M, plan['relu_rows']) for M in (U, V)]
+    if drop_rehu.any():
+        S, T, Tau = [_param_rows(M, plan['rehu_rows']) for M in (S, T, Tau)]
+    # ReHU terms with an infinite Tau, whose upper bound of Gamma is never active
+    if isinstance(Tau, CompressedParam):
+        plan['unbounded_rehu'] = plan['rehu_rows'][np.isinf(Tau.offset) & (Tau.coef == 0)]
+    else:
+        plan['unbounded_rehu'] = np.empty(0, dtype=int)
+    for key, M in zip(('U', 'V', 'S', 'T', 'Tau'), (U, V, S, T, Tau)):
+        plan[key] = _param_form(M)
+    return U, V, S, T, Tau, plan
+
+
+def _unplan_result(result, plan, U, V, S, T, Tau):
+    """Fill the dual variables and the objective function values of the terms
+    dropped by `_plan_loss`, given the original parameters."""
+    if len(plan['dropped_relu']) == 0 and len(plan['dropped_rehu']) == 0:
+        return result
+    const = 0.
+    if len(plan['dropped_relu']) > 0:
+        Lambda = np.zeros(U.shape, dtype=result.Lambda.dtype)
+        if len(plan['relu_rows']) > 0:
+            Lambda[plan['relu_rows']] = result.Lambda
+        for l in plan['dropped_relu']:
+            v = _param_row(V, l)
+            Lambda[l] = v > 0
+            const += relu(v).sum()
+        result.Lambda = Lambda
+    if len(plan['dropped_rehu']) > 0:
+        Gamma = np.zeros(S.shape, dtype=result.Gamma.dtype)
+        if len(plan['rehu_rows']) > 0:
+            Gamma[plan['rehu_rows']] = result.Gamma
+        for h in plan['dropped_rehu']:
+            t, tau = _param_row(T, h), _param_row(Tau, h)
+            # S[h] = 0 or Tau[h] = 0, so that the loss term is rehu(t)
+            Gamma[h] = np.clip(t, 0, tau)
+            const += rehu(t, tau).sum()
+        result.Gamma = Gamma
+    # The dropped terms are constant in the primal, and their dual terms are
+    # at the optimum; dual_objfns is the negative dual objective
+    result.primal_objfns = [obj + const for obj in result.primal_objfns]
+    result.dual_objfns = [obj - const for obj in result.dual_objfns]
+    return result
+
+def _warm_start_result(result, init, plan, K):
+    """Copy the variables of a previous result `init` into the empty `result`,
+    which the solver then uses as its initial values. The dual variables are
+    restricted to the terms kept by `_plan_loss`, and are only copied if they
+    have as many rows as the original parameters; the solver derives them from
+    beta if they do not match the problem otherwise."""
+    if init is None:
+        return result
+    result.beta = np.asarray(init.beta, dtype=result.beta.dtype)
+    Lambda, Gamma, xi = np.asarray(init.Lambda), np.asarray(init.Gamma), np.asarray(init.xi)
+    L = len(plan['relu_rows']) + len(plan['dropped_relu'])
+    H = len(plan['rehu_rows']) + len(plan['dropped_rehu'])
+    if Lambda.shape[0] == L and Gamma.shape[0] == H and xi.shape == (K,):
+        result.Lambda = Lambda[plan['relu_rows']]
+        result.Gamma = Gamma[plan['rehu_rows']]
+        result.xi = xi
+    return result
@@ -5,21 +5,459 @@
 
 # License: MIT License
 
+import os
 import numpy as np
+from scipy import sparse
 from sklearn.base import BaseEstimator
 from sklearn.utils.validation import check_X_y, check_array, check_is_fitted
-from ._base import relu, rehu
-from ._internal import rehline_internal, rehline_result
+from ._base import relu, rehu, load_memmap, _check_memmap, _check_in_place, ReplicatedDesign
+from ._base import CompressedParam, _compress_param, _plan_loss, _unplan_result, _warm_start_result
+from ._internal import rehline_internal, rehline_internal_quantized, rehline_internal_stream
+from ._internal import rehline_internal_replicated, rehline_batch, rehline_internal_lanes
+from ._internal import rehline_internal_path, rehline_persistent, rehline_persistent_sparse
+from ._internal import rehline_result, rehline_result_float32
+
+def _as_float32(M):
+    if isinstance(M, CompressedParam):
+        return M.astype(np.float32)
+    return np.asarray(M, dtype=np.float32)
+
+# (L, H) of the hinge, check, smoothed hinge, and Huber losses
+_SPECIALIZED_LH = ((1, 0), (2, 0), (0, 1), (0, 2))
+
+def _plan_kernel(fused, U, S, plan):
+    # The fused updates have kernels specialized for the (L, H) of the built-in losses
+    LH = (U.shape[0], S.shape[0])
+    if fused is None:
+        fused = LH in _SPECIALIZED_LH
+    if not fused:
+        plan['kernel'] = 'unfused'
+    else:
+        plan['kernel'] = 'fused, L=%d, H=%d' % LH if LH in _SPECIALIZED_LH else 'fused, generic'
+    return fused
 
 def ReHLine_solver(X, U, V,
         Tau=np.empty(shape=(0, 0)),
         S=np.empty(shape=(0, 0)), T=np.empty(shape=(0, 0)),
         A=np.empty(shape=(0, 0)), b=np.empty(shape=(0)),
-        max_iter=1000, tol=1e-4, shrink=1, verbose=1, trace_freq=100):
+        max_iter=1000, tol=1e-4, shrink=1, verbose=1, trace_freq=100,
+        fused=False, n_jobs=1, sync=False, x_storage=None, block_size=0, l1_pen=0., strict=False,
+        warm_start=None, screening=True):
+    # X is referenced by the solver in any memory layout; in the strict mode, an X
+    # that would be copied or converted raises an error instead
+    if strict:
+        _check_in_place(X.X if isinstance(X, ReplicatedDesign) else X, c_order=x_storage is not None)
+    # The L1 penalty is passed as a vector of length n_features, or an empty
+    # vector if there is no L1 penalty
+    l1_pen = np.asarray(l1_pen, dtype=float)
+    if np.any(l1_pen < 0):
+        raise ValueError("l1_pen must be non-negative")
+    if np.any(l1_pen > 0):
+        l1_pen = np.broadcast_to(l1_pen, (X.shape[1],)).copy()
+    else:
+        l1_pen = np.empty(shape=(0))
+    # U, V, S, T, and Tau can be dense arrays or CompressedParam objects
+    # Terms that are constant are dropped, and the parameters are compressed when
+    # possible, see _plan_loss()
+    params = (U, V, S, T, Tau)
+    U, V, S, T, Tau, plan = _plan_loss(U, V, S, T, Tau)
+    fused = _plan_kernel(fused, U, S, plan)
+    # warm_start is a previous result, whose variables are copied into the new
+    # result and used as the initial values (see _warm_start_result)
+    K = np.shape(A)[0]
+    # The design of multi-quantile regression, whose X is passed once
+    if isinstance(X, ReplicatedDesign):
+        if x_storage is not None:
+            raise ValueError("x_storage is not supported for a ReplicatedDesign")
+        Xb = X.X.tocsr() if sparse.issparse(X.X) else X.X
+        if getattr(Xb, 'dtype', None) == np.float32:
+            result = _warm_start_result(rehline_result_float32(), warm_start, plan, K)
+            U, V, Tau, S, T, A, b, l1_pen = [_as_float32(M) for M in (U, V, Tau, S, T, A, b, l1_pen)]
+        else:
+            result = _warm_start_result(rehline_result(), warm_start, plan, K)
+        rehline_internal_replicated(result, Xb, X.n_qt, A, b, U, V, S, T, Tau, max_iter, tol, shrink,
+                                    verbose, trace_freq, fused, n_jobs, sync, block_size, l1_pen,
+                                    warm_start is not None, screening)
+    # X is quantized to a lower precision, and the solver works in double
+    elif x_storage is not None:
+        if sparse.issparse(X):
+            raise ValueError("x_storage is only supported for a dense X")
+        result = _warm_start_result(rehline_result(), warm_start, plan, K)
+        rehline_internal_quantized(result, X, A, b, U, V, S, T, Tau, max_iter, tol, shrink, verbose,
+                                   trace_freq, fused, n_jobs, sync, block_size, l1_pen, x_storage,
+                                   warm_start is not None, screening)
+    else:
+        # A float32 X is solved in single precision, and the other inputs are
+        # converted to float32 so that X is passed without a copy
+        if getattr(X, 'dtype', None) == np.float32:
+            result = _warm_start_result(rehline_result_float32(), warm_start, plan, K)
+            U, V, Tau, S, T, A, b, l1_pen = [_as_float32(M) for M in (U, V, Tau, S, T, A, b, l1_pen)]
+        else:
+            result = _warm_start_result(rehline_result(), warm_start, plan, K)
+        rehline_internal(result, X, A, b, U, V, S, T, Tau, max_iter, tol, shrink, verbose, trace_freq,
+                         fused, n_jobs, sync, block_size, l1_pen, warm_start is not None, screening)
+    result = _unplan_result(result, plan, *params)
+    result.plan = plan
+    return result
+
+def ReHLine_batch_solver(problems, max_iter=1000, tol=1e-4, shrink=1, verbose=0,
+        trace_freq=100, fused=None, n_jobs=1):
+    # Each problem is a dict with the arguments X, U, V, and optionally Tau, S, T,
+    # A, and b of ReHLine_solver(), and the problems are solved in one call by a pool
+    # of n_jobs threads, each problem on a single thread, starting from the largest
+    # ones; a dense X shared by several problems is converted only once
+    # The problems are solved in double precision, and X is dense or sparse
+    batch, plans = [], []
+    for prob in problems:
+        X = prob['X']
+        if isinstance(X, ReplicatedDesign):
+            raise ValueError("a ReplicatedDesign is not supported in a batch")
+        if sparse.issparse(X):
+            X = X.tocsr()
+        params = (prob['U'], prob['V'], prob.get('S', np.empty(shape=(0, 0))),
+                  prob.get('T', np.empty(shape=(0, 0))), prob.get('Tau', np.empty(shape=(0, 0))))
+        U, V, S, T, Tau, plan = _plan_loss(*params)
+        A = prob.get('A', np.empty(shape=(0, 0)))
+        b = prob.get('b', np.empty(shape=(0)))
+        batch.append((X, A, b, U, V, S, T, Tau, _plan_kernel(fused, U, S, plan)))
+        plans.append((plan, params))
+    results = rehline_batch(batch, max_iter, tol, shrink, verbose, trace_freq, n_jobs)
+    for k, (plan, params) in enumerate(plans):
+        results[k] = _unplan_result(results[k], plan, *params)
+        results[k].plan = plan
+    return results
+
+def ReHLine_lane_solver(X, losses,
+        A=np.empty(shape=(0, 0)), b=np.empty(shape=(0)),
+        max_iter=1000, tol=1e-4, verbose=0, trace_freq=100):
+    # The problems share X, A, and b, and losses is a list of dicts with the loss
+    # parameters U, V, and optionally Tau, S, and T of each problem, e.g., a grid
+    # of C values or the one-vs-rest problems of a multiclass classification
+    # The problems are solved together in lanes, with each row of X read once per
+    # sample for all of them; the lanes visit the samples in the cyclic order of
+    # shrink=0, and their objective function values are not recorded
+    # The problems are solved in double precision, and X is dense or sparse
+    if sparse.issparse(X):
+        X = X.tocsr()
+    planned, plans = [], []
+    for loss in losses:
+        params = (loss['U'], loss['V'], loss.get('S', np.empty(shape=(0, 0))),
+                  loss.get('T', np.empty(shape=(0, 0))), loss.get('Tau', np.empty(shape=(0, 0))))
+        U, V, S, T, Tau, plan = _plan_loss(*params)
+        plan['kernel'] = 'lanes'
+        planned.append((U, V, S, T, Tau))
+        plans.append((plan, params))
+    if len(set((P[0].shape[0], P[2].shape[0]) for P in planned)) > 1:
+        raise ValueError("the losses of the lanes must have the same numbers of ReLU and ReHU terms")
+    U, V, S, T, Tau = [list(P) for P in zip(*planned)] if planned else [[]] * 5
+    results = rehline_internal_lanes(X, A, b, U, V, S, T, Tau, max_iter, tol, verbose, trace_freq)
+    for k, (plan, params) in enumerate(plans):
+        results[k] = _unplan_result(results[k], plan, *params)
+        results[k].plan = plan
+    return results
+
+def ReHLine_path_solver(X, U, V,
+        Tau=np.empty(shape=(0, 0)),
+        S=np.empty(shape=(0, 0)), T=np.empty(shape=(0, 0)),
+        A=np.empty(shape=(0, 0)), b=np.empty(shape=(0)),
+        scales=(1.,), max_iter=1000, tol=1e-4, shrink=1, verbose=0, trace_freq=100,
+        fused=None, n_jobs=1):
+    # The path of the problems with the loss parameters c * U, c * V, sqrt(c) * S,
+    # sqrt(c) * T, and sqrt(c) * Tau for each c in scales, which is how the losses
+    # of ReHLine depend on C; each problem is warm-started from the previous one,
+    # so scales is best given in increasing order
+    # The problems are solved in double precision, and X is dense or sparse
+    scales = [float(c) for c in scales]
+    if any(not c > 0 for c in scales):
+        raise ValueError("the scales of the path must be positive")
+    if sparse.issparse(X):
+        X = X.tocsr()
+    params = (U, V, S, T, Tau)
+    U, V, S, T, Tau, plan = _plan_loss(U, V, S, T, Tau)
+    fused = _plan_kernel(fused, U, S, plan)
+    results = rehline_internal_path(X, A, b, U, V, S, T, Tau, scales, max_iter, tol, shrink,
+                                    verbose, trace_freq, fused, n_jobs)
+    # The dropped terms are filled with the parameters of each scale
+    for k, c in enumerate(scales):
+        sc = np.sqrt(c)
+        scaled = (params[0] * c, params[1] * c, params[2] * sc, params[3] * sc, params[4] * sc)
+        results[k] = _unplan_result(results[k], plan, *scaled)
+        results[k].plan = plan
+    return results
+
+def ReHLine_stream_solver(X, U, V,
+        Tau=np.empty(shape=(0, 0)),
+        S=np.empty(shape=(0, 0)), T=np.empty(shape=(0, 0)),
+        A=np.empty(shape=(0, 0)), b=np.empty(shape=(0)),
+        stream_rows=10000, max_iter=1000, tol=1e-4, n_epochs=1, shrink=1,
+        verbose=1, trace_freq=100):
+    # X is a memory map returned by load_memmap(), whose file is read by the
+    # solver in blocks of stream_rows rows, with the next block prefetched
+    # in the background; X itself is never accessed through the memory map
+    # As in ReHLine_solver, shrink = 0 turns off the shrinking of the free variable
+    # sets, and a positive shrink is also the seed of the random visit order
+    if not (isinstance(X, np.memmap) and X.filename is not None and X.flags.c_contiguous):
+        raise ValueError("streaming requires X to be a C-ordered memory map, see load_memmap()")
+    if X.dtype not in (np.float64, np.float32):
+        raise ValueError("streaming requires X to have dtype float64 or float32")
+    n, d = X.shape
+    if os.path.getsize(X.filename) < X.offset + X.nbytes:
+        raise ValueError("the data file is shorter than the shape of X")
     result = rehline_result()
-    rehline_internal(result, X, A, b, U, V, S, T, Tau, max_iter, tol, shrink, verbose, trace_freq)
+    rehline_internal_stream(result, X.filename, X.offset, n, d, X.dtype.itemsize,
+                            A, b, U, V, S, T, Tau, stream_rows, max_iter, tol, n_epochs, shrink,
+                            verbose, trace_freq)
     return result
 
+def _check_sample_weight(sample_weight, n):
+    sample_weight = np.asarray(sample_weight, dtype=float)
+    if sample_weight.shape != (n,):
+        raise ValueError("sample_weight must have shape (n_samples, )")
+    if np.any(sample_weight < 0):
+        raise ValueError("sample_weight must be non-negative")
+    return sample_weight
+
+def _weight_params(params, w):
+    # Same weighting as ReHLine._weighted_params(), which keeps the compressed
+    # form of the parameters when possible
+    U, V, S, T, Tau = params
+    if w is not None:
+        sqrt_w = np.sqrt(w)
+        if U.shape[0] > 0:
+            U, V = U * w, V * w
+        if S.shape[0] > 0:
+            S, T, Tau = S * sqrt_w, T * sqrt_w, Tau * sqrt_w
+    return U, V, S, T, Tau
+
+def _join_columns(blocks):
+    # A loss parameter given in column blocks, see ReHLine_persistent.append()
+    if len(blocks) == 1:
+        return blocks[0]
+    return np.hstack([np.asarray(M, dtype=float) for M in blocks])
+
+def _delete_columns(blocks, idx):
+    # Remove the columns idx, sorted and distinct, from a parameter given in column
+    # blocks; a removed prefix only drops or slices the leading blocks
+    if blocks[0].shape[0] == 0:
+        return blocks
+    m = len(idx)
+    if idx[-1] == m - 1:
+        while blocks[0].shape[-1] <= m:
+            m -= blocks[0].shape[-1]
+            blocks = blocks[1:]
+        return [blocks[0][..., m:]] + blocks[1:] if m > 0 else blocks
+    return [np.delete(np.asarray(_join_columns(blocks), dtype=float), idx, axis=-1)]
+
+class ReHLine_persistent(object):
+    r"""A ReHLine solver that keeps its state between calls, for incremental refits.
+
+    The solver references X, A, and the loss parameters without copying them, and
+    keeps the precomputed norms of the samples, the free sets, and the primal and
+    dual variables between the calls of `solve()`. The loss parameters, the sample
+    weights, and b can be updated in place, new samples can be appended or removed,
+    e.g. for a sliding window, and the next `solve()` continues from the current
+    variables, which stay dual feasible after each update. The leave-one-out margins
+    of the fitted samples can be estimated from the current variables without refits.
+
+    Parameters
+    ----------
+
+    X : array of shape (n_samples, n_features) or sparse matrix
+        The design matrix, in double precision; a sparse X is converted to CSR.
+
+    U, V : array of shape (L, n_samples) or CompressedParam
+        The parameters of the ReLU terms.
+
+    Tau, S, T : array of shape (H, n_samples) or CompressedParam, default=empty
+        The parameters of the ReHU terms.
+
+    A, b : array of shape (K, n_features) and (K, ), default=empty
+        The linear constraints.
+
+    fused : bool, default=None
+        Whether to use the fused per-sample updates; by default they are used for
+        the built-in losses with specialized kernels.
+
+    n_jobs : int, default=1
+        The number of threads of the coordinate updates.
+
+    sync : bool, default=False
+        Whether the threads synchronize beta after each block of samples.
+
+    block_size : int, default=0
+        The number of samples in a block of the threads, where 0 means automatic.
+
+    Attributes
+    ----------
+
+    beta, xi, Lambda, Gamma : ndarray
+        Read-only views of the current variables, which are updated by the next
+        `solve()`; copy them to keep the values of a solve. The views of Lambda and
+        Gamma are invalidated by `append()` and `remove()`.
+
+    dual_objfns, primal_objfns : list
+        The objective function values recorded by the last `solve()`.
+
+    Notes
+    -----
+
+    The object is not thread-safe: `solve()` releases the GIL, and the object must
+    not be updated by another thread while it runs.
+    """
+
+    def __init__(self, X, U, V,
+            Tau=np.empty(shape=(0, 0)),
+            S=np.empty(shape=(0, 0)), T=np.empty(shape=(0, 0)),
+            A=np.empty(shape=(0, 0)), b=np.empty(shape=(0)),
+            fused=None, n_jobs=1, sync=False, block_size=0):
+        if isinstance(X, ReplicatedDesign):
+            raise ValueError("a ReplicatedDesign is not supported by the persistent solver")
+        self._sparse = sparse.issparse(X)
+        if self._sparse:
+            X = X.tocsr()
+            solver = rehline_persistent_sparse
+        else:
+            solver = rehline_persistent
+        # The loss is not planned, since the constant terms of one update may not
+        # be constant in the next; the unweighted parameters and the sample weights
+        # are kept for set_loss() and set_sample_weight(), as lists of the column
+        # blocks added by append()
+        self._params = [[U], [V], [S], [T], [Tau]]
+        self._weights = None
+        self._n = X.shape[0]
+        fused = _plan_kernel(fused, U, S, {})
+        self._solver = solver(X, A, b, U, V, S, T, Tau, fused, n_jobs, sync, block_size)
+
+    def solve(self, max_iter=1000, tol=1e-4, shrink=1, verbose=0, trace_freq=100):
+        """Continue the iterations from the current variables.
+
+        Returns
+        -------
+
+        int
+            The number of iterations of this call.
+        """
+        return self._solver.solve(max_iter, tol, shrink, verbose, trace_freq)
+
+    def set_loss(self, U=None, V=None, S=None, T=None, Tau=None):
+        """Replace some of the loss parameters by new ones of the same shapes,
+        e.g. V and T for new labels; the other parameters are kept."""
+        for k, M in enumerate((U, V, S, T, Tau)):
+            if M is not None:
+                self._params[k] = [M]
+        self._update_loss()
+
+    def set_sample_weight(self, sample_weight):
+        """Weight the loss of each sample, as in `ReHLine.fit()`; a sample of zero
+        weight is excluded from the next solves, and `None` removes the weights."""
+        if sample_weight is not None:
+            sample_weight = [_check_sample_weight(sample_weight, self._n)]
+        self._weights = sample_weight
+        self._update_loss()
+
+    def append(self, X, U, V,
+            Tau=np.empty(shape=(0, 0)),
+            S=np.empty(shape=(0, 0)), T=np.empty(shape=(0, 0)),
+            sample_weight=None, n_revisit=None):
+        """Append new samples, e.g. newly labelled rows, with their loss parameters.
+
+        X and the loss parameters are copied to a storage of the solver that grows
+        geometrically, so that the old samples are not copied at each append. The
+        dual variables of the new samples are set from their margins at the current
+        coefficients, and the next `solve()` first visits only the new samples and
+        `n_revisit` old samples drawn at random, by default as many as the new ones,
+        until they converge, and then all samples.
+        """
+        if self._sparse:
+            X = sparse.csr_matrix(X)
+        elif sparse.issparse(X):
+            X = X.toarray()
+        m = X.shape[0]
+        weights = self._weights
+        if sample_weight is not None or weights is not None:
+            w = np.ones(m) if sample_weight is None else _check_sample_weight(sample_weight, m)
+            weights = (weights or [np.ones(self._n)]) + [w]
+        else:
+            w = None
+        params = (U, V, S, T, Tau)
+        self._solver.append(X, *_weight_params(params, w), m if n_revisit is None else n_revisit)
+        for blocks, M in zip(self._params, params):
+            blocks.append(M)
+        self._weights = weights
+        self._n += m
+
+    def remove(self, idx, n_revisit=None):
+        """Remove the samples of the indices idx, e.g. the oldest ones of a sliding window.
+
+        The contributions of the removed samples are subtracted from the coefficients,
+        and the next `solve()` first visits only `n_revisit` samples drawn at random,
+        by default as many as the removed ones, until they converge, and then all
+        samples. Removing the first samples does not move the other ones.
+        """
+        idx = np.unique(np.asarray(idx, dtype=int).reshape(-1))
+        if len(idx) == 0:
+            return
+        if idx[0] < 0 or idx[-1] >= self._n:
+            raise ValueError("the indices of the samples are out of range")
+        if len(idx) == self._n:
+            raise ValueError("at least one sample must be kept")
+        self._solver.remove(idx.tolist(), len(idx) if n_revisit is None else n_revisit)
+        self._params = [_delete_columns(blocks, idx) for blocks in self._params]
+        if self._weights is not None:
+            self._weights = _delete_columns(self._weights, idx)
+        self._n -= len(idx)
+
+    def loo_decision_function(self, idx=None, n_passes=0):
+        """Approximate leave-one-out margins of the samples of the indices idx, by
+        default all samples.
+
+        The margin of a sample is computed at the coefficients without its
+        contribution. With the default `n_passes=0`, this costs O(n_features) per
+        sample and gives the leave-one-out bound of Jaakkola and Haussler (1999),
+        which is exact for the samples with zero dual variables. With `n_passes > 0`,
+        the margin is taken after `n_passes` passes of the coordinate updates of the
+        other samples, which approach the margin of a refit without the sample as
+        `n_passes` grows; each pass costs as much as an iteration of `solve()` per
+        sample in idx, so a subset of the samples is best given. The variables of
+        the solver are not changed.
+        """
+        idx = self._check_indices(idx)
+        return self._solver.loo_margins(idx, n_passes)
+
+    def loo_loss(self, idx=None, n_passes=0):
+        """The losses of the samples at their approximate leave-one-out margins, see
+        `loo_decision_function()`, including the sample weights."""
+        idx = self._check_indices(idx)
+        return self._solver.sample_losses(idx, self._solver.loo_margins(idx, n_passes))
+
+    def set_b(self, b):
+        """Replace b by a new vector of the same size."""
+        self._solver.set_b(b)
+
+    def reset(self):
+        """Restart from the initial values of the variables."""
+        self._solver.reset()
+
+    def _check_indices(self, idx):
+        if idx is None:
+            return list(range(self._n))
+        idx = np.asarray(idx, dtype=int).reshape(-1)
+        if np.any(idx < 0) or np.any(idx >= self._n):
+            raise ValueError("the indices of the samples are out of range")
+        return idx.tolist()
+
+    def _update_loss(self):
+        params = [_join_columns(blocks) for blocks in self._params]
+        w = None if self._weights is None else np.concatenate(self._weights)
+        self._solver.set_loss(*_weight_params(params, w))
+
+    beta = property(lambda self: self._solver.beta)
+    xi = property(lambda self: self._solver.xi)
+    Lambda = property(lambda self: self._solver.Lambda)
+    Gamma = property(lambda self: self._solver.Gamma)
+    dual_objfns = property(lambda self: self._solver.dual_objfns)
+    primal_objfns = property(lambda self: self._solver.primal_objfns)
+
 class ReHLine(BaseEstimator):
     r"""**(main class)** ReHLine Minimization. (draft version v1.0)
 
@@ -41,9 +479,11 @@ class ReHLine(BaseEstimator):
         `C` will be absorbed by the ReHLine parameters when `self.make_ReLHLoss` is conducted.
 
     verbose : int, default=0
-        Enable verbose output. Note that this setting takes advantage of a
-        per-process runtime setting in liblinear that, if enabled, may not work
-        properly in a multithreaded context.
+        Enable verbose output, which is written to Python's `sys.stdout`.
+
+        The solver releases the GIL while fitting, so that estimators fitted
+        in different Python threads run in parallel; the output of each fit
+        is written separately.
 
     max_iter : int, default=1000
         The maximum number of iterations to be run.
@@ -53,12 +493,80 @@ class ReHLine(BaseEstimator):
 
     Tau, S, T: array of shape (H, n_samples), default=np.empty(shape=(0, 0))
         The parameters pertaining to the ReHU part in the loss function.
+
+        `U`, `V`, `S`, `T`, and `Tau` can also be given as `CompressedParam` objects,
+        e.g. a constant in each row or a rank-one matrix such as `-C * y`, which the
+        solver reads without materializing them. Dense arrays that are constant in each
+        row, or whose rows are affine in one of them, such as those set by
+        `make_ReLHLoss`, are compressed automatically before they are passed to the solver.
     
     A: array of shape (K, n_features), default=np.empty(shape=(0, 0))
         The coefficient matrix in the linear constraint.
 
     b: array of shape (K, ), default=np.empty(shape=0)
         The intercept vector in the linear constraint.
+
+    fused: bool or None, default=None
+        Whether to update all the ReLU and ReHU dual variables of a sample together,
+        so that each row of `X` is read once per iteration. This reduces the memory
+        traffic for losses with more than one ReLU/ReHU term, e.g., the check loss
+        and the Huber loss. The fused updates use kernels compiled for the fixed
+        (L, H) of the built-in losses ('svm', 'QR', 'sSVM', 'huber', and 'TV'),
+        with the loss parameters of a sample loaded at once.
+        If None, the fused updates are used exactly for such (L, H).
+
+    n_jobs: int, default=1
+        The number of threads used by the solver when `shrink > 0`. The threads
+        update disjoint parts of the dual variables in parallel and share the
+        coefficients with lock-free atomic updates, which scales best on sparse data
+        with little feature overlap between samples. `-1` means using all processors.
+
+    sync: bool, default=False
+        Whether to use the synchronous parallel updates when `n_jobs > 1`. Each thread
+        works on its own block of samples against a local copy of the coefficients, and
+        the local changes are combined at the end of each iteration, with a step size
+        that minimizes the dual objective along the combined change. The result is
+        reproducible for a fixed `shrink` seed and `n_jobs`, at the cost of more iterations.
+
+    x_storage: {None, 'float32', 'bfloat16', 'int8'}, default=None
+        The precision in which `X` is stored inside the solver. If not None, `X` is
+        quantized once (`'int8'` uses a scale for each row), while the coefficients,
+        the dual variables, and all accumulations stay in double precision. This
+        reduces the memory traffic of the solver by 2-8x, and the solution is exact
+        for the quantized `X`. Only dense `X` is supported.
+
+    block_size: int, default=0
+        If positive, the samples are visited in contiguous blocks of `block_size` rows
+        when `shrink > 0`, with the blocks and the samples within each block shuffled.
+        This keeps the reads of `X` local, which matters when `X` is memory-mapped from
+        disk (see `fit`). `0` means a full shuffle.
+
+    l1_pen: float or array of shape (n_features,), default=0.
+        The level of the L1 penalty :math:`\sum_j \lambda_{1j} |\beta_j|` added to the
+        objective function. It is handled inside the solver by one dual variable per
+        feature, each updated in O(1), so unlike `append_l1`, `X` and the loss
+        parameters are not augmented.
+
+    stream_rows: int, default=0
+        If positive and `X` is a path or a memory map (see `fit`), `X` is streamed from
+        disk in blocks of `stream_rows` rows instead of being memory-mapped: a background
+        thread reads the next block while the solver updates the dual variables of the
+        current one. Only the loss parameters, the dual variables, and two blocks of `X`
+        are kept in memory, for data much larger than RAM. `fused`, `n_jobs`, `sync`,
+        `x_storage`, `block_size`, and `l1_pen` do not apply to this mode.
+
+    strict: bool, default=False
+        If True, `fit` raises a `ValueError` instead of copying or converting `X`
+        before passing it to the solver, e.g. for an integer array, a sparse matrix
+        that is not CSR with int32 indices, or, with `x_storage`, an array without
+        contiguous float64 rows. This guarantees that no second copy of `X` is made.
+
+    screening: bool, default=True
+        Whether the solver uses the gap-safe screening when `shrink > 0`: each time the
+        free variables converge, the dual variables whose optimal values are certified
+        by the duality gap are fixed at these values for the rest of the fit. The result
+        is the same up to `tol`; set it to False to rule out the screening when
+        comparing or debugging the solvers.
     
 
     Attributes
@@ -71,6 +579,15 @@ class ReHLine(BaseEstimator):
     n_iter_: int
         Maximum number of iterations run across all classes.
 
+    plan_: dict
+        How the loss was passed to the solver: the ReLU and ReHU terms that are
+        constant (`U[l] = 0`, `S[h] = 0`, or `Tau[h] = 0`) and dropped from the
+        problem ('dropped_relu', 'dropped_rehu'), the ReHU terms with an infinite
+        `Tau` ('unbounded_rehu'), the form of each parameter ('dense', 'constant'
+        for constant rows, or 'rank-1'), and the update kernel ('kernel').
+        The dual variables of dropped terms are filled with their optimal values.
+        None for the streaming solver.
+
     References
     ----------
     .. [1] `Dai, B., Qiu, Y,. (2023). ReHLine: Regularized Composite ReLU-ReHU Loss Minimization with Linear Computation and Linear Convergence 
@@ -118,7 +635,9 @@ class ReHLine(BaseEstimator):
                        Tau=np.empty(shape=(0,0)),
                        S=np.empty(shape=(0,0)), T=np.empty(shape=(0,0)),
                        A=np.empty(shape=(0,0)), b=np.empty(shape=(0)),
-                       max_iter=1000, tol=1e-4, shrink=1, verbose=0, trace_freq=100):
+                       max_iter=1000, tol=1e-4, shrink=1, verbose=0, trace_freq=100,
+                       fused=None, n_jobs=1, sync=False, x_storage=None, block_size=0,
+                       l1_pen=0., stream_rows=0, strict=False, screening=True):
         self.loss = loss
         self.C = C
         self.U = U
@@ -133,6 +652,15 @@ class ReHLine(BaseEstimator):
         self.shrink = shrink
         self.verbose = verbose
         self.trace_freq = trace_freq
+        self.fused = fused
+        self.n_jobs = n_jobs
+        self.sync = sync
+        self.x_storage = x_storage
+        self.block_size = block_size
+        self.l1_pen = l1_pen
+        self.stream_rows = stream_rows
+        self.strict = strict
+        self.screening = screening
         self.L = U.shape[0]
         self.n = U.shape[1]
         self.H = S.shape[0]
@@ -156,6 +684,14 @@ class ReHLine(BaseEstimator):
 
         loss: dictionary
             A dictionary that provides the loss function type and properties (optional).
+
+        Returns
+        -------
+
+        X_fake: ReplicatedDesign or None
+            For the check loss, the design matrix of all quantiles, with `X` repeated
+            for each quantile and an intercept for each quantile, which is passed to
+            `self.fit` without being materialized (see `ReplicatedDesign`).
         """
         
         if (loss=={}) or (loss==self.loss):
@@ -178,7 +714,6 @@ class ReHLine(BaseEstimator):
             n_qt = len(loss['qt'])
             self.U = np.ones((2, n*n_qt))
             self.V = np.ones((2, n*n_qt))
-            X_fake = np.zeros((n*n_qt, d+n_qt))
 
             for l,qt_tmp in enumerate(loss['qt']):
                 self.U[0,l*n:(l+1)*n] = - (self.C*qt_tmp*self.U[0,l*n:(l+1)*n])
@@ -187,11 +722,9 @@ class ReHLine(BaseEstimator):
                 self.V[0,l*n:(l+1)*n] = self.C*qt_tmp*self.V[0,l*n:(l+1)*n]*y
                 self.V[1,l*n:(l+1)*n] = - self.C*(1.-qt_tmp)*self.V[1,l*n:(l+1)*n]*y
 
-                X_fake[l*n:(l+1)*n,:d] = X
-                X_fake[l*n:(l+1)*n,d+l] = 1.
-
+            # The design [X, e_1; ...; X, e_{n_qt}] is not materialized
             self.auto_shape()
-            return X_fake
+            return ReplicatedDesign(X, n_qt)
 
         elif (self.loss['name'] == 'sSVM') \
                 or (self.loss['name'] == 'smooth SVM') \
@@ -237,6 +770,9 @@ class ReHLine(BaseEstimator):
 
         where :math:`\lambda_1` is associated with `l1_pen`.
 
+        The same problem is solved without augmenting `X` by setting the `l1_pen`
+        parameter of `ReHLine`, which is preferred for a large `n_features`.
+
         Parameters
         ----------
 
@@ -279,25 +815,26 @@ class ReHLine(BaseEstimator):
         """
 
         n, d = X.shape
+        self.auto_shape()
         l1_pen = l1_pen*np.ones(d)
         U_new = np.zeros((self.L+2, n+d))
         V_new = np.zeros((self.L+2, n+d))
         ## Block 1
-        if len(self.U):
-            U_new[:self.L, :n] = self.U
-            V_new[:self.L, :n] = self.V
+        if self.L > 0:
+            U_new[:self.L, :n] = np.asarray(self.U)
+            V_new[:self.L, :n] = np.asarray(self.V)
         ## Block 2
         U_new[-2,n:] = l1_pen
         U_new[-1,n:] = -l1_pen
 
-        if len(self.S):
+        if self.H > 0:
             S_new = np.zeros((self.H, n+d))
             T_new = np.zeros((self.H, n+d))
             Tau_new = np.zeros((self.H, n+d))
 
-            S_new[:,:n] = self.S
-            T_new[:,:n] = self.T
-            Tau_new[:,:n] = self.Tau
+            S_new[:,:n] = np.asarray(self.S)
+            T_new[:,:n] = np.asarray(self.T)
+            Tau_new[:,:n] = np.asarray(self.Tau)
 
             self.S = S_new
             self.T = T_new
@@ -339,27 +876,73 @@ class ReHLine(BaseEstimator):
 
         relu_input = np.zeros((self.L, self.n))
         rehu_input = np.zeros((self.H, self.n))
+        U, V, S, T = [np.asarray(M) for M in (self.U, self.V, self.S, self.T)]
         if self.L > 0:
-            relu_input = (self.U.T * score[:,np.newaxis]).T + self.V
+            relu_input = (U.T * score[:,np.newaxis]).T + V
         if self.H > 0:
-            rehu_input = (self.S.T * score[:,np.newaxis]).T + self.T
+            rehu_input = (S.T * score[:,np.newaxis]).T + T
         return np.sum(relu(relu_input), 0) + np.sum(rehu(rehu_input), 0)
 
 
-    def fit(self, X, sample_weight=None):
+    def _weighted_params(self, sample_weight):
+        # Without sample weights, the parameters are passed as they are, so that
+        # memory-mapped U, V, S, T, and Tau are not copied
+        if sample_weight is None:
+            return self.U, self.V, self.S, self.T, self.Tau
+
+        if self.L > 0:
+            U_weight = self.U * sample_weight
+            V_weight = self.V * sample_weight
+        else:
+            U_weight = self.U
+            V_weight = self.V
+
+        if self.H > 0:
+            sqrt_sample_weight = np.sqrt(sample_weight)
+            Tau_weight = self.Tau * sqrt_sample_weight
+            S_weight = self.S * sqrt_sample_weight
+            T_weight = self.T * sqrt_sample_weight
+        else:
+            Tau_weight = self.Tau
+            S_weight = self.S
+            T_weight = self.T
+        return U_weight, V_weight, S_weight, T_weight, Tau_weight
+
+    def fit(self, X, sample_weight=None, warm_start=False):
         """Fit the model based on the given training data.
 
         Parameters
         ----------
 
-        X: {array-like} of shape (n_samples, n_features)
+        X: {array-like, sparse matrix} of shape (n_samples, n_features)
             Training vector, where `n_samples` is the number of samples and
             `n_features` is the number of features.
+            A `scipy.sparse.csr_matrix` is passed to the solver without being
+            densified or copied; other sparse formats are converted to CSR first.
+            A float64 or float32 array is referenced in place in any memory layout,
+            e.g. Fortran-ordered or a strided view such as `X[:, ::2]`; the rows of
+            a C-ordered array are read fastest.
+            If `X` has dtype float32, the problem is solved in single precision,
+            and `coef_` is also float32.
+            `X` can also be a C-ordered `np.memmap`, or the path of a `.npy` file,
+            which is memory-mapped (see `load_memmap`); the solver then reads it in
+            place without loading it into RAM, and `block_size` makes the reads local.
+            If `stream_rows > 0`, such an `X` is instead streamed from its file in
+            blocks.
 
         sample_weight : array-like of shape (n_samples,), default=None
             Array of weights that are assigned to individual
             samples. If not provided, then each sample is given unit weight.
 
+        warm_start : bool, default=False
+            Whether to start the solver from the solution of the previous call
+            to `fit`, e.g. when refitting on data that changed only a little.
+            If the number of samples and loss terms is unchanged, the dual
+            variables of the previous fit are used, and `coef_` is recomputed
+            from them; otherwise, the dual variables are derived from the previous
+            `coef_`. Without a previous fit, the solver starts from scratch.
+            Not supported by the streaming solver.
+
         Returns
         -------
         self : object
@@ -367,47 +950,108 @@ class ReHLine(BaseEstimator):
         """
 
         # X = check_array(X)
-        if sample_weight is None:
-            sample_weight = np.ones(X.shape[0])
-
-        if self.L > 0:
-            U_weight = self.U * sample_weight
-            V_weight = self.V * sample_weight
+        if isinstance(X, (str, os.PathLike)):
+            X = load_memmap(X)
+        # X is checked once here, before any conversion, and ReHLine_solver is then
+        # called without strict
+        if self.strict and not (self.stream_rows > 0 and isinstance(X, np.memmap)):
+            _check_in_place(X.X if isinstance(X, ReplicatedDesign) else X,
+                            c_order=self.x_storage is not None)
+        if sparse.issparse(X):
+            X = X.tocsr()
+        if not isinstance(X, ReplicatedDesign):
+            _check_memmap(X)
+
+        U_weight, V_weight, S_weight, T_weight, Tau_weight = self._weighted_params(sample_weight)
+
+        init = getattr(self, 'opt_result_', None) if warm_start else None
+        if self.stream_rows > 0 and isinstance(X, np.memmap):
+            if np.any(np.asarray(self.l1_pen) != 0):
+                raise ValueError("l1_pen is not supported by the streaming solver")
+            if init is not None:
+                raise ValueError("warm_start is not supported by the streaming solver")
+            result = ReHLine_stream_solver(X=X,
+                                           U=U_weight, V=V_weight,
+                                           Tau=Tau_weight,
+                                           S=S_weight, T=T_weight,
+                                           A=self.A, b=self.b, stream_rows=self.stream_rows,
+                                           max_iter=self.max_iter, tol=self.tol,
+                                           shrink=self.shrink, verbose=self.verbose,
+                                           trace_freq=self.trace_freq)
         else:
-            U_weight = self.U
-            V_weight = self.V
-
-        if self.H > 0:
-            sqrt_sample_weight = np.sqrt(sample_weight)
-            Tau_weight = self.Tau * sqrt_sample_weight
-            S_weight = self.S * sqrt_sample_weight
-            T_weight = self.T * sqrt_sample_weight
-        else:
-            Tau_weight = self.Tau
-            S_weight = self.S
-            T_weight = self.T
-
-        result = ReHLine_solver(X=X,
-                                U=U_weight, V=V_weight,
-                                Tau=Tau_weight,
-                                S=S_weight, T=T_weight,
-                                A=self.A, b=self.b,
-                                max_iter=self.max_iter, tol=self.tol,
-                                shrink=self.shrink, verbose=self.verbose,
-                                trace_freq=self.trace_freq)
+            result = ReHLine_solver(X=X,
+                                    U=U_weight, V=V_weight,
+                                    Tau=Tau_weight,
+                                    S=S_weight, T=T_weight,
+                                    A=self.A, b=self.b,
+                                    max_iter=self.max_iter, tol=self.tol,
+                                    shrink=self.shrink, verbose=self.verbose,
+                                    trace_freq=self.trace_freq, fused=self.fused,
+                                    n_jobs=self.n_jobs, sync=self.sync,
+                                    x_storage=self.x_storage, block_size=self.block_size,
+                                    l1_pen=self.l1_pen, warm_start=init,
+                                    screening=self.screening)
 
         self.coef_ = result.beta
         self.opt_result_ = result
+        self.plan_ = getattr(result, 'plan', None)
         self.n_iter_ = result.niter
         self.dual_obj_ = result.dual_objfns
         self.primal_obj_ = result.primal_objfns
 
+    def fit_path(self, X, Cs, sample_weight=None):
+        """Fit the model for each regularization parameter in a grid.
+
+        The loss parameters made by `make_ReLHLoss` with `self.C` are rescaled to
+        each value in `Cs`, and the problems are solved in one call, each one
+        warm-started from the solution of the previous value; the dual variables
+        at a bound of their boxes then start out shrunk. This is faster than
+        fitting each value from scratch, especially when `Cs` is increasing and
+        finely spaced.
+
+        Parameters
+        ----------
+
+        X: {array-like, sparse matrix} of shape (n_samples, n_features)
+            Training vector. The problems are solved in double precision.
+
+        Cs : array-like of shape (n_Cs,)
+            Positive regularization parameters, best given in increasing order.
+            The loss parameters are assumed to be those of `self.C`, i.e.
+            `U` and `V` are proportional to `C`, and `S`, `T`, and `Tau` to `sqrt(C)`,
+            as for all the losses of `make_ReLHLoss`.
+
+        sample_weight : array-like of shape (n_samples,), default=None
+            Array of weights that are assigned to individual samples.
+
+        Returns
+        -------
+        coef_path : ndarray of shape (n_Cs, n_features)
+            The coefficients for each value in `Cs`, also stored in `self.coef_path_`.
+        """
+        if isinstance(X, ReplicatedDesign) or (self.stream_rows > 0 and isinstance(X, np.memmap)):
+            raise ValueError("fit_path supports a dense or sparse X only")
+        if np.any(np.asarray(self.l1_pen) != 0):
+            raise ValueError("l1_pen is not supported by fit_path")
+        Cs = np.asarray(Cs, dtype=float).ravel()
+        U, V, S, T, Tau = self._weighted_params(sample_weight)
+        results = ReHLine_path_solver(X=X, U=U, V=V, Tau=Tau, S=S, T=T,
+                                      A=self.A, b=self.b, scales=Cs / self.C,
+                                      max_iter=self.max_iter, tol=self.tol,
+                                      shrink=self.shrink, verbose=self.verbose,
+                                      trace_freq=self.trace_freq, fused=self.fused,
+                                      n_jobs=self.n_jobs)
+        self.Cs_ = Cs
+        self.coef_path_ = np.array([result.beta for result in results]).reshape(len(Cs), -1)
+        self.n_iter_path_ = np.array([result.niter for result in results])
+        return self.coef_path_
+
     def decision_function(self, X):
         """The decision function evaluated on the given dataset
 
         Parameters
         ----------
-        X : array-like of shape (n_samples, n_features)
+        X : {array-like, sparse matrix} of shape (n_samples, n_features)
             The data matrix.
 
         Returns
@@ -418,5 +1062,7 @@ class ReHLine(BaseEstimator):
         # Check if fit has been called
         check_is_fitted(self)
 
-        X = check_array(X)
-        return np.dot(X, self.coef_)
+        if isinstance(X, ReplicatedDesign):
+            return X.dot(self.coef_)
+        X = check_array(X, accept_sparse='csr')
+        return X @ self.coef_
@@ -0,0 +1,298 @@
+""" Distributed ReHLine solver with worker processes connected over sockets """
+
+# License: MIT License
+
+import os
+import tempfile
+import multiprocessing as mp
+from multiprocessing.connection import Listener, Client
+
+import numpy as np
+from ._internal import rehline_block, rehline_result
+
+
+class SocketTransport(object):
+    """Transport between the coordinator and the workers of `ReHLine_distributed`.
+
+    Messages are pickled Python objects sent over a `multiprocessing.connection`
+    socket. Any object with the methods `listen(authkey)`, returning a listener
+    with `accept()`, `close()` and `address`, and `connect(address, authkey)`,
+    returning a connection with `send()`, `recv()` and `close()`, can be used
+    as a transport.
+
+    Parameters
+    ----------
+
+    family : {'AF_INET', 'AF_UNIX'}, default='AF_INET'
+        TCP socket, or Unix domain socket.
+
+    address : tuple or str, default=None
+        Address of the coordinator. For 'AF_INET', `None` means the loopback
+        interface with a free port; for 'AF_UNIX', `None` means a socket file in
+        a temporary directory.
+    """
+
+    def __init__(self, family='AF_INET', address=None):
+        if family not in ('AF_INET', 'AF_UNIX'):
+            raise ValueError("family must be 'AF_INET' or 'AF_UNIX'")
+        if address is None:
+            if family == 'AF_INET':
+                address = ('127.0.0.1', 0)
+            else:
+                address = os.path.join(tempfile.mkdtemp(), 'rehline.sock')
+        self.family = family
+        self.address = address
+
+    def listen(self, authkey):
+        return Listener(self.address, self.family, authkey=authkey)
+
+    def connect(self, address, authkey):
+        return Client(address, self.family, authkey=authkey)
+
+
+def make_transport(transport):
+    """Create a transport from 'tcp', 'unix', or an existing transport object."""
+    if transport == 'tcp':
+        return SocketTransport('AF_INET')
+    if transport == 'unix':
+        return SocketTransport('AF_UNIX')
+    return transport
+
+
+def _load_block(data):
+    # A block is a dict with keys among X, U, V, S, T, Tau, or a callable
+    # returning such a dict, which is called in the worker process so that
+    # the data do not pass through the coordinator
+    if callable(data):
+        data = data()
+    X = np.asarray(data['X'], dtype=float)
+    empty = np.empty(shape=(0, 0))
+    U, V, S, T, Tau = [np.asarray(data.get(key, empty), dtype=float)
+                       for key in ('U', 'V', 'S', 'T', 'Tau')]
+    return X, U, V, S, T, Tau
+
+
+def rehline_worker(address, authkey, transport='tcp'):
+    """Run a worker of `ReHLine_distributed`.
+
+    The worker connects to the coordinator at `address`, receives its row block of
+    X/U/V/S/T/Tau, and keeps the corresponding dual variables Lambda and Gamma.
+    In each round, it updates its dual variables on the local subproblem against
+    the current coefficients, with the same shrinking rules as the single-process
+    solver, sends back the change of the coefficients, and takes the step size
+    chosen by the coordinator.
+    Workers are started by `ReHLine_distributed` by default, and can also be
+    started separately, e.g. on other machines, with `start_workers=False`.
+    """
+    conn = make_transport(transport).connect(address, authkey)
+    block = None
+    try:
+        while True:
+            msg = conn.recv()
+            cmd = msg[0]
+            if cmd == 'init':
+                data, seed, fused = msg[1:]
+                X, U, V, S, T, Tau = _load_block(data)
+                d = X.shape[1]
+                block = rehline_block(X, np.empty(shape=(0, d)), np.empty(shape=(0)),
+                                      U, V, S, T, Tau, seed, fused)
+                conn.send(block.local_primal())
+            elif cmd == 'round':
+                beta, n_epochs, tol = msg[1:]
+                block.beta = beta
+                delta = block.solve_local(n_epochs, 1., tol)
+                conn.send((delta,) + block.local_step())
+            elif cmd == 'step':
+                block.set_step(msg[1])
+            elif cmd == 'objfn':
+                block.beta = msg[1]
+                conn.send((block.loss_objfn(), block.dual_objfn_sep(), block.local_primal()))
+            elif cmd == 'result':
+                conn.send((block.Lambda, block.Gamma))
+            elif cmd == 'stop':
+                break
+    finally:
+        conn.close()
+
+
+def ReHLine_distributed(blocks, A=np.empty(shape=(0, 0)), b=np.empty(shape=(0)),
+        max_iter=1000, tol=1e-4, n_epochs=1, check_freq=10, seed=1, fused=False,
+        transport='tcp', start_workers=True, verbose=0):
+    r"""Solve the ReHLine problem with the samples distributed over worker processes.
+
+    Each worker owns a row block of X/U/V/S/T/Tau together with its own dual
+    variables, and the coordinator (the calling process) owns the linear
+    constraints (A, b). In each round, the coordinator sends the current
+    coefficients to the workers, and each worker solves its local subproblem as if
+    it were alone. The dual objective function is a quadratic function along the
+    sum of the local changes, so the coordinator takes the step size in [0, 1] that
+    minimizes it (an exact line search), which keeps the dual variables feasible,
+    and sends it back to the workers. Every `check_freq` rounds,
+    the coordinator collects the per-worker loss terms of the primal objective and
+    the separable terms of the dual objective, and stops when the global duality
+    gap is below `tol * max(1, |primal|)`.
+
+    Parameters
+    ----------
+
+    blocks : list
+        The row blocks of the data, one for each worker. Each element is a dict with
+        key 'X' and some of 'U', 'V', 'S', 'T', 'Tau', or a picklable callable
+        returning such a dict, which is then loaded in the worker process.
+
+    A, b : array of shape (K, n_features) and (K, ), default=empty
+        The linear constraints.
+
+    max_iter : int, default=1000
+        The maximum number of rounds.
+
+    tol : float, default=1e-4
+        The tolerance of the relative duality gap.
+
+    n_epochs : int, default=1
+        The number of passes over the local dual variables in each round.
+
+    check_freq : int, default=10
+        The number of rounds between two evaluations of the duality gap.
+
+    seed : int, default=1
+        The random seed of the workers, where worker k uses `seed + k`.
+
+    fused : bool, default=False
+        Whether the workers use the fused per-sample updates.
+
+    transport : {'tcp', 'unix'} or transport object, default='tcp'
+        The transport between the coordinator and the workers, see `SocketTransport`.
+
+    start_workers : bool, default=True
+        Whether to start the workers as local processes. If False, the coordinator
+        waits for `len(blocks)` workers started with `rehline_worker()`; the address
+        and the authentication key are printed if `verbose > 0`.
+
+    verbose : int, default=0
+        Print the objective function values and the duality gap at each check.
+
+    Returns
+    -------
+
+    rehline_result
+        The coefficients `beta`, the dual variables `xi`, `Lambda`, and `Gamma`,
+        where Lambda and Gamma are concatenated over the blocks in order, the
+        number of rounds `niter`, and the recorded objective function values.
+    """
+    transport = make_transport(transport)
+    n_workers = len(blocks)
+    A = np.asarray(A, dtype=float)
+    b = np.asarray(b, dtype=float)
+    K = A.shape[0]
+
+    authkey = os.urandom(16)
+    listener = transport.listen(authkey)
+    procs = []
+    conns = []
+    try:
+        if start_workers:
+            ctx = mp.get_context('spawn')
+            for k in range(n_workers):
+                proc = ctx.Process(target=rehline_worker,
+                                   args=(listener.address, authkey, transport), daemon=True)
+                proc.start()
+                procs.append(proc)
+        elif verbose:
+            print('Waiting for %d workers at %s, authkey = %s'
+                  % (n_workers, listener.address, authkey.hex()))
+        conns = [listener.accept() for k in range(n_workers)]
+
+        for k, conn in enumerate(conns):
+            conn.send(('init', blocks[k], seed + k, fused))
+        beta = np.sum([conn.recv() for conn in conns], axis=0)
+
+        # The constraint block is kept by the coordinator
+        coord = None
+        if K > 0:
+            empty = np.empty(shape=(0, 0))
+            coord = rehline_block(np.empty(shape=(0, A.shape[1])), A, b,
+                                  empty, empty, empty, empty, empty, seed + n_workers, False)
+            beta = beta + coord.local_primal()
+
+        result = rehline_result()
+        dual_objfns, primal_objfns = [], []
+        niter = 0
+        for niter in range(max_iter):
+            if niter % check_freq == 0:
+                for conn in conns:
+                    conn.send(('objfn', beta))
+                loss, dual_sep, w = 0., 0., np.zeros_like(beta)
+                if coord is not None:
+                    coord.beta = beta
+                    dual_sep += coord.dual_objfn_sep()
+                    w += coord.local_primal()
+                for conn in conns:
+                    loss_k, dual_sep_k, w_k = conn.recv()
+                    loss += loss_k
+                    dual_sep += dual_sep_k
+                    w += w_k
+                primal = loss + 0.5 * np.dot(beta, beta)
+                dual = 0.5 * np.dot(w, w) + dual_sep
+                gap = primal + dual
+                # The primal objective is only meaningful for feasible beta
+                infeas = max(0., -np.min(A.dot(beta) + b)) if K > 0 else 0.
+                primal_objfns.append(primal)
+                dual_objfns.append(dual)
+                if verbose:
+                    print('Round %d, dual_objfn = %g, primal_objfn = %g, gap = %g, infeas = %g'
+                          % (niter, dual, primal, gap, infeas))
+                if abs(gap) < tol * max(1., abs(primal)) and infeas < tol:
+                    break
+
+            for conn in conns:
+                conn.send(('round', beta, n_epochs, tol))
+            # The coordinator updates xi while the workers update Lambda and Gamma
+            # Along the changes, the dual objective function is
+            # dual_objfn + eta * slope + 0.5 * eta^2 * curv
+            delta = np.zeros_like(beta)
+            slope, curv = 0., 0.
+            if coord is not None:
+                coord.beta = beta
+                delta += coord.solve_local(n_epochs, 1., tol)
+                slope_k, curv_k = coord.local_step()
+                slope += slope_k
+                curv += curv_k
+            for conn in conns:
+                delta_k, slope_k, curv_k = conn.recv()
+                delta += delta_k
+                slope += slope_k
+                curv += curv_k
+            slope += np.dot(beta, delta)
+            curv += np.dot(delta, delta)
+            eta = min(1., max(0., -slope / curv)) if curv > 0. else 1.
+            if coord is not None:
+                coord.set_step(eta)
+            for conn in conns:
+                conn.send(('step', eta))
+            beta = beta + eta * delta
+        else:
+            niter = max_iter
+
+        for conn in conns:
+            conn.send(('result',))
+        Lambdas, Gammas = zip(*[conn.recv() for conn in conns])
+
+        result.beta = beta
+        result.xi = coord.xi if coord is not None else np.empty(shape=(0))
+        result.Lambda = np.hstack(Lambdas)
+        result.Gamma = np.hstack(Gammas)
+        result.niter = niter
+        result.dual_objfns = dual_objfns
+        result.primal_objfns = primal_objfns
+        return result
+    finally:
+        for conn in conns:
+            try:
+                conn.send(('stop',))
+            except (OSError, EOFError):
+                pass
+            conn.close()
+        listener.close()
+        for proc in procs:
+            proc.join()
@@ -1,49 +1,1103 @@
 #include <vector>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
 #include <type_traits>
+#include <utility>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 #include <pybind11/eigen.h>
 #include <pybind11/stl.h>
 #include <Eigen/Core>
+#include <Eigen/SparseCore>
 #include "rehline.h"
 
 namespace py = pybind11;
 
-using Matrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
-using MapMat = Eigen::Ref<const Matrix>;
-using Vector = Eigen::VectorXd;
-using MapVec = Eigen::Ref<Vector>;
+// The solver is compiled for both double and float inputs
+template <typename Scalar>
+using MatrixT = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+template <typename Scalar>
+using MapMatT = Eigen::Ref<const MatrixT<Scalar>>;
+template <typename Scalar>
+using VectorT = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+template <typename Scalar>
+using MapVecT = Eigen::Ref<VectorT<Scalar>>;
+template <typename Scalar>
+using ConstMapVecT = Eigen::Ref<const VectorT<Scalar>>;
+template <typename Scalar>
+using MapSpMatT = Eigen::Map<const Eigen::SparseMatrix<Scalar, Eigen::RowMajor, int>>;
+template <typename Scalar>
+using ReHLineResultT = rehline::ReHLineResult<MatrixT<Scalar>>;
 
-using ReHLineResult = rehline::ReHLineResult<Matrix>;
+using Matrix = MatrixT<double>;
+using Vector = VectorT<double>;
+using ReHLineResult = ReHLineResultT<double>;
+// A row-majored numpy array of doubles, converted only if necessary
+using NumpyArray = py::array_t<double, py::array::c_style | py::array::forcecast>;
 
+// An output stream writing to Python's sys.stdout, which receives the verbose output
+// of one call of the solver while the GIL is released; each flushed line is written
+// with the GIL acquired, so that concurrent fits do not share std::cout
+class PyStdoutBuf : public std::stringbuf
+{
+protected:
+    int sync() override
+    {
+        const std::string text = str();
+        if (!text.empty())
+        {
+            py::gil_scoped_acquire gil;
+            py::print(text, py::arg("end") = "", py::arg("flush") = true);
+            str("");
+        }
+        return 0;
+    }
+};
+
+class PyStdout : public std::ostream
+{
+private:
+    PyStdoutBuf m_buf;
+
+public:
+    PyStdout() : std::ostream(nullptr) { rdbuf(&m_buf); }
+    ~PyStdout() { flush(); }
+};
+
+// Dense X in the other memory layouts, referenced without a copy (see rehline::StoreView)
+// Ref is the argument type accepted from numpy, and view() gives the Eigen::Map
+// kept by the solver
+// A column-majored (Fortran-ordered) array
+template <typename Scalar>
+struct ColMajorX
+{
+    using ColMajorMatrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>;
+    using Ref = Eigen::Ref<const ColMajorMatrix, 0, Eigen::OuterStride<>>;
+    using Map = Eigen::Map<const ColMajorMatrix, 0, Eigen::OuterStride<>>;
+
+    static Map view(const Ref& X)
+    {
+        return Map(X.data(), X.rows(), X.cols(), Eigen::OuterStride<>(X.outerStride()));
+    }
+};
+// An array with arbitrary strides, e.g., X[:, ::2]
+template <typename Scalar>
+struct StridedX
+{
+    using Stride = Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>;
+    using Ref = Eigen::Ref<const MatrixT<Scalar>, 0, Stride>;
+    using Map = Eigen::Map<const MatrixT<Scalar>, 0, Stride>;
+
+    static Map view(const Ref& X)
+    {
+        return Map(X.data(), X.rows(), X.cols(), Stride(X.outerStride(), X.innerStride()));
+    }
+};
+
+// A view of scipy.sparse.csr_matrix
+// The data, indices, and indptr arrays are referenced, not copied,
+// as long as they have the expected types
+template <typename Scalar>
+struct CSRMatrix
+{
+    py::object          obj;
+    py::array_t<Scalar> data;
+    py::array_t<int>    indices;
+    py::array_t<int>    indptr;
+    Eigen::Index        rows;
+    Eigen::Index        cols;
+
+    MapSpMatT<Scalar> map() const
+    {
+        return MapSpMatT<Scalar>(rows, cols, data.size(), indptr.data(), indices.data(), data.data());
+    }
+};
+
+// A loss parameter matrix U, V, S, T, or Tau, given either as a dense array or
+// as a rehline.CompressedParam with M[l, i] = coef[l] * vec[i] + offset[l]
+// (see rehline::internal::ParamMatrix); the arrays are referenced, not copied,
+// as long as they have the expected types
+template <typename Scalar>
+struct ParamArg
+{
+    py::array_t<Scalar> dense;
+    py::array_t<Scalar> coef;
+    py::array_t<Scalar> vec;     // empty if None
+    py::array_t<Scalar> offset;
+    Eigen::Index        rows;
+    Eigen::Index        cols;
+    bool                is_dense;
+
+    rehline::internal::ParamMatrix<MatrixT<Scalar>> param() const
+    {
+        using ParamMatrix = rehline::internal::ParamMatrix<MatrixT<Scalar>>;
+        if (is_dense)
+            return ParamMatrix(Eigen::Map<const MatrixT<Scalar>>(dense.data(), rows, cols));
+        return ParamMatrix(rows, cols, coef.data(), vec.size() > 0 ? vec.data() : nullptr, offset.data());
+    }
+};
+
+namespace pybind11 { namespace detail {
+
+template <typename Scalar>
+struct type_caster<CSRMatrix<Scalar>>
+{
+public:
+    PYBIND11_TYPE_CASTER(CSRMatrix<Scalar>, const_name("scipy.sparse.csr_matrix"));
+
+    // Only accept objects with format == "csr"
+    // If convert is false, the arrays must already have the expected types,
+    // so that no copy is made
+    bool load(handle src, bool convert)
+    {
+        if (!hasattr(src, "format") || !hasattr(src, "indptr"))
+            return false;
+        if (src.attr("format").cast<std::string>() != "csr")
+            return false;
+
+        using DataArray = array_t<Scalar, array::c_style | array::forcecast>;
+        using IndexArray = array_t<int, array::c_style | array::forcecast>;
+        object data = src.attr("data"), indices = src.attr("indices"), indptr = src.attr("indptr");
+        if (!convert && !(DataArray::check_(data) && IndexArray::check_(indices) && IndexArray::check_(indptr)))
+            return false;
+
+        value.data = DataArray::ensure(data);
+        value.indices = IndexArray::ensure(indices);
+        value.indptr = IndexArray::ensure(indptr);
+        if (!value.data || !value.indices || !value.indptr)
+            return false;
+
+        tuple shape = src.attr("shape");
+        value.rows = shape[0].cast<Eigen::Index>();
+        value.cols = shape[1].cast<Eigen::Index>();
+        value.obj = reinterpret_borrow<object>(src);
+        return true;
+    }
+
+    static handle cast(const CSRMatrix<Scalar>& src, return_value_policy /* policy */, handle /* parent */)
+    {
+        return src.obj.inc_ref();
+    }
+};
+
+template <typename Scalar>
+struct type_caster<ParamArg<Scalar>>
+{
+public:
+    PYBIND11_TYPE_CASTER(ParamArg<Scalar>, const_name("Union[numpy.ndarray, rehline.CompressedParam]"));
+
+    bool load(handle src, bool convert)
+    {
+        using Array = array_t<Scalar, array::c_style | array::forcecast>;
+        if (hasattr(src, "coef") && hasattr(src, "offset") && hasattr(src, "vec"))
+        {
+            object coef = src.attr("coef"), vec = src.attr("vec"), offset = src.attr("offset");
+            if (!convert && !(Array::check_(coef) && Array::check_(offset) && (vec.is_none() || Array::check_(vec))))
+                return false;
+            value.coef = Array::ensure(coef);
+            value.offset = Array::ensure(offset);
+            value.vec = vec.is_none() ? Array(0) : Array::ensure(vec);
+            if (!value.coef || !value.offset || !value.vec)
+                return false;
+
+            tuple shape = src.attr("shape");
+            value.rows = shape[0].cast<Eigen::Index>();
+            value.cols = shape[1].cast<Eigen::Index>();
+            if (value.coef.size() != value.rows || value.offset.size() != value.rows ||
+                (value.vec.size() != 0 && value.vec.size() != value.cols))
+                throw std::invalid_argument("coef, vec, and offset do not match the shape of the parameter");
+            value.is_dense = false;
+            return true;
+        }
+
+        if (!convert && !Array::check_(src))
+            return false;
+        value.dense = Array::ensure(src);
+        if (!value.dense || value.dense.ndim() != 2)
+            return false;
+        value.rows = value.dense.shape(0);
+        value.cols = value.dense.shape(1);
+        value.is_dense = true;
+        return true;
+    }
+
+    static handle cast(const ParamArg<Scalar>& src, return_value_policy /* policy */, handle /* parent */)
+    {
+        return (src.is_dense ? src.dense : src.coef).inc_ref();
+    }
+};
+
+}}  // namespace pybind11::detail
+
+template <typename Scalar>
 void rehline_internal(
-    ReHLineResult& result,
-    const MapMat& X, const MapMat& A, const MapVec& b,
-    const MapMat& U, const MapMat& V,
-    const MapMat& S, const MapMat& T, const MapMat& Tau,
+    ReHLineResultT<Scalar>& result,
+    const MapMatT<Scalar>& X, const MapMatT<Scalar>& A, const MapVecT<Scalar>& b,
+    const ParamArg<Scalar>& U, const ParamArg<Scalar>& V,
+    const ParamArg<Scalar>& S, const ParamArg<Scalar>& T, const ParamArg<Scalar>& Tau,
     int max_iter, double tol, int shrink = 1,
-    int verbose = 0, int trace_freq = 100
+    int verbose = 0, int trace_freq = 100, bool fused = false, int n_threads = 1,
+    bool sync = false, int block_size = 0, const ConstMapVecT<Scalar>& l1_pen = VectorT<Scalar>(),
+    bool warm_start = false, bool screening = true
 )
 {
-    rehline::rehline_solver(result, X, A, b, U, V, S, T, Tau,
-                            max_iter, tol, shrink, verbose, trace_freq);
+    PyStdout out;
+    rehline::rehline_solver(result, X, A, b, U.param(), V.param(), S.param(), T.param(), Tau.param(),
+                            max_iter, Scalar(tol), shrink, verbose, trace_freq, fused, n_threads, sync, block_size, l1_pen, out, warm_start, screening);
 }
 
-PYBIND11_MODULE(_internal, m) {
-    py::class_<ReHLineResult>(m, "rehline_result")
+// Sparse X in the CSR format
+template <typename Scalar>
+void rehline_internal_sparse(
+    ReHLineResultT<Scalar>& result,
+    const CSRMatrix<Scalar>& X, const MapMatT<Scalar>& A, const MapVecT<Scalar>& b,
+    const ParamArg<Scalar>& U, const ParamArg<Scalar>& V,
+    const ParamArg<Scalar>& S, const ParamArg<Scalar>& T, const ParamArg<Scalar>& Tau,
+    int max_iter, double tol, int shrink = 1,
+    int verbose = 0, int trace_freq = 100, bool fused = false, int n_threads = 1,
+    bool sync = false, int block_size = 0, const ConstMapVecT<Scalar>& l1_pen = VectorT<Scalar>(),
+    bool warm_start = false, bool screening = true
+)
+{
+    PyStdout out;
+    rehline::rehline_solver(result, X.map(), A, b, U.param(), V.param(), S.param(), T.param(), Tau.param(),
+                            max_iter, Scalar(tol), shrink, verbose, trace_freq, fused, n_threads, sync, block_size, l1_pen, out, warm_start, screening);
+}
+
+// Dense X in the layout given by XLayout (ColMajorX or StridedX)
+template <typename Scalar, template <typename> class XLayout>
+void rehline_internal_view(
+    ReHLineResultT<Scalar>& result,
+    const typename XLayout<Scalar>::Ref& X, const MapMatT<Scalar>& A, const MapVecT<Scalar>& b,
+    const ParamArg<Scalar>& U, const ParamArg<Scalar>& V,
+    const ParamArg<Scalar>& S, const ParamArg<Scalar>& T, const ParamArg<Scalar>& Tau,
+    int max_iter, double tol, int shrink = 1,
+    int verbose = 0, int trace_freq = 100, bool fused = false, int n_threads = 1,
+    bool sync = false, int block_size = 0, const ConstMapVecT<Scalar>& l1_pen = VectorT<Scalar>(),
+    bool warm_start = false, bool screening = true
+)
+{
+    PyStdout out;
+    rehline::rehline_solver_view(result, XLayout<Scalar>::view(X), A, b,
+                                 U.param(), V.param(), S.param(), T.param(), Tau.param(),
+                                 max_iter, Scalar(tol), shrink, verbose, trace_freq, fused, n_threads, sync, block_size, l1_pen, out, warm_start, screening);
+}
+
+// Multi-quantile regression with the design [X, e_1; ...; X, e_{n_rep}],
+// where X is referenced once instead of being repeated for each quantile
+template <typename Scalar>
+void rehline_internal_replicated(
+    ReHLineResultT<Scalar>& result,
+    const MapMatT<Scalar>& X, int n_rep, const MapMatT<Scalar>& A, const MapVecT<Scalar>& b,
+    const ParamArg<Scalar>& U, const ParamArg<Scalar>& V,
+    const ParamArg<Scalar>& S, const ParamArg<Scalar>& T, const ParamArg<Scalar>& Tau,
+    int max_iter, double tol, int shrink = 1,
+    int verbose = 0, int trace_freq = 100, bool fused = false, int n_threads = 1,
+    bool sync = false, int block_size = 0, const ConstMapVecT<Scalar>& l1_pen = VectorT<Scalar>(),
+    bool warm_start = false, bool screening = true
+)
+{
+    PyStdout out;
+    rehline::rehline_solver_replicated(result, X, n_rep, A, b, U.param(), V.param(), S.param(), T.param(), Tau.param(),
+                                       max_iter, Scalar(tol), shrink, verbose, trace_freq, fused, n_threads, sync, block_size, l1_pen, out, warm_start, screening);
+}
+template <typename Scalar>
+void rehline_internal_replicated_sparse(
+    ReHLineResultT<Scalar>& result,
+    const CSRMatrix<Scalar>& X, int n_rep, const MapMatT<Scalar>& A, const MapVecT<Scalar>& b,
+    const ParamArg<Scalar>& U, const ParamArg<Scalar>& V,
+    const ParamArg<Scalar>& S, const ParamArg<Scalar>& T, const ParamArg<Scalar>& Tau,
+    int max_iter, double tol, int shrink = 1,
+    int verbose = 0, int trace_freq = 100, bool fused = false, int n_threads = 1,
+    bool sync = false, int block_size = 0, const ConstMapVecT<Scalar>& l1_pen = VectorT<Scalar>(),
+    bool warm_start = false, bool screening = true
+)
+{
+    PyStdout out;
+    rehline::rehline_solver_replicated(result, X.map(), n_rep, A, b, U.param(), V.param(), S.param(), T.param(), Tau.param(),
+                                       max_iter, Scalar(tol), shrink, verbose, trace_freq, fused, n_threads, sync, block_size, l1_pen, out, warm_start, screening);
+}
+
+template <typename Scalar, template <typename> class XLayout>
+void rehline_internal_replicated_view(
+    ReHLineResultT<Scalar>& result,
+    const typename XLayout<Scalar>::Ref& X, int n_rep, const MapMatT<Scalar>& A, const MapVecT<Scalar>& b,
+    const ParamArg<Scalar>& U, const ParamArg<Scalar>& V,
+    const ParamArg<Scalar>& S, const ParamArg<Scalar>& T, const ParamArg<Scalar>& Tau,
+    int max_iter, double tol, int shrink = 1,
+    int verbose = 0, int trace_freq = 100, bool fused = false, int n_threads = 1,
+    bool sync = false, int block_size = 0, const ConstMapVecT<Scalar>& l1_pen = VectorT<Scalar>(),
+    bool warm_start = false, bool screening = true
+)
+{
+    using XRep = rehline::internal::ReplicatedMatrix<typename XLayout<Scalar>::Map>;
+    PyStdout out;
+    rehline::rehline_solver_view(result, XRep(XLayout<Scalar>::view(X), n_rep), A, b,
+                                 U.param(), V.param(), S.param(), T.param(), Tau.param(),
+                                 max_iter, Scalar(tol), shrink, verbose, trace_freq, fused, n_threads, sync, block_size, l1_pen, out, warm_start, screening);
+}
+
+// Dense X stored in a lower precision ("float32", "bfloat16", or "int8" with a
+// per-row scale), while beta and the dual variables are computed in double
+void rehline_internal_quantized(
+    ReHLineResult& result,
+    const MapMatT<double>& X, const MapMatT<double>& A, const MapVecT<double>& b,
+    const ParamArg<double>& U, const ParamArg<double>& V,
+    const ParamArg<double>& S, const ParamArg<double>& T, const ParamArg<double>& Tau,
+    int max_iter, double tol, int shrink, int verbose, int trace_freq,
+    bool fused, int n_threads, bool sync, int block_size, const ConstMapVecT<double>& l1_pen,
+    const std::string& x_storage, bool warm_start = false, bool screening = true
+)
+{
+    PyStdout out;
+    if (x_storage == "float32")
+    {
+        rehline::rehline_solver<rehline::StoreQuantized<float>>(
+            result, X, A, b, U.param(), V.param(), S.param(), T.param(), Tau.param(),
+            max_iter, tol, shrink, verbose, trace_freq, fused, n_threads, sync, block_size, l1_pen, out, warm_start, screening);
+    } else if (x_storage == "bfloat16") {
+        rehline::rehline_solver<rehline::StoreQuantized<rehline::internal::bfloat16>>(
+            result, X, A, b, U.param(), V.param(), S.param(), T.param(), Tau.param(),
+            max_iter, tol, shrink, verbose, trace_freq, fused, n_threads, sync, block_size, l1_pen, out, warm_start, screening);
+    } else if (x_storage == "int8") {
+        rehline::rehline_solver<rehline::StoreQuantized<std::int8_t>>(
+            result, X, A, b, U.param(), V.param(), S.param(), T.param(), Tau.param(),
+            max_iter, tol, shrink, verbose, trace_freq, fused, n_threads, sync, block_size, l1_pen, out, warm_start, screening);
+    } else {
+        throw std::invalid_argument("x_storage must be one of 'float32', 'bfloat16', and 'int8'");
+    }
+}
+
+// Streaming solver on a row-majored X of float or double (value_size = 4 or 8)
+// stored in the file "path" from byte "offset", read in blocks of block_rows rows
+void rehline_internal_stream(
+    ReHLineResult& result,
+    const std::string& path, long long offset, int n, int d, int value_size,
+    const MapMatT<double>& A, const MapVecT<double>& b,
+    const ParamArg<double>& U, const ParamArg<double>& V,
+    const ParamArg<double>& S, const ParamArg<double>& T, const ParamArg<double>& Tau,
+    int block_rows, int max_iter, double tol, int n_epochs, int shrink,
+    int verbose, int trace_freq
+)
+{
+    PyStdout out;
+    rehline::rehline_solver_stream(result, path, std::streamoff(offset), n, d, value_size,
+                                   A, b, U.param(), V.param(), S.param(), T.param(), Tau.param(), block_rows, max_iter, tol, n_epochs,
+                                   shrink, verbose, trace_freq, out);
+}
+
+// The Eigen matrix of a dense or CSR X, and the parameters of a list of problems
+inline const MapMatT<double>& x_matrix(const MapMatT<double>& X) { return X; }
+inline MapSpMatT<double> x_matrix(const CSRMatrix<double>& X) { return X.map(); }
+inline Eigen::Map<const Matrix> x_matrix(const NumpyArray& X)
+{
+    if (X.ndim() != 2)
+        throw std::invalid_argument("X must be a two-dimensional array");
+    return Eigen::Map<const Matrix>(X.data(), X.shape(0), X.shape(1));
+}
+inline std::vector<rehline::internal::ParamMatrix<Matrix>> param_list(const std::vector<ParamArg<double>>& P)
+{
+    std::vector<rehline::internal::ParamMatrix<Matrix>> res;
+    res.reserve(P.size());
+    for (const auto& p: P)
+        res.push_back(p.param());
+    return res;
+}
+
+// Problems sharing X, A, and b, solved together in lanes (see rehline::ReHLineLaneSolver)
+// U, V, S, T, and Tau are lists with the loss parameters of each problem
+template <typename XArg>
+std::vector<ReHLineResult> rehline_internal_lanes(
+    const XArg& X, const MapMatT<double>& A, const MapVecT<double>& b,
+    const std::vector<ParamArg<double>>& U, const std::vector<ParamArg<double>>& V,
+    const std::vector<ParamArg<double>>& S, const std::vector<ParamArg<double>>& T,
+    const std::vector<ParamArg<double>>& Tau,
+    int max_iter, double tol, int verbose = 0, int trace_freq = 100
+)
+{
+    std::vector<ReHLineResult> results;
+    PyStdout out;
+    rehline::rehline_solver_lanes(results, x_matrix(X), A, b, param_list(U), param_list(V),
+                                  param_list(S), param_list(T), param_list(Tau),
+                                  max_iter, tol, verbose, trace_freq, out);
+    return results;
+}
+
+// Regularization path over the scales of the loss parameters (see rehline::rehline_solver_path)
+template <typename XArg>
+std::vector<ReHLineResult> rehline_internal_path(
+    const XArg& X, const MapMatT<double>& A, const MapVecT<double>& b,
+    const ParamArg<double>& U, const ParamArg<double>& V,
+    const ParamArg<double>& S, const ParamArg<double>& T, const ParamArg<double>& Tau,
+    const std::vector<double>& scales, int max_iter, double tol, int shrink = 1,
+    int verbose = 0, int trace_freq = 100, bool fused = false, int n_threads = 1
+)
+{
+    std::vector<ReHLineResult> results;
+    PyStdout out;
+    rehline::rehline_solver_path(results, x_matrix(X), A, b, U.param(), V.param(), S.param(), T.param(), Tau.param(),
+                                 scales, max_iter, tol, shrink, verbose, trace_freq, fused, n_threads, out);
+    return results;
+}
+
+// A problem of rehline_batch(), given as a tuple (X, A, b, U, V, S, T, Tau, fused),
+// where X is a dense array or a scipy.sparse.csr_matrix
+// The arrays are kept in this object, and the solver references them without copying
+struct BatchProblem
+{
+    NumpyArray        X;
+    CSRMatrix<double> X_csr;
+    bool              is_sparse;
+    NumpyArray        A;
+    NumpyArray        b;
+    ParamArg<double>  U, V, S, T, Tau;
+    bool              fused;
+
+    // The entries of X visited in an epoch, once for each of the L + H losses
+    double cost() const
+    {
+        const double nnz = is_sparse ? double(X_csr.data.size()) : double(X.size());
+        return nnz * double(U.rows + S.rows + 1) + double(A.size());
+    }
+};
+
+// Solve a list of independent problems, each on a single thread, using a pool of
+// n_threads threads that start from the most costly problems
+// A dense X shared by several problems is converted to a C-ordered array of doubles
+// only once, and the GIL is released while the problems are solved
+std::vector<ReHLineResult> rehline_batch(
+    const py::list& problems, int max_iter, double tol, int shrink = 1,
+    int verbose = 0, int trace_freq = 100, int n_threads = 1
+)
+{
+    std::vector<BatchProblem> batch;
+    batch.reserve(problems.size());
+    std::map<PyObject*, NumpyArray> dense_X;
+    for (py::handle item: problems)
+    {
+        py::tuple prob = item.cast<py::tuple>();
+        if (prob.size() != 9)
+            throw std::invalid_argument("each problem must be a tuple (X, A, b, U, V, S, T, Tau, fused)");
+        BatchProblem p;
+        py::handle X = prob[0];
+        p.is_sparse = py::hasattr(X, "format");
+        if (p.is_sparse)
+        {
+            p.X_csr = X.cast<CSRMatrix<double>>();
+        } else {
+            auto it = dense_X.find(X.ptr());
+            if (it == dense_X.end())
+                it = dense_X.emplace(X.ptr(), X.cast<NumpyArray>()).first;
+            p.X = it->second;
+            if (p.X.ndim() != 2)
+                throw std::invalid_argument("X must be a two-dimensional array");
+        }
+        p.A = prob[1].cast<NumpyArray>();
+        p.b = prob[2].cast<NumpyArray>();
+        if (p.A.ndim() != 2 || p.b.ndim() != 1)
+            throw std::invalid_argument("A must be a two-dimensional array, and b a one-dimensional array");
+        p.U = prob[3].cast<ParamArg<double>>();
+        p.V = prob[4].cast<ParamArg<double>>();
+        p.S = prob[5].cast<ParamArg<double>>();
+        p.T = prob[6].cast<ParamArg<double>>();
+        p.Tau = prob[7].cast<ParamArg<double>>();
+        p.fused = prob[8].cast<bool>();
+        batch.push_back(std::move(p));
+    }
+
+    const int n = int(batch.size());
+    std::vector<double> cost(n);
+    for (int k = 0; k < n; k++)
+        cost[k] = batch[k].cost();
+    if (n_threads <= 0)
+        n_threads = int(std::thread::hardware_concurrency());
+
+    std::vector<ReHLineResult> results(n);
+    {
+        py::gil_scoped_release release;
+        rehline::internal::parallel_tasks(cost, n_threads, [&](int k)
+        {
+            const BatchProblem& p = batch[k];
+            const Eigen::Map<const Matrix> A(p.A.data(), p.A.shape(0), p.A.shape(1));
+            const Eigen::Map<const Vector> b(p.b.data(), p.b.size());
+            PyStdout out;
+            if (p.is_sparse)
+                rehline::rehline_solver(results[k], p.X_csr.map(), A, b,
+                                        p.U.param(), p.V.param(), p.S.param(), p.T.param(), p.Tau.param(),
+                                        max_iter, tol, shrink, verbose, trace_freq, p.fused, 1, false, 0, Vector(), out);
+            else
+                rehline::rehline_solver(results[k], Eigen::Map<const Matrix>(p.X.data(), p.X.shape(0), p.X.shape(1)), A, b,
+                                        p.U.param(), p.V.param(), p.S.param(), p.T.param(), p.Tau.param(),
+                                        max_iter, tol, shrink, verbose, trace_freq, p.fused, 1, false, 0, Vector(), out);
+        });
+    }
+    return results;
+}
+
+// A block of the ReHLine problem owned by a worker of the distributed solver,
+// see rehline/_distributed.py
+// The input arrays are kept in this object, and the solver references them
+// without copying
+class ReHLineBlock
+{
+private:
+    using Array = NumpyArray;
+    using Solver = rehline::ReHLineSolver<Matrix>;
+
+    Array m_X, m_A, m_b, m_U, m_V, m_S, m_T, m_Tau;
+    std::unique_ptr<Solver> m_solver;
+    // Dual variables before the last solve_local()
+    Vector m_xi0;
+    Matrix m_Lambda0, m_Gamma0;
+
+    static Eigen::Map<const Matrix> map_mat(const Array& x, const char* name)
+    {
+        if (x.ndim() != 2)
+            throw std::invalid_argument(std::string(name) + " must be a two-dimensional array");
+        return Eigen::Map<const Matrix>(x.data(), x.shape(0), x.shape(1));
+    }
+
+public:
+    ReHLineBlock(Array X, Array A, Array b, Array U, Array V, Array S, Array T, Array Tau,
+                 int seed = 1, bool fused = false) :
+        m_X(X), m_A(A), m_b(b), m_U(U), m_V(V), m_S(S), m_T(T), m_Tau(Tau)
+    {
+        if (m_b.ndim() != 1)
+            throw std::invalid_argument("b must be a one-dimensional array");
+        m_solver.reset(new Solver(
+            map_mat(m_X, "X"), map_mat(m_U, "U"), map_mat(m_V, "V"),
+            map_mat(m_S, "S"), map_mat(m_T, "T"), map_mat(m_Tau, "Tau"),
+            map_mat(m_A, "A"), Eigen::Map<const Vector>(m_b.data(), m_b.size())));
+        m_solver->set_seed(seed);
+        m_solver->set_fused(fused);
+        m_solver->init_params();
+    }
+
+    Vector get_beta() { return m_solver->get_beta_ref(); }
+    void set_beta(const Eigen::Ref<const Vector>& beta) { m_solver->get_beta_ref() = beta; }
+    Vector get_xi() { return m_solver->get_xi_ref(); }
+    Matrix get_Lambda() { return m_solver->get_Lambda_ref(); }
+    Matrix get_Gamma() { return m_solver->get_Gamma_ref(); }
+
+    // Local updates, whose change of the dual variables is taken with a step size eta
+    // chosen by the coordinator: along the change, the separable part of the dual
+    // objective function is dual_objfn_sep() + eta * slope + 0.5 * eta^2 * curv, where
+    // (slope, curv) is returned by local_step(), and set_step(eta) takes the step
+    Vector solve_local(int n_epochs, double sigma, double tol)
+    {
+        m_xi0 = m_solver->get_xi_ref();
+        m_Lambda0 = m_solver->get_Lambda_ref();
+        m_Gamma0 = m_solver->get_Gamma_ref();
+        return m_solver->solve_local(n_epochs, sigma, tol);
+    }
+    std::pair<double, double> local_step() const
+    {
+        const Vector dxi = m_solver->get_xi_ref() - m_xi0;
+        const Matrix dLambda = m_solver->get_Lambda_ref() - m_Lambda0;
+        const Matrix dGamma = m_solver->get_Gamma_ref() - m_Gamma0;
+        double slope = 0.0, curv = 0.0;
+        if (dxi.size() > 0)
+            slope += Eigen::Map<const Vector>(m_b.data(), m_b.size()).dot(dxi);
+        if (dLambda.size() > 0)
+            slope -= map_mat(m_V, "V").cwiseProduct(dLambda).sum();
+        if (dGamma.size() > 0)
+        {
+            slope += (m_Gamma0 - map_mat(m_T, "T")).cwiseProduct(dGamma).sum();
+            curv += dGamma.squaredNorm();
+        }
+        return std::make_pair(slope, curv);
+    }
+    void set_step(double eta)
+    {
+        m_solver->get_xi_ref() = m_xi0 + eta * (m_solver->get_xi_ref() - m_xi0);
+        m_solver->get_Lambda_ref() = m_Lambda0 + eta * (m_solver->get_Lambda_ref() - m_Lambda0);
+        m_solver->get_Gamma_ref() = m_Gamma0 + eta * (m_solver->get_Gamma_ref() - m_Gamma0);
+    }
+    double loss_objfn() const { return m_solver->get_loss_objfn(); }
+    double dual_objfn_sep() const { return m_solver->get_dual_objfn_sep(); }
+    Vector local_primal() const { return m_solver->local_primal(); }
+};
+
+// Data of a persistent solver with appended or removed samples, owned with spare capacity
+// that doubles when it runs out, so that appending m samples copies O(m) data amortized
+// Removing a prefix of the samples, e.g., the oldest ones in a sliding window, moves the
+// start of the view, and other removals copy the remaining samples to a new buffer; the
+// old buffer is kept in retired until release(), since the solver reads the removed
+// samples before it is rebound (see rehline::ReHLineSolver::remove_samples())
+inline Eigen::Index grown_capacity(Eigen::Index capacity, Eigen::Index size)
+{
+    return std::max(size, 2 * capacity);
+}
+
+// Whether the sorted indices are 0, 1, ..., size - 1
+inline bool is_prefix(const std::vector<int>& idx)
+{
+    for (std::size_t j = 0; j < idx.size(); j++)
+        if (idx[j] != static_cast<int>(j))
+            return false;
+    return true;
+}
+
+// Rows of a dense X
+struct AppendableDenseX
+{
+    Matrix       buf;
+    Matrix       retired;
+    Eigen::Index start = 0;
+    Eigen::Index rows = 0;
+
+    void append(const Eigen::Ref<const Matrix>& X)
+    {
+        if (start + rows + X.rows() > buf.rows())
+            move_to(grown_capacity(rows, rows + X.rows()), X.cols(), std::vector<int>());
+        buf.middleRows(start + rows, X.rows()) = X;
+        rows += X.rows();
+    }
+    void remove(const std::vector<int>& idx)
+    {
+        if (!is_prefix(idx))
+            return move_to(buf.rows(), buf.cols(), idx);
+        start += idx.size();
+        rows -= idx.size();
+        // Once more rows are dropped than kept, the kept ones are moved to the front
+        if (start > rows)
+            move_to(buf.rows(), buf.cols(), std::vector<int>());
+    }
+    // Copy the rows of the view except idx to a new buffer
+    void move_to(Eigen::Index capacity, Eigen::Index cols, const std::vector<int>& idx)
+    {
+        Matrix moved(capacity, cols);
+        Eigen::Index r = 0;
+        for (Eigen::Index i = 0, j = 0; i < rows; i++)
+        {
+            if (j < Eigen::Index(idx.size()) && idx[j] == i)
+                j++;
+            else
+                moved.row(r++) = buf.row(start + i);
+        }
+        retired.swap(buf);
+        buf.swap(moved);
+        start = 0;
+        rows = r;
+    }
+    void release() { retired = Matrix(); }
+    Eigen::Ref<const Matrix> view() const { return buf.middleRows(start, rows); }
+};
+
+// Rows of a CSR X, where outer holds the positions in values of the rows from start on
+struct AppendableCSRX
+{
+    std::vector<double> values, retired_values;
+    std::vector<int>    inner, retired_inner;
+    std::vector<int>    outer{0}, retired_outer;
+    Eigen::Index        start = 0;
+    Eigen::Index        cols = 0;
+
+    Eigen::Index rows() const { return outer.size() - 1 - start; }
+    void append(const MapSpMatT<double>& X)
+    {
+        if (values.size() + X.nonZeros() > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+            throw std::overflow_error("the number of nonzero elements of X exceeds the int32 indices");
+        cols = X.cols();
+        for (Eigen::Index i = 0; i < X.rows(); i++)
+        {
+            for (MapSpMatT<double>::InnerIterator it(X, i); it; ++it)
+            {
+                values.push_back(it.value());
+                inner.push_back(it.index());
+            }
+            outer.push_back(static_cast<int>(values.size()));
+        }
+    }
+    void remove(const std::vector<int>& idx)
+    {
+        if (!is_prefix(idx))
+            return move_to(idx);
+        start += idx.size();
+        if (start > rows())
+            move_to(std::vector<int>());
+    }
+    // Copy the rows of the view except idx to new arrays
+    void move_to(const std::vector<int>& idx)
+    {
+        std::vector<double> moved_values;
+        std::vector<int> moved_inner, moved_outer{0};
+        moved_values.reserve(values.size() - outer[start]);
+        moved_inner.reserve(values.size() - outer[start]);
+        for (Eigen::Index i = 0, j = 0; i < rows(); i++)
+        {
+            if (j < Eigen::Index(idx.size()) && idx[j] == i)
+            {
+                j++;
+                continue;
+            }
+            moved_values.insert(moved_values.end(), values.begin() + outer[start + i], values.begin() + outer[start + i + 1]);
+            moved_inner.insert(moved_inner.end(), inner.begin() + outer[start + i], inner.begin() + outer[start + i + 1]);
+            moved_outer.push_back(static_cast<int>(moved_values.size()));
+        }
+        retired_values.swap(values);
+        retired_inner.swap(inner);
+        retired_outer.swap(outer);
+        values.swap(moved_values);
+        inner.swap(moved_inner);
+        outer.swap(moved_outer);
+        start = 0;
+    }
+    void release()
+    {
+        std::vector<double>().swap(retired_values);
+        std::vector<int>().swap(retired_inner);
+        std::vector<int>().swap(retired_outer);
+    }
+    // The positions in outer are absolute, so the row pointers start at outer[start]
+    MapSpMatT<double> view() const
+    {
+        return MapSpMatT<double>(rows(), cols, outer.back() - outer[start],
+                                 outer.data() + start, inner.data(), values.data());
+    }
+};
+
+// Columns of a loss parameter matrix, stored in the dense form
+struct AppendableParam
+{
+    using ParamMatrix = rehline::internal::ParamMatrix<Matrix>;
+
+    Matrix       buf;
+    Matrix       retired;
+    Eigen::Index start = 0;
+    Eigen::Index cols = 0;
+
+    void append(const ParamMatrix& P)
+    {
+        if (start + cols + P.cols() > buf.cols())
+            move_to(P.rows(), grown_capacity(cols, cols + P.cols()), std::vector<int>());
+        for (Eigen::Index l = 0; l < P.rows(); l++)
+            for (Eigen::Index i = 0; i < P.cols(); i++)
+                buf(l, start + cols + i) = P(l, i);
+        cols += P.cols();
+    }
+    void remove(const std::vector<int>& idx)
+    {
+        if (!is_prefix(idx))
+            return move_to(buf.rows(), buf.cols(), idx);
+        start += idx.size();
+        cols -= idx.size();
+        if (start > cols)
+            move_to(buf.rows(), buf.cols(), std::vector<int>());
+    }
+    // Copy the columns of the view except idx to a new buffer
+    void move_to(Eigen::Index rows, Eigen::Index capacity, const std::vector<int>& idx)
+    {
+        Matrix moved(rows, capacity);
+        Eigen::Index c = 0;
+        for (Eigen::Index i = 0, j = 0; i < cols; i++)
+        {
+            if (j < Eigen::Index(idx.size()) && idx[j] == i)
+                j++;
+            else
+                moved.col(c++) = buf.col(start + i);
+        }
+        retired.swap(buf);
+        buf.swap(moved);
+        start = 0;
+        cols = c;
+    }
+    void release() { retired = Matrix(); }
+    ParamMatrix view() const { return ParamMatrix(buf.middleCols(start, cols)); }
+};
+
+// A solver kept across calls, for the refits of a problem whose loss parameters or b
+// change, or that receives new samples, e.g., in an online retraining loop
+// (see rehline.ReHLine_persistent)
+// X, A, the norms of the rows of X, and the free variable sets are set up once, and each
+// solve() continues from the current variables; beta and the dual variables are returned
+// as read-only numpy views of the memory of the solver
+// XArg is NumpyArray or CSRMatrix<double>, and the input arrays are kept in this object
+// and referenced by the solver; b is copied, so that set_b() changes it in place
+// After append() or remove(), X and the loss parameters are copied to the storage of
+// this object, where the later samples are appended and removed
+template <typename XArg>
+class ReHLinePersistent
+{
+private:
+    using XMatrix = typename std::decay<decltype(x_matrix(std::declval<const XArg&>()))>::type::PlainObject;
+    using Solver = rehline::ReHLineSolver<XMatrix>;
+    using XStore = typename std::conditional<std::is_same<XArg, NumpyArray>::value,
+                                             AppendableDenseX, AppendableCSRX>::type;
+
+    XArg             m_X;
+    NumpyArray       m_A;
+    Vector           m_b;
+    ParamArg<double> m_U, m_V, m_S, m_T, m_Tau;
+    std::unique_ptr<Solver> m_solver;
+    // Owned data after append(), with whether X and the loss parameters are in them
+    XStore           m_X_store;
+    AppendableParam  m_param_store[5];
+    bool             m_X_owned;
+    bool             m_params_owned;
+    std::vector<double> m_dual_objfns;
+    std::vector<double> m_primal_objfns;
+
+public:
+    ReHLinePersistent(const XArg& X, NumpyArray A, const Eigen::Ref<const Vector>& b,
+                      const ParamArg<double>& U, const ParamArg<double>& V,
+                      const ParamArg<double>& S, const ParamArg<double>& T, const ParamArg<double>& Tau,
+                      bool fused = false, int n_threads = 1, bool sync = false, int block_size = 0) :
+        m_X(X), m_A(A), m_b(b), m_U(U), m_V(V), m_S(S), m_T(T), m_Tau(Tau),
+        m_X_owned(false), m_params_owned(false)
+    {
+        if (m_A.ndim() != 2)
+            throw std::invalid_argument("A must be a two-dimensional array");
+        m_solver.reset(new Solver(x_matrix(m_X), m_U.param(), m_V.param(), m_S.param(), m_T.param(), m_Tau.param(),
+                                  Eigen::Map<const Matrix>(m_A.data(), m_A.shape(0), m_A.shape(1)), m_b));
+        m_solver->set_fused(fused);
+        m_solver->set_threads(n_threads);
+        m_solver->set_sync(sync);
+        m_solver->set_block_size(block_size);
+        m_solver->init_params();
+    }
+
+    // Continue the iterations from the current variables, and return the number of iterations
+    int solve(int max_iter, double tol, int shrink = 1, int verbose = 0, int trace_freq = 100)
+    {
+        PyStdout out;
+        m_dual_objfns.clear();
+        m_primal_objfns.clear();
+        if (shrink > 0)
+        {
+            m_solver->set_seed(shrink);
+            return m_solver->solve(m_dual_objfns, m_primal_objfns, max_iter, tol, verbose, trace_freq, out);
+        }
+        return m_solver->solve_vanilla(m_dual_objfns, m_primal_objfns, max_iter, tol, verbose, trace_freq, out);
+    }
+
+    // New loss parameters of the same shapes, see rehline::ReHLineSolver::set_loss_params()
+    void set_loss(const ParamArg<double>& U, const ParamArg<double>& V,
+                  const ParamArg<double>& S, const ParamArg<double>& T, const ParamArg<double>& Tau)
+    {
+        m_solver->set_loss_params(U.param(), V.param(), S.param(), T.param(), Tau.param());
+        m_U = U;
+        m_V = V;
+        m_S = S;
+        m_T = T;
+        m_Tau = Tau;
+        // The new parameters are referenced, and the owned copies are released
+        for (auto& P: m_param_store)
+            P = AppendableParam();
+        m_params_owned = false;
+    }
+
+    // Append new samples, see rehline::ReHLineSolver::append_samples()
+    void append(const XArg& X, const ParamArg<double>& U, const ParamArg<double>& V,
+                const ParamArg<double>& S, const ParamArg<double>& T, const ParamArg<double>& Tau,
+                int n_revisit)
+    {
+        const auto Xnew = x_matrix(X);
+        const Eigen::Index m = Xnew.rows();
+        const ParamArg<double>* olds[] = {&m_U, &m_V, &m_S, &m_T, &m_Tau};
+        const ParamArg<double>* news[] = {&U, &V, &S, &T, &Tau};
+        // Checked before any data are copied, so that a failed append changes nothing
+        bool ok = (Xnew.cols() == x_matrix(m_X).cols());
+        for (int k = 0; k < 5; k++)
+            ok = ok && (news[k]->rows == olds[k]->rows) && (news[k]->rows == 0 || news[k]->cols == m);
+        if (!ok)
+            throw std::invalid_argument("the appended samples must have the shapes of the old ones");
+
+        own_data();
+        m_X_store.append(Xnew);
+        for (int k = 0; k < 5; k++)
+            m_param_store[k].append(news[k]->param());
+        m_solver->append_samples(m_X_store.view(), m_param_store[0].view(), m_param_store[1].view(),
+                                 m_param_store[2].view(), m_param_store[3].view(), m_param_store[4].view(),
+                                 n_revisit);
+        release_retired();
+    }
+
+    // Remove samples, given in increasing order, see rehline::ReHLineSolver::remove_samples()
+    void remove(const std::vector<int>& idx, int n_revisit)
+    {
+        // Checked before any data are moved, so that a failed removal changes nothing
+        const Eigen::Index n = m_X_owned ? m_X_store.view().rows() : x_matrix(m_X).rows();
+        for (std::size_t j = 0; j < idx.size(); j++)
+        {
+            if (idx[j] < 0 || idx[j] >= n || (j > 0 && idx[j] <= idx[j - 1]))
+                throw std::invalid_argument("the removed samples must be distinct indices in increasing order");
+        }
+
+        own_data();
+        m_X_store.remove(idx);
+        for (auto& P: m_param_store)
+            P.remove(idx);
+        m_solver->remove_samples(idx, m_X_store.view(), m_param_store[0].view(), m_param_store[1].view(),
+                                 m_param_store[2].view(), m_param_store[3].view(), m_param_store[4].view(),
+                                 n_revisit);
+        release_retired();
+    }
+
+    // Approximate leave-one-out margins and losses, see rehline::ReHLineSolver::loo_margins()
+    Vector loo_margins(const std::vector<int>& idx, int n_passes) { return m_solver->loo_margins(idx, n_passes); }
+    Vector sample_losses(const std::vector<int>& idx, const Eigen::Ref<const Vector>& z) const
+    {
+        return m_solver->sample_losses(idx, z);
+    }
+
+    // New b of the same size; xi stays feasible, and beta does not depend on b
+    void set_b(const Eigen::Ref<const Vector>& b)
+    {
+        if (b.size() != m_b.size())
+            throw std::invalid_argument("the new b must have the size of the old one");
+        m_b.noalias() = b;
+    }
+
+    // Restart from the initial values of the variables
+    void reset() { m_solver->init_params(); }
+
+private:
+    // Copy X and the loss parameters to the storage of this object, before the first
+    // change of the samples
+    void own_data()
+    {
+        if (!m_X_owned)
+            m_X_store.append(x_matrix(m_X));
+        m_X_owned = true;
+        const ParamArg<double>* params[] = {&m_U, &m_V, &m_S, &m_T, &m_Tau};
+        for (int k = 0; k < 5 && !m_params_owned; k++)
+            m_param_store[k].append(params[k]->param());
+        m_params_owned = true;
+    }
+    // Free the old buffers once the solver references the new ones
+    void release_retired()
+    {
+        m_X_store.release();
+        for (auto& P: m_param_store)
+            P.release();
+    }
+
+public:
+
+    const Vector& beta() { return m_solver->get_beta_ref(); }
+    const Vector& xi() { return m_solver->get_xi_ref(); }
+    // Lambda and Gamma are views of buffers with spare columns, see
+    // rehline::ReHLineSolver::resize_samples()
+    using DualRef = Eigen::Ref<const Matrix, 0, Eigen::OuterStride<>>;
+    DualRef Lambda() { return m_solver->get_Lambda_ref(); }
+    DualRef Gamma() { return m_solver->get_Gamma_ref(); }
+    const std::vector<double>& dual_objfns() const { return m_dual_objfns; }
+    const std::vector<double>& primal_objfns() const { return m_primal_objfns; }
+};
+
+template <typename XArg>
+void define_persistent(py::module_& m, const char* name)
+{
+    using Persistent = ReHLinePersistent<XArg>;
+    // The views of beta and the dual variables keep the solver alive; the views of
+    // Lambda and Gamma are invalidated by append() and remove(), which may reallocate them
+    const auto view = py::return_value_policy::reference_internal;
+    py::class_<Persistent>(m, name)
+        .def(py::init<const XArg&, NumpyArray, const Eigen::Ref<const Vector>&,
+                      const ParamArg<double>&, const ParamArg<double>&, const ParamArg<double>&,
+                      const ParamArg<double>&, const ParamArg<double>&, bool, int, bool, int>(),
+             py::arg("X"), py::arg("A"), py::arg("b"), py::arg("U"), py::arg("V"),
+             py::arg("S"), py::arg("T"), py::arg("Tau"), py::arg("fused") = false,
+             py::arg("n_threads") = 1, py::arg("sync") = false, py::arg("block_size") = 0)
+        .def("solve",    &Persistent::solve, py::arg("max_iter"), py::arg("tol"), py::arg("shrink") = 1,
+             py::arg("verbose") = 0, py::arg("trace_freq") = 100, py::call_guard<py::gil_scoped_release>())
+        .def("set_loss", &Persistent::set_loss)
+        .def("append",   &Persistent::append)
+        .def("remove",   &Persistent::remove)
+        .def("loo_margins",   &Persistent::loo_margins, py::arg("idx"), py::arg("n_passes") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def("sample_losses", &Persistent::sample_losses, py::call_guard<py::gil_scoped_release>())
+        .def("set_b",    &Persistent::set_b)
+        .def("reset",    &Persistent::reset)
+        .def_property_readonly("beta",   &Persistent::beta, view)
+        .def_property_readonly("xi",     &Persistent::xi, view)
+        .def_property_readonly("Lambda", &Persistent::Lambda, view)
+        .def_property_readonly("Gamma",  &Persistent::Gamma, view)
+        .def_property_readonly("dual_objfns",   &Persistent::dual_objfns)
+        .def_property_readonly("primal_objfns", &Persistent::primal_objfns);
+}
+
+template <typename Scalar>
+void define_result(py::module_& m, const char* name)
+{
+    using Result = ReHLineResultT<Scalar>;
+    // Dynamic attributes hold the information added by the Python side, e.g. the plan
+    py::class_<Result>(m, name, py::dynamic_attr())
         .def(py::init<>())
-        .def_readwrite("beta",          &ReHLineResult::beta)
-        .def_readwrite("xi",            &ReHLineResult::xi)
-        .def_readwrite("Lambda",        &ReHLineResult::Lambda)
-        .def_readwrite("Gamma",         &ReHLineResult::Gamma)
-        .def_readwrite("niter",         &ReHLineResult::niter)
-        .def_readwrite("dual_objfns",   &ReHLineResult::dual_objfns)
-        .def_readwrite("primal_objfns", &ReHLineResult::primal_objfns);
+        .def_readwrite("beta",          &Result::beta)
+        .def_readwrite("xi",            &Result::xi)
+        .def_readwrite("Lambda",        &Result::Lambda)
+        .def_readwrite("Gamma",         &Result::Gamma)
+        .def_readwrite("niter",         &Result::niter)
+        .def_readwrite("dual_objfns",   &Result::dual_objfns)
+        .def_readwrite("primal_objfns", &Result::primal_objfns);
+}
+
+PYBIND11_MODULE(_internal, m) {
+    define_result<double>(m, "rehline_result");
+    define_result<float>(m, "rehline_result_float32");
+
+    py::class_<ReHLineBlock>(m, "rehline_block")
+        .def(py::init<NumpyArray, NumpyArray, NumpyArray, NumpyArray, NumpyArray,
+                      NumpyArray, NumpyArray, NumpyArray, int, bool>(),
+             py::arg("X"), py::arg("A"), py::arg("b"), py::arg("U"), py::arg("V"),
+             py::arg("S"), py::arg("T"), py::arg("Tau"), py::arg("seed") = 1, py::arg("fused") = false)
+        .def_property("beta", &ReHLineBlock::get_beta, &ReHLineBlock::set_beta)
+        .def_property_readonly("xi",     &ReHLineBlock::get_xi)
+        .def_property_readonly("Lambda", &ReHLineBlock::get_Lambda)
+        .def_property_readonly("Gamma",  &ReHLineBlock::get_Gamma)
+        .def("solve_local",    &ReHLineBlock::solve_local, py::call_guard<py::gil_scoped_release>())
+        .def("local_step",     &ReHLineBlock::local_step)
+        .def("set_step",       &ReHLineBlock::set_step)
+        .def("loss_objfn",     &ReHLineBlock::loss_objfn)
+        .def("dual_objfn_sep", &ReHLineBlock::dual_objfn_sep)
+        .def("local_primal",   &ReHLineBlock::local_primal);
+    define_persistent<NumpyArray>(m, "rehline_persistent");
+    define_persistent<CSRMatrix<double>>(m, "rehline_persistent_sparse");
 
     // https://hopstorawpointers.blogspot.com/2018/06/pybind11-and-python-sub-modules.html
     m.attr("__name__") = "rehline._internal";
     m.doc() = "rehline";
-    m.def("rehline_internal", &rehline_internal);
+    // The solvers run without the GIL, so that fits from different Python threads
+    // run in parallel; during the solve, the inputs are only read through raw pointers,
+    // and the verbose output goes to a PyStdout object of the call
+    const py::call_guard<py::gil_scoped_release> release_gil{};
+    // The double versions are registered first, so that mixed input types
+    // are converted to double
+    m.def("rehline_internal", &rehline_internal<double>, release_gil);
+    m.def("rehline_internal", &rehline_internal_sparse<double>, release_gil);
+    m.def("rehline_internal", &rehline_internal<float>, release_gil);
+    m.def("rehline_internal", &rehline_internal_sparse<float>, release_gil);
+    m.def("rehline_internal_replicated", &rehline_internal_replicated<double>, release_gil);
+    m.def("rehline_internal_replicated", &rehline_internal_replicated_sparse<double>, release_gil);
+    m.def("rehline_internal_replicated", &rehline_internal_replicated<float>, release_gil);
+    m.def("rehline_internal_replicated", &rehline_internal_replicated_sparse<float>, release_gil);
+    // The other layouts of a dense X are registered last, so that they are only
+    // chosen for arrays that would otherwise be copied
+    m.def("rehline_internal", &rehline_internal_view<double, ColMajorX>, release_gil);
+    m.def("rehline_internal", &rehline_internal_view<double, StridedX>, release_gil);
+    m.def("rehline_internal", &rehline_internal_view<float, ColMajorX>, release_gil);
+    m.def("rehline_internal", &rehline_internal_view<float, StridedX>, release_gil);
+    m.def("rehline_internal_replicated", &rehline_internal_replicated_view<double, ColMajorX>, release_gil);
+    m.def("rehline_internal_replicated", &rehline_internal_replicated_view<double, StridedX>, release_gil);
+    m.def("rehline_internal_replicated", &rehline_internal_replicated_view<float, ColMajorX>, release_gil);
+    m.def("rehline_internal_replicated", &rehline_internal_replicated_view<float, StridedX>, release_gil);
+    m.def("rehline_internal_quantized", &rehline_internal_quantized, release_gil);
+    m.def("rehline_internal_stream", &rehline_internal_stream, release_gil);
+    // rehline_batch() releases the GIL itself, after the problems are converted
+    m.def("rehline_batch", &rehline_batch);
+    m.def("rehline_internal_lanes", &rehline_internal_lanes<MapMatT<double>>, release_gil);
+    m.def("rehline_internal_lanes", &rehline_internal_lanes<CSRMatrix<double>>, release_gil);
+    m.def("rehline_internal_path", &rehline_internal_path<MapMatT<double>>, release_gil);
+    m.def("rehline_internal_path", &rehline_internal_path<CSRMatrix<double>>, release_gil);
 }
 
@@ -2,11 +2,27 @@
 #define REHLINE_H
 
 #include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
 #include <numeric>
+#include <iterator>
 #include <random>
 #include <type_traits>
 #include <iostream>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+#include <exception>
 #include <Eigen/Core>
+#include <Eigen/SparseCore>
 
 namespace rehline {
 
@@ -67,676 +83,3953 @@ void reset_fv_set(std::vector<std::pair<Index, Index>>& fvset, std::size_t n, st
         fvset[i] = std::make_pair(i % n, i / n);
 }
 
-
-}  // namespace internal
-// ========================= Internal utility functions ========================= //
-
-
-
-// Dimensions of the matrices involved
-// - Input
-//   * X        : [n x d]
-//   * U, V     : [L x n]
-//   * S, T, Tau: [H x n]
-//   * A        : [K x d]
-//   * b        : [K]
-// - Pre-computed
-//   * r: [n]
-//   * p: [K]
-// - Primal
-//   * beta: [d]
-// - Dual
-//   * xi    : [K]
-//   * Lambda: [L x n]
-//   * Gamma : [H x n]
-
-// Results of the optimization algorithm
-template <typename Matrix = Eigen::MatrixXd, typename Index = int>
-struct ReHLineResult
+// Type information of the data matrix X, which can be dense or sparse
+// - DenseMatrix   : dense matrix type for the other inputs and the dual variables,
+//                   with the same storage order as X
+// - RowMajorMatrix: row-majored version of the X type
+template <typename Matrix, bool IsSparse = std::is_base_of<Eigen::SparseMatrixBase<Matrix>, Matrix>::value>
+struct MatrixTraits
 {
     using Scalar = typename Matrix::Scalar;
-    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
-
-    Vector              beta;           // Primal variable
-    Vector              xi;             // Dual variables
-    Matrix              Lambda;         // Dual variables
-    Matrix              Gamma;          // Dual variables
-    Index               niter;          // Number of iterations
-    std::vector<Scalar> dual_objfns;    // Recorded dual objective function values
-    std::vector<Scalar> primal_objfns;  // Recorded primal objective function values
+    using DenseMatrix = Matrix;
+    using RowMajorMatrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
 };
 
-// The main ReHLine solver
-// "Matrix" is the type of input data matrix, can be row-majored or column-majored
-template <typename Matrix = Eigen::MatrixXd, typename Index = int>
-class ReHLineSolver
+template <typename Matrix>
+struct MatrixTraits<Matrix, true>
 {
-private:
     using Scalar = typename Matrix::Scalar;
-    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
-    using ConstRefMat = Eigen::Ref<const Matrix>;
-    using ConstRefVec = Eigen::Ref<const Vector>;
+    using DenseMatrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic,
+                                      Matrix::IsRowMajor ? Eigen::RowMajor : Eigen::ColMajor>;
+    using RowMajorMatrix = Eigen::SparseMatrix<Scalar, Eigen::RowMajor, typename Matrix::StorageIndex>;
+};
 
-    // We really want some matrices to be row-majored, since they can be more
-    // efficient in certain matrix operations, for example X.row(i).dot(v)
-    //
-    // If the data Matrix is already row-majored, we save a const reference;
-    // otherwise we make a copy
-    using RMatrix = typename std::conditional<
-        Matrix::IsRowMajor,
-        Eigen::Ref<const Matrix>,
-        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-    >::type;
+// Squared norms of the rows of a dense matrix
+template <typename Derived>
+Eigen::Matrix<typename Derived::Scalar, Eigen::Dynamic, 1>
+row_squared_norms(const Eigen::MatrixBase<Derived>& X)
+{
+    return X.rowwise().squaredNorm();
+}
 
-    // RNG
-    internal::SimpleRNG<Index> m_rng;
+// Squared norms of the rows of a sparse matrix, only visiting the nonzero elements
+template <typename Derived>
+Eigen::Matrix<typename Derived::Scalar, Eigen::Dynamic, 1>
+row_squared_norms(const Eigen::SparseMatrixBase<Derived>& X)
+{
+    using Scalar = typename Derived::Scalar;
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> res(X.rows());
+    for (Eigen::Index i = 0; i < X.rows(); i++)
+        res[i] = X.row(i).squaredNorm();
+    return res;
+}
 
-    // Dimensions
-    const Index m_n;
-    const Index m_d;
-    const Index m_L;
-    const Index m_H;
-    const Index m_K;
+// A vector of atomic variables, used to share beta among threads
+// All operations use the relaxed memory order: the coordinate updates
+// tolerate stale values (Hogwild-style), and only the additions need
+// to be atomic so that no update is lost
+template <typename Scalar>
+class AtomicVector
+{
+private:
+    std::unique_ptr<std::atomic<Scalar>[]> m_data;
+    std::size_t                            m_size;
 
-    // Input matrices and vectors
-    RMatrix     m_X;
-    ConstRefMat m_U;
-    ConstRefMat m_V;
-    ConstRefMat m_S;
-    ConstRefMat m_T;
-    ConstRefMat m_Tau;
-    RMatrix     m_A;
-    ConstRefVec m_b;
+public:
+    AtomicVector() : m_size(0) {}
 
-    // Pre-computed
-    Vector m_gk_denom;   // ||a[k]||^2
-    Matrix m_gli_denom;  // (u[li] * ||x[i]||)^2
-    Matrix m_ghi_denom;  // (s[hi] * ||x[i]||)^2 + 1
+    // Copy values from a vector
+    template <typename Vec>
+    void assign(const Vec& v)
+    {
+        const std::size_t n = v.size();
+        if (m_size != n)
+        {
+            m_data.reset(new std::atomic<Scalar>[n]);
+            m_size = n;
+        }
+        for (std::size_t i = 0; i < n; i++)
+            m_data[i].store(v[i], std::memory_order_relaxed);
+    }
 
-    // Primal variable
-    Vector m_beta;
+    // Copy values to a vector
+    template <typename Vec>
+    void copy_to(Vec& v) const
+    {
+        for (std::size_t i = 0; i < m_size; i++)
+            v[i] = m_data[i].load(std::memory_order_relaxed);
+    }
 
-    // Dual variables
-    Vector m_xi;
-    Matrix m_Lambda;
-    Matrix m_Gamma;
+    Scalar load(std::size_t i) const { return m_data[i].load(std::memory_order_relaxed); }
 
-    // Free variable sets
-    std::vector<Index> m_fv_feas;
-    std::vector<std::pair<Index, Index>> m_fv_relu;
-    std::vector<std::pair<Index, Index>> m_fv_rehu;
+    // v[i] <- v[i] + a
+    void add(std::size_t i, Scalar a)
+    {
+        Scalar old = m_data[i].load(std::memory_order_relaxed);
+        while (!m_data[i].compare_exchange_weak(old, old + a, std::memory_order_relaxed)) {}
+    }
+};
 
-    // =================== Initialization functions =================== //
+// x[i]' * v for a dense row-majored X and an atomic vector v
+template <typename Derived, typename Scalar>
+Scalar row_dot(const Eigen::MatrixBase<Derived>& X, Eigen::Index i, const AtomicVector<Scalar>& v)
+{
+    Scalar res = Scalar(0);
+    const Eigen::Index p = X.cols();
+    for (Eigen::Index j = 0; j < p; j++)
+        res += X.coeff(i, j) * v.load(j);
+    return res;
+}
 
-    // Compute the primal variable beta from dual variables
-    // beta = A'xi - U3 * vec(Lambda) - S3 * vec(Gamma)
-    // A can be empty, one of U and V may be empty
-    inline void set_primal()
+// x[i]' * v for a sparse row-majored X and an atomic vector v
+template <typename Derived, typename Scalar>
+Scalar row_dot(const Eigen::SparseMatrixBase<Derived>& X, Eigen::Index i, const AtomicVector<Scalar>& v)
+{
+    Scalar res = Scalar(0);
+    for (typename Derived::InnerIterator it(X.derived(), i); it; ++it)
+        res += it.value() * v.load(it.index());
+    return res;
+}
+
+// v <- v + a * x[i] for a dense row-majored X and an atomic vector v
+template <typename Derived, typename Scalar>
+void row_axpy(const Eigen::MatrixBase<Derived>& X, Eigen::Index i, Scalar a, AtomicVector<Scalar>& v)
+{
+    const Eigen::Index p = X.cols();
+    for (Eigen::Index j = 0; j < p; j++)
     {
-        // Initialize beta to zero
-        m_beta.setZero();
+        const Scalar xij = X.coeff(i, j);
+        if (xij != Scalar(0))
+            v.add(j, a * xij);
+    }
+}
 
-        // First term
-        if (m_K > 0)
-            m_beta.noalias() = m_A.transpose() * m_xi;
+// v <- v + a * x[i] for a sparse row-majored X and an atomic vector v
+template <typename Derived, typename Scalar>
+void row_axpy(const Eigen::SparseMatrixBase<Derived>& X, Eigen::Index i, Scalar a, AtomicVector<Scalar>& v)
+{
+    for (typename Derived::InnerIterator it(X.derived(), i); it; ++it)
+        v.add(it.index(), a * it.value());
+}
 
-        // [n x 1]
-        Vector LHterm = Vector::Zero(m_n);
-        if (m_L > 0)
-            LHterm.noalias() = m_U.cwiseProduct(m_Lambda).colwise().sum().transpose();
-        // [n x 1]
-        if (m_H > 0)
-            LHterm.noalias() += m_S.cwiseProduct(m_Gamma).colwise().sum().transpose();
+// x[i]' * v and v <- v + a * x[i] for a row-majored Eigen matrix X and a dense vector v
+template <typename Derived, typename Vec>
+typename Derived::Scalar row_dot(const Eigen::EigenBase<Derived>& X, Eigen::Index i, const Eigen::MatrixBase<Vec>& v)
+{
+    return X.derived().row(i).dot(v);
+}
+template <typename Derived>
+void row_axpy(const Eigen::EigenBase<Derived>& X, Eigen::Index i, typename Derived::Scalar a,
+              Eigen::Matrix<typename Derived::Scalar, Eigen::Dynamic, 1>& v)
+{
+    v += a * X.derived().row(i).transpose();
+}
 
-        m_beta.noalias() -= m_X.transpose() * LHterm;
-    }
+// x[i]' * W and W <- W + x[i] * a' for a row-majored X, a [d x B] matrix W, and a [B]
+// row vector a, used by the lanes of ReHLineLaneSolver
+// For a sparse X, only the rows of W of the nonzero elements of x[i] are visited
+template <typename Derived, typename MatW, typename VecA>
+void row_gemv(const Eigen::MatrixBase<Derived>& X, Eigen::Index i, const MatW& W, VecA& res)
+{
+    res.noalias() = X.row(i) * W;
+}
+template <typename Derived, typename MatW, typename VecA>
+void row_gemv(const Eigen::SparseMatrixBase<Derived>& X, Eigen::Index i, const MatW& W, VecA& res)
+{
+    res.setZero();
+    for (typename Derived::InnerIterator it(X.derived(), i); it; ++it)
+        res.noalias() += it.value() * W.row(it.index());
+}
+template <typename Derived, typename MatW, typename VecA>
+void row_ger(const Eigen::MatrixBase<Derived>& X, Eigen::Index i, const VecA& a, MatW& W)
+{
+    W.noalias() += X.row(i).transpose() * a;
+}
+template <typename Derived, typename MatW, typename VecA>
+void row_ger(const Eigen::SparseMatrixBase<Derived>& X, Eigen::Index i, const VecA& a, MatW& W)
+{
+    for (typename Derived::InnerIterator it(X.derived(), i); it; ++it)
+        W.row(it.index()).noalias() += it.value() * a;
+}
 
-    // =================== Evaluating objection function =================== //
+// X * v and X' * v for an Eigen matrix X
+template <typename Derived, typename Vec>
+Eigen::Matrix<typename Derived::Scalar, Eigen::Dynamic, 1>
+mat_vec(const Eigen::EigenBase<Derived>& X, const Eigen::MatrixBase<Vec>& v)
+{
+    return X.derived() * v;
+}
+template <typename Derived, typename Vec>
+Eigen::Matrix<typename Derived::Scalar, Eigen::Dynamic, 1>
+mat_tvec(const Eigen::EigenBase<Derived>& X, const Eigen::MatrixBase<Vec>& v)
+{
+    return X.derived().transpose() * v;
+}
 
-    // Compute the primal objective function value
-    inline Scalar primal_objfn() const
+// ======================= Low-precision storage of X ======================= //
+
+// Brain floating point format: the upper 16 bits of a float
+struct bfloat16
+{
+    std::uint16_t bits;
+};
+
+// Conversion between a Scalar and the stored code of an element of X
+// If "scaled" is true, each row has its own scale, and x[i][j] = scale[i] * decode(code)
+template <typename Code>
+struct QuantCodec;
+
+template <>
+struct QuantCodec<float>
+{
+    static constexpr bool scaled = false;
+    template <typename Scalar>
+    static float encode(Scalar x) { return float(x); }
+    static float decode(float c) { return c; }
+};
+
+template <>
+struct QuantCodec<bfloat16>
+{
+    static constexpr bool scaled = false;
+    // Round to the nearest even
+    template <typename Scalar>
+    static bfloat16 encode(Scalar x)
     {
-        Scalar result = Scalar(0);
-        const Vector Xbeta = m_X * m_beta;
-        // ReLU part
-        if (m_L > 0)
-        {
-            result += (m_U.cwiseProduct(Xbeta.transpose().replicate(1, m_L)) +
-                m_V).cwiseMax(Scalar(0)).sum();
-        }
-        // ReHU part
-        if (m_H > 0)
-        {
-            const Matrix z = (m_S.cwiseProduct(Xbeta.transpose().replicate(1, m_H)) +
-                m_T).cwiseMax(Scalar(0));
-            result += (z.array() <= m_Tau.array()).select(
-                z.array().square() * Scalar(0.5),
-                m_Tau.array() * (z.array() - m_Tau.array() * Scalar(0.5))
-            ).sum();
-        }
-        // Quadratic term
-        result += Scalar(0.5) * m_beta.squaredNorm();
-        return result;
+        const float f = float(x);
+        std::uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        u += 0x7FFFu + ((u >> 16) & 1u);
+        bfloat16 c;
+        c.bits = std::uint16_t(u >> 16);
+        return c;
+    }
+    static float decode(bfloat16 c)
+    {
+        const std::uint32_t u = std::uint32_t(c.bits) << 16;
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
     }
+};
 
-    // Compute the dual objective function value
-    inline Scalar dual_objfn() const
+template <>
+struct QuantCodec<std::int8_t>
+{
+    // scale[i] = max_j |x[i][j]| / 127
+    static constexpr bool scaled = true;
+    static constexpr int max_code = 127;
+    template <typename Scalar>
+    static std::int8_t encode(Scalar x)
     {
-        // A' * xi, [d x 1], A[K x d] may be empty
-        Vector Atxi = Vector::Zero(m_d);
-        if (m_K > 0)
-            Atxi.noalias() = m_A.transpose() * m_xi;
-        // U3 * vec(Lambda), [n x 1], U[L x n] may be empty
-        Vector UL(m_n), U3L = Vector::Zero(m_d);
-        if (m_L > 0)
-        {
-            UL.noalias() = m_U.cwiseProduct(m_Lambda).colwise().sum().transpose();
-            U3L.noalias() = m_X.transpose() * UL;
-        }
-        // S3 * vec(Gamma), [n x 1], S[H x n] may be empty
-        Vector SG(m_n), S3G = Vector::Zero(m_d);
-        if (m_H > 0)
-        {
-            SG.noalias() = m_S.cwiseProduct(m_Gamma).colwise().sum().transpose();
-            S3G.noalias() = m_X.transpose() * SG;
-        }
+        const Scalar r = std::round(x);
+        return std::int8_t(std::max(Scalar(-max_code), std::min(Scalar(max_code), r)));
+    }
+    static float decode(std::int8_t c) { return float(c); }
+};
 
-        // Compute dual objective function value
-        Scalar obj = Scalar(0);
-        // If K = 0, all terms that depend on A, xi, or b will be zero
-        if (m_K > 0)
-        {
-            // 0.5 * ||Atxi||^2 - Atxi' * U3L - Atxi' * S3G + xi' * b
-            const Scalar Atxi_U3L = (m_L > 0) ? (Atxi.dot(U3L)) : Scalar(0);
-            const Scalar Atxi_S3G = (m_H > 0) ? (Atxi.dot(S3G)) : Scalar(0);
-            obj += Scalar(0.5) * Atxi.squaredNorm() - Atxi_U3L - Atxi_S3G + m_xi.dot(m_b);
-        }
-        // If L = 0, all terms that depend on U, V, or Lambda will be zero
-        if (m_L > 0)
-        {
-            // 0.5 * ||U3L||^2 + U3L' * S3G - tr(Lambda * V')
-            const Scalar U3L_S3G = (m_H > 0) ? (U3L.dot(S3G)) : Scalar(0);
-            obj += Scalar(0.5) * U3L.squaredNorm() + U3L_S3G -
-                m_Lambda.cwiseProduct(m_V).sum();
-        }
-        // If H = 0, all terms that depend on S, T, or Gamma will be zero
-        if (m_H > 0)
-        {
-            // 0.5 * ||S3G||^2 + 0.5 * ||Gamma||^2 - tr(Gamma * T')
-            obj += Scalar(0.5) * S3G.squaredNorm() + Scalar(0.5) * m_Gamma.squaredNorm() -
-                m_Gamma.cwiseProduct(m_T).sum();
-        }
+// A dense data matrix stored row by row in a low-precision Code type,
+// quantized once at construction
+// Rows are decoded on the fly, and all arithmetic is done in Scalar, so the
+// solver is exact for the stored (dequantized) matrix
+template <typename Code, typename Scalar>
+class QuantizedMatrix
+{
+private:
+    using Codec = QuantCodec<Code>;
+    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
 
-        return obj;
-    }
+    Eigen::Index        m_rows;
+    Eigen::Index        m_cols;
+    std::vector<Code>   m_codes;  // [n x d], row-majored
+    std::vector<Scalar> m_scale;  // [n], only used if Codec::scaled is true
 
-    // =================== Updating functions (sequential) =================== //
+    const Code* row_codes(Eigen::Index i) const { return m_codes.data() + i * m_cols; }
 
-    // Update xi and beta
-    inline void update_xi_beta()
+public:
+    template <typename Derived>
+    explicit QuantizedMatrix(const Eigen::MatrixBase<Derived>& X) :
+        m_rows(X.rows()), m_cols(X.cols()), m_codes(X.rows() * X.cols()),
+        m_scale(Codec::scaled ? X.rows() : 0)
     {
-        if (m_K < 1)
-            return;
-
-        for (Index k = 0; k < m_K; k++)
+        for (Eigen::Index i = 0; i < m_rows; i++)
         {
-            const Scalar xi_k = m_xi[k];
-
-            // Compute g_k
-            const Scalar g_k = m_A.row(k).dot(m_beta) + m_b[k];
-            // Compute new xi_k
-            const Scalar candid = xi_k - g_k / m_gk_denom[k];
-            const Scalar newxi = std::max(Scalar(0), candid);
-            // Update xi and beta
-            m_xi[k] = newxi;
-            m_beta.noalias() += (newxi - xi_k) * m_A.row(k).transpose();
+            Scalar inv_scale = Scalar(1);
+            if (Codec::scaled)
+            {
+                const Scalar amax = Scalar(X.row(i).cwiseAbs().maxCoeff());
+                m_scale[i] = (amax > Scalar(0)) ? (amax / Scalar(QuantCodec<std::int8_t>::max_code)) : Scalar(1);
+                inv_scale = Scalar(1) / m_scale[i];
+            }
+            Code* c = m_codes.data() + i * m_cols;
+            for (Eigen::Index j = 0; j < m_cols; j++)
+                c[j] = Codec::encode(Scalar(X.coeff(i, j)) * inv_scale);
         }
     }
 
-    // Update Lambda and beta
-    inline void update_Lambda_beta()
+    Eigen::Index rows() const { return m_rows; }
+    Eigen::Index cols() const { return m_cols; }
+
+    Scalar row_scale(Eigen::Index i) const { return Codec::scaled ? m_scale[i] : Scalar(1); }
+
+    // x[i]' * v, where v can be a dense vector or an atomic vector
+    template <typename Vec>
+    Scalar dot(Eigen::Index i, const Vec& v) const
     {
-        if (m_L < 1)
-            return;
+        const Code* c = row_codes(i);
+        Scalar res = Scalar(0);
+        for (Eigen::Index j = 0; j < m_cols; j++)
+            res += Scalar(Codec::decode(c[j])) * load(v, j);
+        return row_scale(i) * res;
+    }
 
-        for (Index i = 0; i < m_n; i++)
+    // v <- v + a * x[i]
+    void axpy(Eigen::Index i, Scalar a, Vector& v) const
+    {
+        const Code* c = row_codes(i);
+        a *= row_scale(i);
+        for (Eigen::Index j = 0; j < m_cols; j++)
+            v[j] += a * Scalar(Codec::decode(c[j]));
+    }
+    void axpy(Eigen::Index i, Scalar a, AtomicVector<Scalar>& v) const
+    {
+        const Code* c = row_codes(i);
+        a *= row_scale(i);
+        for (Eigen::Index j = 0; j < m_cols; j++)
         {
-            for (Index l = 0; l < m_L; l++)
-            {
-                const Scalar u_li = m_U(l, i);
-                const Scalar v_li = m_V(l, i);
-                const Scalar lambda_li = m_Lambda(l, i);
-
-                // Compute g_li
-                const Scalar g_li = -(u_li * m_X.row(i).dot(m_beta) + v_li);
-                // Compute new lambda_li
-                const Scalar candid = lambda_li - g_li / m_gli_denom(l, i);
-                const Scalar newl = std::max(Scalar(0), std::min(Scalar(1), candid));
-                // Update Lambda and beta
-                m_Lambda(l, i) = newl;
-                m_beta.noalias() -= (newl - lambda_li) * u_li * m_X.row(i).transpose();
-            }
+            const Scalar xij = Scalar(Codec::decode(c[j]));
+            if (xij != Scalar(0))
+                v.add(j, a * xij);
         }
     }
 
-    // Update Gamma, and beta
-    inline void update_Gamma_beta()
+    // Squared norms of the dequantized rows
+    Vector row_squared_norms() const
     {
-        if (m_H < 1)
-            return;
-
-        for (Index i = 0; i < m_n; i++)
+        Vector res(m_rows);
+        for (Eigen::Index i = 0; i < m_rows; i++)
         {
-            for (Index h = 0; h < m_H; h++)
+            const Code* c = row_codes(i);
+            Scalar s = Scalar(0);
+            for (Eigen::Index j = 0; j < m_cols; j++)
             {
-                // tau_hi can be Inf
-                const Scalar tau_hi = m_Tau(h, i);
-                const Scalar gamma_hi = m_Gamma(h, i);
-                const Scalar s_hi = m_S(h, i);
-                const Scalar t_hi = m_T(h, i);
-
-                // Compute g_hi
-                const Scalar g_hi = gamma_hi - (s_hi * m_X.row(i).dot(m_beta) + t_hi);
-                // Compute new gamma_hi
-                const Scalar candid = gamma_hi - g_hi / m_ghi_denom(h, i);
-                const Scalar newg = std::max(Scalar(0), std::min(tau_hi, candid));
-                // Update Gamma and beta
-                m_Gamma(h, i) = newg;
-                m_beta.noalias() -= (newg - gamma_hi) * s_hi * m_X.row(i).transpose();
+                const Scalar xij = Scalar(Codec::decode(c[j]));
+                s += xij * xij;
             }
+            res[i] = row_scale(i) * row_scale(i) * s;
         }
+        return res;
     }
 
-    // =================== Updating functions (free variable set) ================ //
+private:
+    template <typename Vec>
+    static Scalar load(const Vec& v, Eigen::Index j) { return v[j]; }
+    static Scalar load(const AtomicVector<Scalar>& v, Eigen::Index j) { return v.load(j); }
+};
 
-    // Determine whether to shrink xi, and compute the projected gradient (PG)
-    // Shrink if xi=0 and grad>ub
-    // PG is zero if xi=0 and grad>=0
-    inline bool pg_xi(Scalar xi, Scalar grad, Scalar ub, Scalar& pg) const
-    {
-        pg = (xi == Scalar(0) && grad >= Scalar(0)) ? Scalar(0) : grad;
-        const bool shrink = (xi == Scalar(0)) && (grad > ub);
-        return shrink;
-    }
-    // Update xi and beta
-    // Overloaded version based on free variable set
-    inline void update_xi_beta(std::vector<Index>& fv_set, Scalar& min_pg, Scalar& max_pg)
-    {
-        if (m_K < 1)
-            return;
+template <typename Code, typename Scalar>
+Eigen::Matrix<Scalar, Eigen::Dynamic, 1> row_squared_norms(const QuantizedMatrix<Code, Scalar>& X)
+{
+    return X.row_squared_norms();
+}
+template <typename Code, typename Scalar, typename Vec>
+Scalar row_dot(const QuantizedMatrix<Code, Scalar>& X, Eigen::Index i, const Vec& v)
+{
+    return X.dot(i, v);
+}
+template <typename Code, typename Scalar, typename Vec>
+void row_axpy(const QuantizedMatrix<Code, Scalar>& X, Eigen::Index i, Scalar a, Vec& v)
+{
+    X.axpy(i, a, v);
+}
+template <typename Code, typename Scalar, typename Vec>
+Eigen::Matrix<Scalar, Eigen::Dynamic, 1> mat_vec(const QuantizedMatrix<Code, Scalar>& X, const Vec& v)
+{
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> res(X.rows());
+    for (Eigen::Index i = 0; i < X.rows(); i++)
+        res[i] = X.dot(i, v);
+    return res;
+}
+template <typename Code, typename Scalar, typename Vec>
+Eigen::Matrix<Scalar, Eigen::Dynamic, 1> mat_tvec(const QuantizedMatrix<Code, Scalar>& X, const Vec& v)
+{
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> res = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>::Zero(X.cols());
+    for (Eigen::Index i = 0; i < X.rows(); i++)
+        X.axpy(i, Scalar(v[i]), res);
+    return res;
+}
 
-        // Permutation
-        internal::random_shuffle(fv_set.begin(), fv_set.end(), m_rng);
-        // New free variable set
-        std::vector<Index> new_set;
-        new_set.reserve(fv_set.size());
+// ==================== Block-replicated design of multiple quantiles ==================== //
 
-        // Compute shrinking threshold ub
-        // ub is kept unchanged in each outer iteration,
-        // and is determined by the maximum PG in the previous outer iteration (i.e., max_pg)
-        // If the input max_pg is zero or negative, let ub be Inf (do not shrink)
-        // This happens when:
-        //     (1) max_pg is initialized to be zero in the first iteration
-        //     (2) max_pg is negative, thus not meaningful
-        constexpr Scalar Inf = std::numeric_limits<Scalar>::infinity();
-        const Scalar ub = (max_pg > Scalar(0)) ? max_pg : Inf;
-        // Compute minimum and maximum projected gradient (PG) for this round (outer iteration)
-        min_pg = Inf;
-        max_pg = -Inf;
-        for (auto k: fv_set)
+// The design matrix of multi-quantile regression, [X, e_1; X, e_2; ...; X, e_m],
+// where X [n x d] is repeated for each of the m quantiles and e_l is the
+// indicator column of the l-th intercept, without being materialized
+// Row l * n + i is (x[i], e_l), so that beta = (slope [d], intercepts [m])
+// XMat is a dense or sparse row-majored matrix type, or a dense view of any layout
+template <typename XMat>
+class ReplicatedMatrix
+{
+private:
+    using Scalar = typename XMat::Scalar;
+    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+    XMat         m_X;
+    Eigen::Index m_n;
+    Eigen::Index m_d;
+    Eigen::Index m_rep;
+
+public:
+    template <typename Derived>
+    ReplicatedMatrix(const Derived& X, Eigen::Index n_rep) :
+        m_X(X), m_n(X.rows()), m_d(X.cols()), m_rep(n_rep)
+    {}
+
+    template <typename Other>
+    ReplicatedMatrix(const ReplicatedMatrix<Other>& X) :
+        m_X(X.base()), m_n(X.base().rows()), m_d(X.base().cols()), m_rep(X.n_rep())
+    {}
+
+    Eigen::Index rows() const { return m_n * m_rep; }
+    Eigen::Index cols() const { return m_d + m_rep; }
+    Eigen::Index n_rep() const { return m_rep; }
+    const XMat& base() const { return m_X; }
+
+    // x[i]' * v and v <- v + a * x[i]
+    template <typename Vec>
+    Scalar dot(Eigen::Index i, const Eigen::MatrixBase<Vec>& v) const
+    {
+        return m_X.row(i % m_n).dot(v.head(m_d)) + v[m_d + i / m_n];
+    }
+    Scalar dot(Eigen::Index i, const AtomicVector<Scalar>& v) const
+    {
+        // Only the first d elements of v are read by row_dot()
+        return row_dot(m_X, i % m_n, v) + v.load(m_d + i / m_n);
+    }
+    void axpy(Eigen::Index i, Scalar a, Vector& v) const
+    {
+        v.head(m_d) += a * m_X.row(i % m_n).transpose();
+        v[m_d + i / m_n] += a;
+    }
+    void axpy(Eigen::Index i, Scalar a, AtomicVector<Scalar>& v) const
+    {
+        row_axpy(m_X, i % m_n, a, v);
+        v.add(m_d + i / m_n, a);
+    }
+
+    // ||x[i]||^2 + 1, computed once for the rows of X
+    Vector row_squared_norms() const
+    {
+        const Vector xn = internal::row_squared_norms(m_X);
+        Vector res(rows());
+        for (Eigen::Index l = 0; l < m_rep; l++)
+            res.segment(l * m_n, m_n).array() = xn.array() + Scalar(1);
+        return res;
+    }
+
+    template <typename Vec>
+    Vector mat_vec(const Vec& v) const
+    {
+        const Vector Xv = internal::mat_vec(m_X, v.head(m_d));
+        Vector res(rows());
+        for (Eigen::Index l = 0; l < m_rep; l++)
+            res.segment(l * m_n, m_n).array() = Xv.array() + v[m_d + l];
+        return res;
+    }
+
+    // X' * (v_1 + ... + v_m) for the slope, so that X is read once
+    template <typename Vec>
+    Vector mat_tvec(const Vec& v) const
+    {
+        Vector vsum = Vector::Zero(m_n);
+        Vector res(cols());
+        for (Eigen::Index l = 0; l < m_rep; l++)
         {
-            const Scalar xi_k = m_xi[k];
+            vsum.noalias() += v.segment(l * m_n, m_n);
+            res[m_d + l] = v.segment(l * m_n, m_n).sum();
+        }
+        res.head(m_d).noalias() = internal::mat_tvec(m_X, vsum);
+        return res;
+    }
+};
 
-            // Compute g_k
-            const Scalar g_k = m_A.row(k).dot(m_beta) + m_b[k];
-            // PG and shrink
-            Scalar pg;
-            const bool shrink = pg_xi(xi_k, g_k, ub, pg);
-            if (shrink)
-               continue;
+template <typename XMat>
+Eigen::Matrix<typename XMat::Scalar, Eigen::Dynamic, 1> row_squared_norms(const ReplicatedMatrix<XMat>& X)
+{
+    return X.row_squared_norms();
+}
+template <typename XMat, typename Vec>
+typename XMat::Scalar row_dot(const ReplicatedMatrix<XMat>& X, Eigen::Index i, const Vec& v)
+{
+    return X.dot(i, v);
+}
+template <typename XMat, typename Vec>
+void row_axpy(const ReplicatedMatrix<XMat>& X, Eigen::Index i, typename XMat::Scalar a, Vec& v)
+{
+    X.axpy(i, a, v);
+}
+template <typename XMat, typename Vec>
+Eigen::Matrix<typename XMat::Scalar, Eigen::Dynamic, 1> mat_vec(const ReplicatedMatrix<XMat>& X, const Vec& v)
+{
+    return X.mat_vec(v);
+}
+template <typename XMat, typename Vec>
+Eigen::Matrix<typename XMat::Scalar, Eigen::Dynamic, 1> mat_tvec(const ReplicatedMatrix<XMat>& X, const Vec& v)
+{
+    return X.mat_tvec(v);
+}
 
-            // Update PG bounds
-            max_pg = std::max(max_pg, pg);
-            min_pg = std::min(min_pg, pg);
-            // Compute new xi_k
-            const Scalar candid = xi_k - g_k / m_gk_denom[k];
-            const Scalar newxi = std::max(Scalar(0), candid);
-            // Update xi and beta
-            m_xi[k] = newxi;
-            m_beta.noalias() += (newxi - xi_k) * m_A.row(k).transpose();
+// ======================= Compressed loss parameters ======================= //
 
-            // Add to new free variable set
-            new_set.push_back(k);
+// A loss parameter matrix (U, V, S, T, or Tau) of size [rows x cols], which is
+// either dense, or has the compressed form
+//     M(l, i) = coef[l] * vec[i] + offset[l],
+// which covers a scalar, a constant for each row, and rank-one matrices such as
+// U = -C * y' of the SVM, in O(rows + cols) memory
+// The data are referenced, not copied
+template <typename DenseMatrix>
+class ParamMatrix
+{
+private:
+    using Scalar = typename DenseMatrix::Scalar;
+    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+    using DenseMap = Eigen::Map<const DenseMatrix, 0, Eigen::OuterStride<>>;
+    using VectorMap = Eigen::Map<const Vector>;
+
+    Eigen::Index m_rows;
+    Eigen::Index m_cols;
+    bool         m_dense;
+    DenseMap     m_mat;     // dense form
+    VectorMap    m_coef;    // [rows]
+    VectorMap    m_vec;     // [cols], or empty if coef is zero
+    VectorMap    m_offset;  // [rows]
+
+public:
+    // Dense form, referencing a matrix with the storage order of DenseMatrix
+    template <typename Derived>
+    ParamMatrix(const Eigen::DenseBase<Derived>& M) :
+        m_rows(M.rows()), m_cols(M.cols()), m_dense(true),
+        m_mat(M.derived().data(), M.rows(), M.cols(), Eigen::OuterStride<>(M.derived().outerStride())),
+        m_coef(nullptr, 0), m_vec(nullptr, 0), m_offset(nullptr, 0)
+    {
+        static_assert(bool(Derived::IsRowMajor) == bool(DenseMatrix::IsRowMajor),
+                      "the dense loss parameters must have the storage order of the data matrix");
+    }
+
+    // Compressed form, where vec can be nullptr
+    ParamMatrix(Eigen::Index rows, Eigen::Index cols,
+                const Scalar* coef, const Scalar* vec, const Scalar* offset) :
+        m_rows(rows), m_cols(cols), m_dense(false),
+        m_mat(nullptr, 0, 0, Eigen::OuterStride<>(0)),
+        m_coef(coef, rows), m_vec(vec, vec ? cols : 0), m_offset(offset, rows)
+    {}
+
+    ParamMatrix(const ParamMatrix&) = default;
+
+    // Assignment makes this object reference the data of other, using the
+    // placement new that Eigen documents for changing the array of a Map
+    ParamMatrix& operator=(const ParamMatrix& other)
+    {
+        m_rows = other.m_rows;
+        m_cols = other.m_cols;
+        m_dense = other.m_dense;
+        new (&m_mat) DenseMap(other.m_mat.data(), other.m_mat.rows(), other.m_mat.cols(),
+                              Eigen::OuterStride<>(other.m_mat.outerStride()));
+        new (&m_coef) VectorMap(other.m_coef.data(), other.m_coef.size());
+        new (&m_vec) VectorMap(other.m_vec.data(), other.m_vec.size());
+        new (&m_offset) VectorMap(other.m_offset.data(), other.m_offset.size());
+        return *this;
+    }
+
+    Eigen::Index rows() const { return m_rows; }
+    Eigen::Index cols() const { return m_cols; }
+    bool is_dense() const { return m_dense; }
+
+    Scalar operator()(Eigen::Index l, Eigen::Index i) const
+    {
+        if (m_dense)
+            return m_mat(l, i);
+        return (m_vec.size() > 0) ? (m_coef[l] * m_vec[i] + m_offset[l]) : m_offset[l];
+    }
+
+    // Columns of the matrix with the dense/compressed form resolved once, read as
+    // M(l, i) = a[l * a_row + i * a_col] * w[i * w_inc] + c[l * c_inc] in every form,
+    // so that a column is loaded with no branch per sample
+    struct ColReader
+    {
+        const Scalar* a;
+        Eigen::Index  a_row;
+        Eigen::Index  a_col;
+        const Scalar* w;
+        Eigen::Index  w_inc;
+        const Scalar* c;
+        Eigen::Index  c_inc;
+
+        void col(Eigen::Index i, Eigen::Index n, Scalar* out) const
+        {
+            const Scalar* ai = a + i * a_col;
+            const Scalar wi = w[i * w_inc];
+            for (Eigen::Index l = 0; l < n; l++)
+                out[l] = ai[l * a_row] * wi + c[l * c_inc];
         }
+    };
 
-        // Update free variable set
-        fv_set.swap(new_set);
+    ColReader col_reader() const
+    {
+        static const Scalar one(1), zero(0);
+        // Dense: a = M, w = 1, c = 0
+        if (m_dense)
+            return ColReader{m_mat.data(), m_mat.rowStride(), m_mat.colStride(), &one, 0, &zero, 0};
+        // Compressed: a = coef, w = vec, c = offset
+        if (m_vec.size() > 0)
+            return ColReader{m_coef.data(), 1, 0, m_vec.data(), 1, m_offset.data(), 1};
+        // Compressed without vec: a = offset, w = 1, c = 0
+        return ColReader{m_offset.data(), 1, 0, &one, 0, &zero, 0};
     }
 
-    // Determine whether to shrink lambda, and compute the projected gradient (PG)
-    // Shrink if (lambda=0 and grad>ub) or (lambda=1 and grad<lb)
-    // PG is zero if (lambda=0 and grad>=0) or (lambda=1 and grad<=0)
-    inline bool pg_lambda(Scalar lambda, Scalar grad, Scalar lb, Scalar ub, Scalar& pg) const
+    // The l-th row as a dense vector
+    Vector row(Eigen::Index l) const
     {
-        pg = ((lambda == Scalar(0) && grad >= Scalar(0)) || (lambda == Scalar(1) && grad <= Scalar(0))) ?
-             Scalar(0) :
-             grad;
-        const bool shrink = (lambda == Scalar(0) && grad > ub) || (lambda == Scalar(1) && grad < lb);
-        return shrink;
+        if (m_dense)
+            return m_mat.row(l).transpose();
+        if (m_vec.size() > 0)
+            return (m_coef[l] * m_vec.array() + m_offset[l]).matrix();
+        return Vector::Constant(m_cols, m_offset[l]);
     }
-    // Update Lambda and beta
-    // Overloaded version based on free variable set
-    inline void update_Lambda_beta(std::vector<std::pair<Index, Index>>& fv_set, Scalar& min_pg, Scalar& max_pg)
+
+    // The columns [begin, begin + n)
+    ParamMatrix middle_cols(Eigen::Index begin, Eigen::Index n) const
     {
-        if (m_L < 1)
-            return;
+        // An empty parameter, e.g., S, T, and Tau when H = 0, may be given as [0 x 0]
+        if (m_rows == 0)
+            return ParamMatrix(0, n, nullptr, nullptr, nullptr);
+        if (m_dense)
+            return ParamMatrix(m_mat.middleCols(begin, n));
+        return ParamMatrix(m_rows, n, m_coef.data(), m_vec.size() > 0 ? m_vec.data() + begin : nullptr,
+                           m_offset.data());
+    }
 
-        // Permutation
-        internal::random_shuffle(fv_set.begin(), fv_set.end(), m_rng);
-        // New free variable set
-        std::vector<std::pair<Index, Index>> new_set;
-        new_set.reserve(fv_set.size());
+    // sum_l M(l, i) * W(l, i) for each column i
+    template <typename Derived>
+    Vector colwise_dot(const Eigen::MatrixBase<Derived>& W) const
+    {
+        if (m_dense)
+            return m_mat.cwiseProduct(W).colwise().sum().transpose();
+        Vector res = W.transpose() * m_offset;
+        if (m_vec.size() > 0)
+            res.array() += m_vec.array() * (W.transpose() * m_coef).array();
+        return res;
+    }
 
-        // Compute shrinking thresholds lb and ub
-        // More details explained in update_xi_beta()
-        constexpr Scalar Inf = std::numeric_limits<Scalar>::infinity();
-        const Scalar lb = (min_pg < Scalar(0)) ? min_pg : -Inf;
-        const Scalar ub = (max_pg > Scalar(0)) ? max_pg : Inf;
-        // Compute minimum and maximum projected gradient (PG) for this round
-        min_pg = Inf;
-        max_pg = -Inf;
-        for (auto rc: fv_set)
-        {
-            const Index l = rc.first;
-            const Index i = rc.second;
+    // sum_{l,i} M(l, i) * W(l, i)
+    template <typename Derived>
+    Scalar dot(const Eigen::MatrixBase<Derived>& W) const
+    {
+        if (m_dense)
+            return W.cwiseProduct(m_mat).sum();
+        Scalar res = m_offset.dot(W.rowwise().sum());
+        if (m_vec.size() > 0)
+            res += m_coef.dot(W * m_vec);
+        return res;
+    }
+};
 
-            const Scalar u_li = m_U(l, i);
-            const Scalar v_li = m_V(l, i);
-            const Scalar lambda_li = m_Lambda(l, i);
+// New values of lambda_li and gamma_hi in the coordinate updates, given the margin
+// xb = x[i]'beta and the denominators (u_li * ||x[i]||)^2 and (s_hi * ||x[i]||)^2 + 1
+// tau_hi can be Inf
+template <typename Scalar>
+inline Scalar lambda_step(Scalar lambda_li, Scalar u_li, Scalar v_li, Scalar xb, Scalar denom)
+{
+    const Scalar g_li = -(u_li * xb + v_li);
+    const Scalar candid = lambda_li - g_li / denom;
+    return std::max(Scalar(0), std::min(Scalar(1), candid));
+}
+template <typename Scalar>
+inline Scalar gamma_step(Scalar gamma_hi, Scalar s_hi, Scalar t_hi, Scalar tau_hi, Scalar xb, Scalar denom)
+{
+    const Scalar g_hi = gamma_hi - (s_hi * xb + t_hi);
+    const Scalar candid = gamma_hi - g_hi / denom;
+    return std::max(Scalar(0), std::min(tau_hi, candid));
+}
 
-            // Compute g_li
-            const Scalar g_li = -(u_li * m_X.row(i).dot(m_beta) + v_li);
-            // PG and shrink
-            Scalar pg;
-            const bool shrink = pg_lambda(lambda_li, g_li, lb, ub, pg);
-            if (shrink)
-                continue;
+// Local copy of beta used by a thread in the synchronous parallel solver (CoCoA-style)
+// The thread solves a local subproblem in which the quadratic term of its own
+// change of beta is scaled by sigma, and the change is recovered as (vec - beta) / sigma
+template <typename Scalar>
+struct LocalBeta
+{
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> vec;
+    Scalar                                   sigma;
+};
 
-            // Update PG bounds
-            max_pg = std::max(max_pg, pg);
-            min_pg = std::min(min_pg, pg);
-            // Compute new lambda_li
-            const Scalar candid = lambda_li - g_li / m_gli_denom(l, i);
-            const Scalar newl = std::max(Scalar(0), std::min(Scalar(1), candid));
-            // Update Lambda and beta
-            m_Lambda(l, i) = newl;
-            m_beta.noalias() -= (newl - lambda_li) * u_li * m_X.row(i).transpose();
+// Sample index of an element in the free variable set
+template <typename Index>
+inline Index sample_index(Index i) { return i; }
+template <typename Index>
+inline Index sample_index(const std::pair<Index, Index>& rc) { return rc.second; }
+
+// Shuffle the free variable set in an I/O-aware order
+// Samples are grouped into contiguous blocks of block_size rows of X, the blocks
+// are visited in a random order, and the variables are shuffled within each block,
+// so that each block of X is read from memory (or disk) in one go
+template <typename FV, typename Index, typename RandomNumberGenerator>
+void block_shuffle(std::vector<FV>& fv_set, Index n, Index block_size, RandomNumberGenerator& gen)
+{
+    const Index n_blocks = (n + block_size - 1) / block_size;
+    if (n_blocks < 1)
+        return;
+    std::vector<Index> order(n_blocks), rank(n_blocks);
+    std::iota(order.begin(), order.end(), Index(0));
+    random_shuffle(order.begin(), order.end(), gen);
+    for (Index k = 0; k < n_blocks; k++)
+        rank[order[k]] = k;
+
+    // Counting sort of the variables by the rank of their blocks
+    std::vector<std::size_t> start(n_blocks + 1, 0);
+    for (const auto& v: fv_set)
+        start[rank[sample_index(v) / block_size] + 1]++;
+    std::partial_sum(start.begin(), start.end(), start.begin());
+    std::vector<std::size_t> pos(start.begin(), start.end() - 1);
+    std::vector<FV> sorted(fv_set.size());
+    for (const auto& v: fv_set)
+        sorted[pos[rank[sample_index(v) / block_size]]++] = v;
+
+    for (Index k = 0; k < n_blocks; k++)
+        random_shuffle(sorted.begin() + start[k], sorted.begin() + start[k + 1], gen);
+    fv_set.swap(sorted);
+}
 
-            // Add to new free variable set
-            new_set.emplace_back(l, i);
+// Split [0, n) into contiguous shards, and call f(t, begin, end) on the t-th shard
+// The first shard is processed by the calling thread
+template <typename Index, typename Func>
+void parallel_shards(Index n, Index n_threads, Func f)
+{
+    n_threads = std::max(Index(1), std::min(n_threads, n));
+    std::vector<std::thread> workers;
+    workers.reserve(n_threads - 1);
+    for (Index t = 1; t < n_threads; t++)
+    {
+        const Index begin = Index((long long)(n) * t / n_threads);
+        const Index end = Index((long long)(n) * (t + 1) / n_threads);
+        workers.emplace_back(f, t, begin, end);
+    }
+    f(Index(0), Index(0), Index((long long)(n) / n_threads));
+    for (auto& worker: workers)
+        worker.join();
+}
+
+// Call f(k) for k = 0, ..., n - 1 on n_threads threads, where cost[k] estimates
+// the cost of the k-th task
+// The tasks are started in the decreasing order of their costs (the LPT rule), and
+// each thread takes the next task from a shared counter when it is done, so that
+// the threads stay balanced even if the estimates are rough
+// The first exception thrown by a task is rethrown after the remaining tasks are skipped
+template <typename Index, typename Func>
+void parallel_tasks(const std::vector<double>& cost, Index n_threads, Func f)
+{
+    const Index n = Index(cost.size());
+    std::vector<Index> order(n);
+    std::iota(order.begin(), order.end(), Index(0));
+    std::stable_sort(order.begin(), order.end(),
+                     [&cost](Index i, Index j) { return cost[i] > cost[j]; });
+
+    std::atomic<Index> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    auto worker = [&](Index /* t */, Index /* begin */, Index /* end */)
+    {
+        for (Index k = next++; k < n && !failed; k = next++)
+        {
+            try
+            {
+                f(order[k]);
+            } catch (...) {
+                if (!failed.exchange(true))
+                    error = std::current_exception();
+            }
         }
+    };
+    parallel_shards(n, n_threads, worker);
+    if (error)
+        std::rethrow_exception(error);
+}
 
-        // Update free variable set
-        fv_set.swap(new_set);
+// Old values of the dual variables changed by the coordinate updates, with their
+// (row, sample) positions, so that the changes can be undone in reverse order
+template <typename Index, typename Scalar>
+struct DualJournal
+{
+    std::vector<std::pair<Index, Index>> coords;
+    std::vector<Scalar>                  values;
+
+    void record(Index row, Index i, Scalar old_value)
+    {
+        coords.emplace_back(row, i);
+        values.push_back(old_value);
     }
 
-    // Determine whether to shrink gamma, and compute the projected gradient (PG)
-    // Shrink if (gamma=0 and grad>ub) or (lambda=tau and grad<lb)
-    // PG is zero if (lambda=0 and grad>=0) or (lambda=1 and grad<=0)
-    inline bool pg_gamma(Scalar gamma, Scalar grad, Scalar tau, Scalar lb, Scalar ub, Scalar& pg) const
+    // Restore the recorded variables of M, and clear the journal
+    template <typename Mat>
+    void undo(Mat& M)
     {
-        pg = ((gamma == Scalar(0) && grad >= Scalar(0)) || (gamma == tau && grad <= Scalar(0))) ?
-             Scalar(0) :
-             grad;
-        const bool shrink = (gamma == Scalar(0) && grad > ub) || (gamma == tau && grad < lb);
-        return shrink;
+        for (std::size_t k = values.size(); k > 0; k--)
+            M(coords[k - 1].first, coords[k - 1].second) = values[k - 1];
+        coords.clear();
+        values.clear();
     }
-    // Update Gamma and beta
-    // Overloaded version based on free variable set
-    inline void update_Gamma_beta(std::vector<std::pair<Index, Index>>& fv_set, Scalar& min_pg, Scalar& max_pg)
+};
+
+// New free variable sets and PG bounds computed by each thread
+template <typename FV, typename Scalar>
+struct ShardResults
+{
+    std::vector<std::vector<FV>> sets;
+    std::vector<Scalar>          min_pg;
+    std::vector<Scalar>          max_pg;
+
+    ShardResults(std::size_t n_threads) :
+        sets(n_threads),
+        min_pg(n_threads, std::numeric_limits<Scalar>::infinity()),
+        max_pg(n_threads, -std::numeric_limits<Scalar>::infinity())
+    {}
+
+    // Combine the PG bounds of all threads
+    void merge_pg(Scalar& min_pg_all, Scalar& max_pg_all) const
     {
-        if (m_H < 1)
-            return;
+        min_pg_all = *std::min_element(min_pg.begin(), min_pg.end());
+        max_pg_all = *std::max_element(max_pg.begin(), max_pg.end());
+    }
 
-        // Permutation
-        internal::random_shuffle(fv_set.begin(), fv_set.end(), m_rng);
-        // New free variable set
-        std::vector<std::pair<Index, Index>> new_set;
-        new_set.reserve(fv_set.size());
+    // Concatenate the new free variable sets in the order of threads,
+    // and combine the PG bounds
+    void merge(std::vector<FV>& fv_set, Scalar& min_pg_all, Scalar& max_pg_all) const
+    {
+        fv_set.clear();
+        for (const auto& set: sets)
+            fv_set.insert(fv_set.end(), set.begin(), set.end());
+        merge_pg(min_pg_all, max_pg_all);
+    }
+};
+
+
+// Reader of contiguous row blocks of a row-majored matrix stored in a binary file
+// The file holds n x d values of float or double in the native byte order, starting
+// at byte "offset" (e.g., the header length of a .npy file), and the values are
+// converted to Scalar
+template <typename Scalar>
+class RowBlockReader
+{
+private:
+    using Matrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+    std::ifstream      m_file;
+    std::streamoff     m_offset;
+    Eigen::Index       m_rows;
+    Eigen::Index       m_cols;
+    int                m_value_size;  // 4 for float, 8 for double
+    std::vector<float> m_fbuf;
+
+public:
+    RowBlockReader(const std::string& path, std::streamoff offset,
+                   Eigen::Index rows, Eigen::Index cols, int value_size) :
+        m_file(path, std::ios::binary), m_offset(offset),
+        m_rows(rows), m_cols(cols), m_value_size(value_size)
+    {
+        if (!m_file)
+            throw std::runtime_error("cannot open the data file " + path);
+        if (value_size != 4 && value_size != 8)
+            throw std::invalid_argument("the values in the data file must be float or double");
+    }
+
+    Eigen::Index rows() const { return m_rows; }
+    Eigen::Index cols() const { return m_cols; }
+
+    // Read rows [begin, begin + nrow) into buf
+    void read(Eigen::Index begin, Eigen::Index nrow, Matrix& buf)
+    {
+        buf.resize(nrow, m_cols);
+        const std::size_t count = std::size_t(nrow) * std::size_t(m_cols);
+        m_file.seekg(m_offset + std::streamoff(begin) * m_cols * m_value_size);
+        if (m_value_size == int(sizeof(Scalar)))
+        {
+            m_file.read(reinterpret_cast<char*>(buf.data()), count * sizeof(Scalar));
+        } else if (m_value_size == 4) {
+            m_fbuf.resize(count);
+            m_file.read(reinterpret_cast<char*>(m_fbuf.data()), count * sizeof(float));
+            buf = Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(
+                m_fbuf.data(), nrow, m_cols).template cast<Scalar>();
+        } else {
+            std::vector<double> dbuf(count);
+            m_file.read(reinterpret_cast<char*>(dbuf.data()), count * sizeof(double));
+            buf = Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(
+                dbuf.data(), nrow, m_cols).template cast<Scalar>();
+        }
+        if (!m_file)
+            throw std::runtime_error("failed to read the data file");
+    }
+};
+
+}  // namespace internal
+
+
+// Storage policies of the data matrix X in ReHLineSolver
+// - StoreAsIs          : X is referenced as given, or copied to the row-majored format
+// - StoreQuantized<Code>: X is quantized once to Code (float, internal::bfloat16,
+//                        or std::int8_t with a per-row scale), while beta, the dual
+//                        variables, and all accumulations stay in the Scalar type
+// - StoreReplicated    : the solver is given an internal::ReplicatedMatrix view of
+//                        X, which is repeated for multiple quantiles
+// - StoreView<XView>   : X is kept as the view type XView, e.g., an Eigen::Map of a
+//                        column-majored or strided array, or an internal::ReplicatedMatrix
+//                        of such a map, instead of being copied to the row-majored format
+struct StoreAsIs {};
+template <typename Code>
+struct StoreQuantized {};
+struct StoreReplicated {};
+template <typename XView>
+struct StoreView {};
+
+namespace internal {
+
+// "type" is the type of X kept by the solver, and "input" is the type of X
+// accepted by the constructor of the solver
+template <typename Storage, typename Matrix, typename RMatrix>
+struct XStorageType;
+
+template <typename Matrix, typename RMatrix>
+struct XStorageType<StoreAsIs, Matrix, RMatrix>
+{
+    using type = RMatrix;
+    using input = Eigen::Ref<const Matrix>;
+};
+
+template <typename Code, typename Matrix, typename RMatrix>
+struct XStorageType<StoreQuantized<Code>, Matrix, RMatrix>
+{
+    static_assert(!std::is_base_of<Eigen::SparseMatrixBase<RMatrix>, RMatrix>::value,
+                  "StoreQuantized only supports a dense X");
+    using type = QuantizedMatrix<Code, typename RMatrix::Scalar>;
+    using input = Eigen::Ref<const Matrix>;
+};
+
+template <typename Matrix, typename RMatrix>
+struct XStorageType<StoreReplicated, Matrix, RMatrix>
+{
+    using type = ReplicatedMatrix<RMatrix>;
+    using input = ReplicatedMatrix<Eigen::Ref<const Matrix>>;
+};
+
+template <typename XView, typename Matrix, typename RMatrix>
+struct XStorageType<StoreView<XView>, Matrix, RMatrix>
+{
+    using type = XView;
+    using input = XView;
+};
+
+}  // namespace internal
+// ========================= Internal utility functions ========================= //
+
+
+
+// Dimensions of the matrices involved
+// - Input
+//   * X        : [n x d]
+//   * U, V     : [L x n]
+//   * S, T, Tau: [H x n]
+//   * A        : [K x d]
+//   * b        : [K]
+// - Pre-computed
+//   * r: [n]
+//   * p: [K]
+//   * xi2: [n]
+// - Primal
+//   * beta: [d]
+// - Dual
+//   * xi    : [K]
+//   * Lambda: [L x n]
+//   * Gamma : [H x n]
+
+// Results of the optimization algorithm
+template <typename Matrix = Eigen::MatrixXd, typename Index = int>
+struct ReHLineResult
+{
+    using Scalar = typename Matrix::Scalar;
+    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+    Vector              beta;           // Primal variable
+    Vector              xi;             // Dual variables
+    Matrix              Lambda;         // Dual variables
+    Matrix              Gamma;          // Dual variables
+    Index               niter;          // Number of iterations
+    std::vector<Scalar> dual_objfns;    // Recorded dual objective function values
+    std::vector<Scalar> primal_objfns;  // Recorded primal objective function values
+};
+
+// The main ReHLine solver
+// "Matrix" is the type of input data matrix, can be row-majored or column-majored,
+// dense (Eigen::Matrix) or sparse (Eigen::SparseMatrix)
+// The other inputs and the dual variables are always dense, stored in the
+// same order as X
+// "Storage" is the storage policy of X, see StoreAsIs and StoreQuantized
+template <typename Matrix = Eigen::MatrixXd, typename Index = int, typename Storage = StoreAsIs>
+class ReHLineSolver
+{
+private:
+    using Scalar = typename Matrix::Scalar;
+    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+    using DenseMatrix = typename internal::MatrixTraits<Matrix>::DenseMatrix;
+    using ConstRefMat = Eigen::Ref<const DenseMatrix>;
+    using ConstRefVec = Eigen::Ref<const Vector>;
+    using ParamMat = internal::ParamMatrix<DenseMatrix>;
+    // Views of the per-sample vectors and matrices in buffers with spare capacity
+    using VectorMap = Eigen::Map<Vector>;
+    using DualMatrix = Eigen::Map<DenseMatrix, 0, Eigen::OuterStride<>>;
+
+    // We really want some matrices to be row-majored, since they can be more
+    // efficient in certain matrix operations, for example X.row(i).dot(v)
+    //
+    // If the data Matrix is already row-majored, we save a const reference;
+    // otherwise we make a copy (see StoreView for referencing X in place)
+    // For a sparse X, this means the compressed sparse row (CSR) format
+    template <typename Mat>
+    using RowMajorType = typename std::conditional<
+        Mat::IsRowMajor,
+        Eigen::Ref<const Mat>,
+        typename internal::MatrixTraits<Mat>::RowMajorMatrix
+    >::type;
+    using RMatrix = RowMajorType<Matrix>;
+    using RDenseMatrix = RowMajorType<DenseMatrix>;
+    using XStorage = typename internal::XStorageType<Storage, Matrix, RMatrix>::type;
+    using XInput = typename internal::XStorageType<Storage, Matrix, RMatrix>::input;
+    using DualJournal = internal::DualJournal<Index, Scalar>;
+    // Wider type in which the duality gap of the screening is accumulated
+    using GapScalar = typename std::conditional<
+        std::is_same<Scalar, float>::value, double, long double>::type;
+
+    // RNG
+    internal::SimpleRNG<Index> m_rng;
+
+    // Dimensions, where n grows in append_samples()
+    Index       m_n;
+    const Index m_d;
+    const Index m_L;
+    const Index m_H;
+    const Index m_K;
+
+    // Input matrices and vectors
+    XStorage    m_X;
+    ParamMat    m_U;
+    ParamMat    m_V;
+    ParamMat    m_S;
+    ParamMat    m_T;
+    ParamMat    m_Tau;
+    RDenseMatrix m_A;
+    ConstRefVec m_b;
+
+    // Pre-computed
+    // The denominators (u[li] * ||x[i]||)^2 and (s[hi] * ||x[i]||)^2 + 1 of the
+    // updates of Lambda and Gamma are computed on the fly from xi2, so that no
+    // [L x n] or [H x n] matrices other than the dual variables are stored
+    // xi2, Lambda, and Gamma are views of buffers with spare capacity for the samples
+    // added by append_samples(), see resize_samples()
+    Vector      m_xi2_buf;
+    VectorMap   m_xi2;        // ||x[i]||^2
+    Vector      m_gk_denom;   // ||a[k]||^2
+
+    // Primal variable
+    Vector m_beta;
+
+    // Dual variables
+    Vector      m_xi;
+    DenseMatrix m_Lambda_buf;
+    DenseMatrix m_Gamma_buf;
+    DualMatrix  m_Lambda;
+    DualMatrix  m_Gamma;
+
+    // L1 penalty sum_j l1_pen[j] * |beta[j]|, empty if not used, and its
+    // dual variables -l1_pen[j] <= zeta[j] <= l1_pen[j]
+    Vector      m_l1_pen;
+    Vector      m_zeta;
+
+    // Whether to use the fused per-sample updates of Lambda and Gamma
+    bool m_fused;
+
+    // Number of threads, whether to use the synchronous parallel updates,
+    // and the copy of beta shared by the threads in the asynchronous updates
+    Index m_n_threads;
+    bool  m_sync;
+
+    // Number of consecutive samples visited together in the I/O-aware order,
+    // zero means a full shuffle
+    Index m_block_size;
+    internal::AtomicVector<Scalar> m_beta_shared;
+
+    // Whether solve() starts with the coordinates held at a bound removed from
+    // the free variable sets, see drop_fv_at_bounds()
+    bool m_screen_bounds;
+    // Whether solve() uses the gap-safe screening, see screen_gap_safe()
+    bool m_screening;
+
+    // Samples visited first by the next solve() after append_samples() or remove_samples():
+    // the samples from focus_begin on, and n_revisit older samples drawn at random;
+    // focus_begin is n and n_revisit is zero if there are none, see focus_fv_sets()
+    Index m_focus_begin;
+    Index m_n_revisit;
+
+    // Free variable sets
+    std::vector<Index> m_fv_feas;
+    std::vector<std::pair<Index, Index>> m_fv_relu;
+    std::vector<std::pair<Index, Index>> m_fv_rehu;
+    // Free sample set, used by the fused updates
+    std::vector<Index> m_fv_sample;
+    // Numbers of dead coordinates of Lambda and Gamma, and of samples whose
+    // coordinates are all dead, see lambda_dead()
+    Index m_dead_relu;
+    Index m_dead_rehu;
+    Index m_dead_sample;
+    // Coordinates fixed at their optimal values by the gap-safe screening in solve(),
+    // lambda_li at l * n + i and gamma_hi at h * n + i, and the samples whose coordinates
+    // are all dead or fixed (but not all dead), with their numbers; the flags are empty
+    // if nothing is fixed, see screen_gap_safe()
+    std::vector<char> m_fixed_relu;
+    std::vector<char> m_fixed_rehu;
+    std::vector<char> m_fixed_sample;
+    Index m_n_fixed_relu;
+    Index m_n_fixed_rehu;
+    Index m_n_fixed_sample;
+
+    // Minimum and maximum projected gradients of xi, Lambda, and Gamma in the
+    // previous pass of solve_local(), kept across calls
+    Scalar m_local_pg[6];
+
+    // =================== Operations on the rows of X =================== //
+
+    // x[i]' * v
+    // For a sparse X, only the nonzero elements of x[i] are visited
+    inline Scalar x_dot(Index i, const Vector& v) const
+    {
+        return internal::row_dot(m_X, i, v);
+    }
+
+    // v <- v + a * x[i]
+    inline void x_axpy(Index i, Scalar a, Vector& v) const
+    {
+        internal::row_axpy(m_X, i, a, v);
+    }
+
+    // Versions for a vector shared by multiple threads
+    inline Scalar x_dot(Index i, const internal::AtomicVector<Scalar>& v) const
+    {
+        return internal::row_dot(m_X, i, v);
+    }
+    inline void x_axpy(Index i, Scalar a, internal::AtomicVector<Scalar>& v) const
+    {
+        internal::row_axpy(m_X, i, a, v);
+    }
+
+    // Versions for the local copy of beta in the synchronous parallel solver,
+    // where the changes of beta are scaled by sigma
+    inline Scalar x_dot(Index i, const internal::LocalBeta<Scalar>& v) const
+    {
+        return internal::row_dot(m_X, i, v.vec);
+    }
+    inline void x_axpy(Index i, Scalar a, internal::LocalBeta<Scalar>& v) const
+    {
+        internal::row_axpy(m_X, i, v.sigma * a, v.vec);
+    }
+
+    // a[k]' * beta and beta <- beta + a * a[k], for the two kinds of beta
+    // used by the updates of xi
+    inline Scalar a_dot(Index k, const Vector& v) const
+    {
+        return m_A.row(k).dot(v);
+    }
+    inline void a_axpy(Index k, Scalar a, Vector& v) const
+    {
+        v.noalias() += a * m_A.row(k).transpose();
+    }
+    inline Scalar a_dot(Index k, const internal::LocalBeta<Scalar>& v) const
+    {
+        return m_A.row(k).dot(v.vec);
+    }
+    inline void a_axpy(Index k, Scalar a, internal::LocalBeta<Scalar>& v) const
+    {
+        v.vec.noalias() += (v.sigma * a) * m_A.row(k).transpose();
+    }
+
+    // Whether the updates on the given beta run in parallel
+    // Only the updates of m_beta itself are parallelized
+    inline bool run_parallel(const Vector& beta) const
+    {
+        return (m_n_threads > 1) && (&beta == &m_beta);
+    }
+    inline bool run_parallel(const internal::LocalBeta<Scalar>&) const { return false; }
+
+    // Scaling factor of ||x[i]||^2 in the coordinate updates,
+    // which is sigma for the local subproblems and one otherwise
+    template <typename BetaType>
+    inline Scalar beta_scale(const BetaType&) const { return Scalar(1); }
+    inline Scalar beta_scale(const internal::LocalBeta<Scalar>& v) const { return v.sigma; }
+
+    // =================== Initialization functions =================== //
+
+    // Compute the primal variable beta from dual variables
+    // beta = A'xi - U3 * vec(Lambda) - S3 * vec(Gamma) + zeta
+    // A can be empty, one of U and V may be empty, and zeta is empty without L1 penalty
+    inline void compute_primal(Vector& beta) const
+    {
+        // Initialize beta to zero
+        beta.setZero(m_d);
+
+        // First term
+        if (m_K > 0)
+            beta.noalias() = m_A.transpose() * m_xi;
+
+        // [n x 1]
+        Vector LHterm = Vector::Zero(m_n);
+        if (m_L > 0)
+            LHterm.noalias() = m_U.colwise_dot(m_Lambda);
+        // [n x 1]
+        if (m_H > 0)
+            LHterm.noalias() += m_S.colwise_dot(m_Gamma);
+
+        beta.noalias() -= internal::mat_tvec(m_X, LHterm);
+
+        if (m_l1_pen.size() > 0)
+            beta.noalias() += m_zeta;
+    }
+    inline void set_primal() { compute_primal(m_beta); }
+
+    // =================== Evaluating objection function =================== //
+
+    // Compute the loss part of the primal objective function value
+    inline Scalar loss_objfn() const
+    {
+        return loss_objfn(internal::mat_vec(m_X, m_beta));
+    }
+    // The same, given Xbeta = X * beta
+    inline Scalar loss_objfn(const Vector& Xbeta) const
+    {
+        Scalar result = Scalar(0);
+        // ReLU part
+        for (Index l = 0; l < m_L; l++)
+        {
+            result += (m_U.row(l).cwiseProduct(Xbeta) + m_V.row(l)).cwiseMax(Scalar(0)).sum();
+        }
+        // ReHU part
+        for (Index h = 0; h < m_H; h++)
+        {
+            const Vector z = (m_S.row(h).cwiseProduct(Xbeta) + m_T.row(h)).cwiseMax(Scalar(0));
+            const Vector tau = m_Tau.row(h);
+            result += (z.array() <= tau.array()).select(
+                z.array().square() * Scalar(0.5),
+                tau.array() * (z.array() - tau.array() * Scalar(0.5))
+            ).sum();
+        }
+        return result;
+    }
+
+    // Compute the primal objective function value
+    inline Scalar primal_objfn() const
+    {
+        // Loss plus the quadratic term and the L1 penalty
+        Scalar obj = loss_objfn() + Scalar(0.5) * m_beta.squaredNorm();
+        if (m_l1_pen.size() > 0)
+            obj += m_l1_pen.cwiseProduct(m_beta.cwiseAbs()).sum();
+        return obj;
+    }
+
+    // Compute the separable part of the dual objective function value
+    // xi' * b - tr(Lambda * V') + 0.5 * ||Gamma||^2 - tr(Gamma * T')
+    inline Scalar dual_objfn_sep() const
+    {
+        Scalar obj = Scalar(0);
+        // If K = 0, all terms that depend on A, xi, or b will be zero
+        if (m_K > 0)
+            obj += m_xi.dot(m_b);
+        // If L = 0, all terms that depend on U, V, or Lambda will be zero
+        if (m_L > 0)
+            obj -= m_V.dot(m_Lambda);
+        // If H = 0, all terms that depend on S, T, or Gamma will be zero
+        if (m_H > 0)
+            obj += Scalar(0.5) * m_Gamma.squaredNorm() - m_T.dot(m_Gamma);
+        return obj;
+    }
+
+    // Compute the dual objective function value
+    // 0.5 * ||A'xi - U3 * vec(Lambda) - S3 * vec(Gamma)||^2 + the separable part
+    inline Scalar dual_objfn() const
+    {
+        Vector w;
+        compute_primal(w);
+        return Scalar(0.5) * w.squaredNorm() + dual_objfn_sep();
+    }
+
+    // Denominators in the updates of lambda_li and gamma_hi,
+    // (u[li] * ||x[i]||)^2 and (s[hi] * ||x[i]||)^2 + 1
+    inline Scalar lambda_denom(Scalar u_li, Index i) const { return u_li * u_li * m_xi2[i]; }
+    inline Scalar gamma_denom(Scalar s_hi, Index i) const { return s_hi * s_hi * m_xi2[i] + Scalar(1); }
+
+    // Dead coordinates, whose coefficient u_li * x[i] or s_hi * x[i] is zero, e.g., the
+    // zero-padded terms of a custom loss, do not enter beta; their dual variables are
+    // fixed at the optimum by fix_dead_duals(), and are never visited by the updates
+    inline bool lambda_dead(Scalar u_li, Index i) const { return lambda_denom(u_li, i) == Scalar(0); }
+    inline bool gamma_dead(Scalar s_hi, Index i) const { return s_hi * s_hi * m_xi2[i] == Scalar(0); }
+
+    // Numbers of dead coordinates of Lambda and Gamma of sample i
+    inline void count_dead(Index i, Index& dead_l, Index& dead_h) const
+    {
+        dead_l = dead_h = 0;
+        for (Index l = 0; l < m_L; l++)
+            dead_l += lambda_dead(m_U(l, i), i);
+        for (Index h = 0; h < m_H; h++)
+            dead_h += gamma_dead(m_S(h, i), i);
+    }
+    inline bool sample_dead(Index i) const
+    {
+        Index dead_l, dead_h;
+        count_dead(i, dead_l, dead_h);
+        return dead_l + dead_h == m_L + m_H;
+    }
+
+    // Whether the coordinates are fixed by the gap-safe screening
+    inline bool lambda_fixed(Index l, Index i) const { return m_n_fixed_relu > 0 && m_fixed_relu[l * m_n + i]; }
+    inline bool gamma_fixed(Index h, Index i) const { return m_n_fixed_rehu > 0 && m_fixed_rehu[h * m_n + i]; }
+    inline bool sample_fixed(Index i) const { return m_n_fixed_sample > 0 && m_fixed_sample[i]; }
+
+    // Release the coordinates fixed by the gap-safe screening
+    inline void clear_fixed()
+    {
+        m_fixed_relu.clear();
+        m_fixed_rehu.clear();
+        m_fixed_sample.clear();
+        m_n_fixed_relu = m_n_fixed_rehu = m_n_fixed_sample = 0;
+    }
+
+    // Duality gap primal_objfn() + dual_objfn() at beta, given Xbeta = X * beta, with
+    // err a bound on its rounding error: a few units of Scalar rounding of the magnitudes
+    // of all terms, where x[i]'beta itself is off by up to eps * ||x[i]|| * ||beta||,
+    // plus an absolute floor
+    inline GapScalar screening_gap(const Vector& Xbeta, GapScalar& err) const
+    {
+        const GapScalar eps = std::numeric_limits<Scalar>::epsilon();
+        const GapScalar beta_norm = std::sqrt(GapScalar(m_beta.squaredNorm()));
+        GapScalar gap = GapScalar(0), mag = GapScalar(0);
+        for (Index j = 0; j < m_d; j++)
+        {
+            const GapScalar bj = m_beta[j];
+            gap += bj * bj;
+            if (m_l1_pen.size() > 0)
+                gap += GapScalar(m_l1_pen[j]) * std::abs(bj);
+        }
+        mag += gap;
+        for (Index k = 0; k < m_K; k++)
+        {
+            const GapScalar term = GapScalar(m_xi[k]) * GapScalar(m_b[k]);
+            gap += term;
+            mag += std::abs(term);
+        }
+        for (Index i = 0; i < m_n; i++)
+        {
+            const GapScalar xb = Xbeta[i];
+            const GapScalar xb_err = std::abs(xb) + std::sqrt(GapScalar(m_xi2[i])) * beta_norm;
+            for (Index l = 0; l < m_L; l++)
+            {
+                const GapScalar u = m_U(l, i), v = m_V(l, i), lambda = m_Lambda(l, i);
+                gap += std::max(GapScalar(0), u * xb + v) - v * lambda;
+                mag += std::abs(u) * xb_err + std::abs(v) * (GapScalar(1) + lambda);
+            }
+            for (Index h = 0; h < m_H; h++)
+            {
+                const GapScalar s = m_S(h, i), t = m_T(h, i), tau = m_Tau(h, i), gamma = m_Gamma(h, i);
+                const GapScalar z = std::max(GapScalar(0), s * xb + t);
+                const GapScalar zmag = std::abs(s) * xb_err + std::abs(t);
+                gap += ((z <= tau) ? GapScalar(0.5) * z * z : tau * (z - GapScalar(0.5) * tau)) +
+                       GapScalar(0.5) * gamma * gamma - t * gamma;
+                mag += zmag * std::min(tau, z + zmag) + gamma * (GapScalar(0.5) * gamma + std::abs(t));
+            }
+        }
+        err = GapScalar(16) * eps * mag + eps;
+        return gap;
+    }
+
+    // Final test of the synchronous parallel updates
+    // The combined steps are damped by the line search in run_sync(), so small changes
+    // of the variables do not imply convergence. Stop only if the duality gap is small
+    // relative to the primal objective function, and the constraints are satisfied
+    inline bool sync_converged(Scalar tol)
+    {
+        if (!(m_sync && m_n_threads > 1))
+            return true;
+        set_primal();
+        if (m_K > 0 && (m_A * m_beta + m_b).minCoeff() < -tol)
+            return false;
+        const Vector Xbeta = internal::mat_vec(m_X, m_beta);
+        GapScalar err;
+        const GapScalar gap = screening_gap(Xbeta, err);
+        return gap <= GapScalar(tol) * std::max(GapScalar(1), std::abs(GapScalar(primal_objfn()))) + err;
+    }
+
+    // Whether all coordinates of sample i are dead or certified by screen_gap_safe(),
+    // given xb = x[i]'beta and ri = r * ||x[i]||
+    inline bool sample_certified(Index i, Scalar xb, Scalar ri) const
+    {
+        for (Index l = 0; l < m_L; l++)
+        {
+            const Scalar u_li = m_U(l, i);
+            const Scalar z = u_li * xb + m_V(l, i), bound = ri * std::abs(u_li);
+            if (!lambda_dead(u_li, i) && z <= bound && z >= -bound)
+                return false;
+        }
+        for (Index h = 0; h < m_H; h++)
+        {
+            const Scalar s_hi = m_S(h, i);
+            const Scalar z = s_hi * xb + m_T(h, i), bound = ri * std::abs(s_hi);
+            if (!gamma_dead(s_hi, i) && z > -bound && z < m_Tau(h, i) + bound)
+                return false;
+        }
+        return true;
+    }
+
+    // Gap-safe screening
+    // The primal objective function is 1-strongly convex, so if beta is computed from
+    // feasible dual variables and satisfies the constraints, the optimal beta* lies in
+    // the ball ||beta - beta*|| <= r = sqrt(2 * gap), where gap is the duality gap,
+    // primal_objfn() + dual_objfn() (dual_objfn() is the negative dual objective)
+    // Then |x[i]'beta - x[i]'beta*| <= r * ||x[i]||, which certifies the optimal values
+    //     lambda_li* = 1 if u_li * x[i]'beta + v_li > r * |u_li| * ||x[i]||,
+    //     lambda_li* = 0 if u_li * x[i]'beta + v_li < -r * |u_li| * ||x[i]||,
+    //     gamma_hi* = 0 if s_hi * x[i]'beta + t_hi <= -r * |s_hi| * ||x[i]||,
+    //     gamma_hi* = tau_hi if s_hi * x[i]'beta + t_hi >= tau_hi + r * |s_hi| * ||x[i]||
+    // These coordinates are set to their optimal values and flagged as fixed, and are
+    // left out of the free variable sets for the rest of solve(); the fused updates
+    // visit all coordinates of a sample, so a sample is screened only if all its
+    // coordinates are certified, and is then left out
+    // The gap is a difference of nearly equal objective values, so it is accumulated in
+    // GapScalar, and r is enlarged by the rounding error of the terms, see screening_gap()
+    // Returns the number of newly fixed coordinates
+    inline Index screen_gap_safe()
+    {
+        // Recompute beta from the dual variables, so that the gap is exact up to rounding
+        set_primal();
+        if (m_K > 0 && (m_A * m_beta + m_b).minCoeff() < Scalar(0))
+            return 0;
+        const Vector Xbeta = internal::mat_vec(m_X, m_beta);
+        GapScalar err;
+        const GapScalar gap = screening_gap(Xbeta, err);
+        // The ball is not certified if the gap is within its rounding error
+        if (!(gap > err))
+            return 0;
+        const Scalar r = Scalar(std::sqrt(GapScalar(2) * (gap + err)));
+
+        if (m_fixed_sample.empty())
+        {
+            m_fixed_relu.assign(m_L * m_n, 0);
+            m_fixed_rehu.assign(m_H * m_n, 0);
+            m_fixed_sample.assign(m_n, 0);
+        }
+        const Index n_fixed = m_n_fixed_relu + m_n_fixed_rehu;
+        for (Index i = 0; i < m_n; i++)
+        {
+            if (m_fixed_sample[i])
+                continue;
+
+            const Scalar ri = r * std::sqrt(m_xi2[i]);
+            if (m_fused && !sample_certified(i, Xbeta[i], ri))
+                continue;
+            // Change of beta is delta * x[i]
+            Scalar delta = Scalar(0);
+            bool all_fixed = true;
+            for (Index l = 0; l < m_L; l++)
+            {
+                char& fixed = m_fixed_relu[l * m_n + i];
+                const Scalar u_li = m_U(l, i);
+                if (fixed || lambda_dead(u_li, i))
+                    continue;
+                const Scalar z = u_li * Xbeta[i] + m_V(l, i), bound = ri * std::abs(u_li);
+                if (z <= bound && z >= -bound)
+                {
+                    all_fixed = false;
+                    continue;
+                }
+                const Scalar newl = (z > bound) ? Scalar(1) : Scalar(0);
+                delta -= (newl - m_Lambda(l, i)) * u_li;
+                m_Lambda(l, i) = newl;
+                fixed = 1;
+                m_n_fixed_relu++;
+            }
+            for (Index h = 0; h < m_H; h++)
+            {
+                char& fixed = m_fixed_rehu[h * m_n + i];
+                const Scalar s_hi = m_S(h, i);
+                if (fixed || gamma_dead(s_hi, i))
+                    continue;
+                const Scalar z = s_hi * Xbeta[i] + m_T(h, i), bound = ri * std::abs(s_hi);
+                // tau_hi can be Inf
+                const Scalar tau_hi = m_Tau(h, i);
+                Scalar newg;
+                if (z <= -bound)
+                {
+                    newg = Scalar(0);
+                } else if (z >= tau_hi + bound) {
+                    newg = tau_hi;
+                } else {
+                    all_fixed = false;
+                    continue;
+                }
+                delta -= (newg - m_Gamma(h, i)) * s_hi;
+                m_Gamma(h, i) = newg;
+                fixed = 1;
+                m_n_fixed_rehu++;
+            }
+            if (delta != Scalar(0))
+                x_axpy(i, delta, m_beta);
+            if (all_fixed && !sample_dead(i))
+            {
+                m_fixed_sample[i] = 1;
+                m_n_fixed_sample++;
+            }
+        }
+        return m_n_fixed_relu + m_n_fixed_rehu - n_fixed;
+    }
+
+    // Resize the views of xi2, Lambda, and Gamma to n samples, keeping the values of the
+    // first samples; the buffers at least double when they run out, so that appending
+    // m samples copies O(m) values amortized, and are kept when samples are removed
+    inline void resize_samples(Index n)
+    {
+        const Index n_keep = std::min(n, Index(m_xi2.size()));
+        if (n > m_xi2_buf.size())
+        {
+            const Index capacity = std::max(n, Index(2 * m_xi2_buf.size()));
+            Vector xi2(capacity);
+            DenseMatrix Lambda(m_L, capacity), Gamma(m_H, capacity);
+            xi2.head(n_keep).noalias() = m_xi2.head(n_keep);
+            Lambda.leftCols(n_keep).noalias() = m_Lambda.leftCols(n_keep);
+            Gamma.leftCols(n_keep).noalias() = m_Gamma.leftCols(n_keep);
+            m_xi2_buf.swap(xi2);
+            m_Lambda_buf.swap(Lambda);
+            m_Gamma_buf.swap(Gamma);
+        }
+        new (&m_xi2) VectorMap(m_xi2_buf.data(), n);
+        new (&m_Lambda) DualMatrix(m_Lambda_buf.data(), m_L, n, Eigen::OuterStride<>(m_Lambda_buf.outerStride()));
+        new (&m_Gamma) DualMatrix(m_Gamma_buf.data(), m_H, n, Eigen::OuterStride<>(m_Gamma_buf.outerStride()));
+    }
+
+    // Count the dead coordinates
+    inline void count_dead()
+    {
+        m_dead_relu = m_dead_rehu = m_dead_sample = 0;
+        for (Index i = 0; i < m_n; i++)
+        {
+            Index dead_l, dead_h;
+            count_dead(i, dead_l, dead_h);
+            m_dead_relu += dead_l;
+            m_dead_rehu += dead_h;
+            m_dead_sample += (dead_l + dead_h == m_L + m_H);
+        }
+    }
+
+    // =================== Updating functions (sequential) =================== //
+
+    // Update xi and beta
+    inline void update_xi_beta()
+    {
+        if (m_K < 1)
+            return;
+
+        for (Index k = 0; k < m_K; k++)
+        {
+            const Scalar xi_k = m_xi[k];
+
+            // Compute g_k
+            const Scalar g_k = m_A.row(k).dot(m_beta) + m_b[k];
+            // Compute new xi_k
+            const Scalar candid = xi_k - g_k / m_gk_denom[k];
+            const Scalar newxi = std::max(Scalar(0), candid);
+            // Update xi and beta
+            m_xi[k] = newxi;
+            m_beta.noalias() += (newxi - xi_k) * m_A.row(k).transpose();
+        }
+    }
+
+    // Change of beta in an iteration, for the convergence test
+    // With the L1 penalty, zeta can absorb the changes of the other dual variables,
+    // e.g., when beta is soft-thresholded to zero, so the change of zeta is added
+    inline Scalar beta_change(const Vector& old_beta, const Vector& old_zeta) const
+    {
+        const Scalar diff = (m_beta - old_beta).norm();
+        return (m_l1_pen.size() > 0) ? diff + (m_zeta - old_zeta).norm() : diff;
+    }
+
+    // Update zeta and beta
+    // zeta[j] only enters beta[j], so each update is O(1) without visiting X:
+    // zeta[j] <- clip(zeta[j] - beta[j], -l1_pen[j], l1_pen[j]), i.e.,
+    // beta[j] is soft-thresholded by l1_pen[j]
+    // min_pg and max_pg are the bounds of the projected gradients
+    inline void update_l1_beta(Scalar& min_pg, Scalar& max_pg)
+    {
+        if (m_l1_pen.size() < 1)
+            return;
+
+        constexpr Scalar Inf = std::numeric_limits<Scalar>::infinity();
+        min_pg = Inf;
+        max_pg = -Inf;
+        for (Index j = 0; j < m_d; j++)
+        {
+            const Scalar lam = m_l1_pen[j];
+            const Scalar zeta_j = m_zeta[j];
+            // The gradient of the dual objective function with respect to zeta[j]
+            const Scalar g_j = m_beta[j];
+            const Scalar pg = ((zeta_j == -lam && g_j >= Scalar(0)) || (zeta_j == lam && g_j <= Scalar(0))) ?
+                              Scalar(0) : g_j;
+            max_pg = std::max(max_pg, pg);
+            min_pg = std::min(min_pg, pg);
+
+            const Scalar newzeta = std::min(lam, std::max(-lam, zeta_j - g_j));
+            m_zeta[j] = newzeta;
+            m_beta[j] += newzeta - zeta_j;
+        }
+    }
+
+    // Update Lambda and beta
+    inline void update_Lambda_beta()
+    {
+        if (m_L < 1)
+            return;
+
+        for (Index i = 0; i < m_n; i++)
+        {
+            for (Index l = 0; l < m_L; l++)
+            {
+                const Scalar u_li = m_U(l, i);
+                if (lambda_dead(u_li, i))
+                    continue;
+                const Scalar v_li = m_V(l, i);
+                const Scalar lambda_li = m_Lambda(l, i);
+
+                // Compute new lambda_li
+                const Scalar newl = internal::lambda_step(lambda_li, u_li, v_li, x_dot(i, m_beta),
+                                                          lambda_denom(u_li, i));
+                // Update Lambda and beta
+                m_Lambda(l, i) = newl;
+                x_axpy(i, -(newl - lambda_li) * u_li, m_beta);
+            }
+        }
+    }
+
+    // Update Gamma, and beta
+    inline void update_Gamma_beta()
+    {
+        if (m_H < 1)
+            return;
+
+        for (Index i = 0; i < m_n; i++)
+        {
+            for (Index h = 0; h < m_H; h++)
+            {
+                const Scalar s_hi = m_S(h, i);
+                if (gamma_dead(s_hi, i))
+                    continue;
+                // tau_hi can be Inf
+                const Scalar tau_hi = m_Tau(h, i);
+                const Scalar gamma_hi = m_Gamma(h, i);
+                const Scalar t_hi = m_T(h, i);
+
+                // Compute new gamma_hi
+                const Scalar newg = internal::gamma_step(gamma_hi, s_hi, t_hi, tau_hi, x_dot(i, m_beta),
+                                                         gamma_denom(s_hi, i));
+                // Update Gamma and beta
+                m_Gamma(h, i) = newg;
+                x_axpy(i, -(newg - gamma_hi) * s_hi, m_beta);
+            }
+        }
+    }
+
+    // =================== Updating functions (fused per-sample) ================= //
+
+    // Update Lambda, Gamma, and beta
+    // All the (L + H) dual variables of sample i are updated in sequence with x[i]
+    // loaded only once: after each coordinate update, the margin x[i]'beta is corrected
+    // using ||x[i]||^2, and the changes of beta are accumulated into a single axpy
+    inline void update_LH_beta_fused()
+    {
+        if (m_L < 1 && m_H < 1)
+            return;
+
+        // Kernels specialized for the (L, H) of the built-in losses, which do not
+        // check for dead coordinates, so they are only used if there are none
+        const bool any_dead = (m_dead_relu + m_dead_rehu > 0);
+        if (!any_dead && m_L == 1 && m_H == 0)
+            update_LH_beta_fused_kernel<1, 0>();        // hinge
+        else if (!any_dead && m_L == 2 && m_H == 0)
+            update_LH_beta_fused_kernel<2, 0>();        // check
+        else if (!any_dead && m_L == 0 && m_H == 1)
+            update_LH_beta_fused_kernel<0, 1>();        // smoothed hinge
+        else if (!any_dead && m_L == 0 && m_H == 2)
+            update_LH_beta_fused_kernel<0, 2>();        // Huber
+        else
+            update_LH_beta_fused_kernel<Eigen::Dynamic, Eigen::Dynamic>();
+    }
+
+    // Fused updates with LD = L and HD = H known at compile time, or Eigen::Dynamic
+    // With a fixed (L, H), the parameters of sample i are loaded per column, the
+    // loops over l and h are unrolled, and the dead coordinates are not checked
+    template <int LD, int HD>
+    inline void update_LH_beta_fused_kernel()
+    {
+        const Index L = (LD == Eigen::Dynamic) ? m_L : Index(LD);
+        const Index H = (HD == Eigen::Dynamic) ? m_H : Index(HD);
+        constexpr int LS = (LD > 0) ? LD : 1;
+        constexpr int HS = (HD > 0) ? HD : 1;
+        const FusedParams P = fused_params();
+
+        for (Index i = 0; i < m_n; i++)
+        {
+            const Scalar xi2 = m_xi2[i];
+            // Margin x[i]'beta, and coefficient of x[i] in the change of beta
+            Scalar xb = x_dot(i, m_beta);
+            Scalar delta = Scalar(0);
+
+            Scalar u[LS], v[LS], s[HS], t[HS], tau[HS];
+            load_params<LD, HD>(P, i, u, v, s, t, tau);
+
+            for (Index l = 0; l < L; l++)
+            {
+                const Scalar u_li = (LD > 0) ? u[l] : m_U(l, i);
+                if (LD == Eigen::Dynamic && lambda_dead(u_li, i))
+                    continue;
+                const Scalar v_li = (LD > 0) ? v[l] : m_V(l, i);
+                const Scalar lambda_li = m_Lambda(l, i);
+
+                // Compute new lambda_li
+                const Scalar newl = internal::lambda_step(lambda_li, u_li, v_li, xb, lambda_denom(u_li, i));
+                // Update Lambda and the margin
+                m_Lambda(l, i) = newl;
+                const Scalar dl = (newl - lambda_li) * u_li;
+                delta -= dl;
+                xb -= dl * xi2;
+            }
+
+            for (Index h = 0; h < H; h++)
+            {
+                const Scalar s_hi = (HD > 0) ? s[h] : m_S(h, i);
+                if (HD == Eigen::Dynamic && gamma_dead(s_hi, i))
+                    continue;
+                // tau_hi can be Inf
+                const Scalar tau_hi = (HD > 0) ? tau[h] : m_Tau(h, i);
+                const Scalar gamma_hi = m_Gamma(h, i);
+                const Scalar t_hi = (HD > 0) ? t[h] : m_T(h, i);
+
+                // Compute new gamma_hi
+                const Scalar newg = internal::gamma_step(gamma_hi, s_hi, t_hi, tau_hi, xb, gamma_denom(s_hi, i));
+                // Update Gamma and the margin
+                m_Gamma(h, i) = newg;
+                const Scalar dg = (newg - gamma_hi) * s_hi;
+                delta -= dg;
+                xb -= dg * xi2;
+            }
+
+            // Update beta
+            if (delta != Scalar(0))
+                x_axpy(i, delta, m_beta);
+        }
+    }
+
+    // =================== Updating functions (free variable set) ================ //
+
+    // Determine whether to shrink xi, and compute the projected gradient (PG)
+    // Shrink if xi=0 and grad>ub
+    // PG is zero if xi=0 and grad>=0
+    inline bool pg_xi(Scalar xi, Scalar grad, Scalar ub, Scalar& pg) const
+    {
+        pg = (xi == Scalar(0) && grad >= Scalar(0)) ? Scalar(0) : grad;
+        const bool shrink = (xi == Scalar(0)) && (grad > ub);
+        return shrink;
+    }
+    // Update xi and beta
+    // Overloaded version based on free variable set
+    template <typename BetaType>
+    inline void update_xi_beta(std::vector<Index>& fv_set, Scalar& min_pg, Scalar& max_pg, BetaType& beta)
+    {
+        if (m_K < 1)
+            return;
+
+        // Permutation
+        internal::random_shuffle(fv_set.begin(), fv_set.end(), m_rng);
+        // New free variable set
+        std::vector<Index> new_set;
+        new_set.reserve(fv_set.size());
+
+        // Compute shrinking threshold ub
+        // ub is kept unchanged in each outer iteration,
+        // and is determined by the maximum PG in the previous outer iteration (i.e., max_pg)
+        // If the input max_pg is zero or negative, let ub be Inf (do not shrink)
+        // This happens when:
+        //     (1) max_pg is initialized to be zero in the first iteration
+        //     (2) max_pg is negative, thus not meaningful
+        constexpr Scalar Inf = std::numeric_limits<Scalar>::infinity();
+        const Scalar ub = (max_pg > Scalar(0)) ? max_pg : Inf;
+        // Compute minimum and maximum projected gradient (PG) for this round (outer iteration)
+        min_pg = Inf;
+        max_pg = -Inf;
+        for (auto k: fv_set)
+        {
+            const Scalar xi_k = m_xi[k];
+
+            // Compute g_k
+            const Scalar g_k = a_dot(k, beta) + m_b[k];
+            // PG and shrink
+            Scalar pg;
+            const bool shrink = pg_xi(xi_k, g_k, ub, pg);
+            if (shrink)
+               continue;
+
+            // Update PG bounds
+            max_pg = std::max(max_pg, pg);
+            min_pg = std::min(min_pg, pg);
+            // Compute new xi_k
+            const Scalar candid = xi_k - g_k / (beta_scale(beta) * m_gk_denom[k]);
+            const Scalar newxi = std::max(Scalar(0), candid);
+            // Update xi and beta
+            m_xi[k] = newxi;
+            a_axpy(k, newxi - xi_k, beta);
+
+            // Add to new free variable set
+            new_set.push_back(k);
+        }
+
+        // Update free variable set
+        fv_set.swap(new_set);
+    }
+
+    // Determine whether to shrink lambda, and compute the projected gradient (PG)
+    // Shrink if (lambda=0 and grad>ub) or (lambda=1 and grad<lb)
+    // PG is zero if (lambda=0 and grad>=0) or (lambda=1 and grad<=0)
+    inline bool pg_lambda(Scalar lambda, Scalar grad, Scalar lb, Scalar ub, Scalar& pg) const
+    {
+        pg = ((lambda == Scalar(0) && grad >= Scalar(0)) || (lambda == Scalar(1) && grad <= Scalar(0))) ?
+             Scalar(0) :
+             grad;
+        const bool shrink = (lambda == Scalar(0) && grad > ub) || (lambda == Scalar(1) && grad < lb);
+        return shrink;
+    }
+    // Update Lambda and beta on a shard [begin, end) of the free variable set
+    // "BetaType" is Vector in the sequential version, and an atomic vector
+    // shared by all threads in the parallel version
+    // If journal is given, the old values of the changed coordinates are recorded in it
+    template <typename BetaType>
+    inline void update_Lambda_beta_shard(
+        const std::pair<Index, Index>* begin, const std::pair<Index, Index>* end,
+        BetaType& beta, Scalar lb, Scalar ub, Scalar& min_pg, Scalar& max_pg,
+        std::vector<std::pair<Index, Index>>& new_set, DualJournal* journal = nullptr)
+    {
+        for (auto rc = begin; rc != end; ++rc)
+        {
+            const Index l = rc->first;
+            const Index i = rc->second;
+
+            const Scalar u_li = m_U(l, i);
+            const Scalar v_li = m_V(l, i);
+            const Scalar lambda_li = m_Lambda(l, i);
+
+            // Compute g_li
+            const Scalar g_li = -(u_li * x_dot(i, beta) + v_li);
+            // PG and shrink
+            Scalar pg;
+            const bool shrink = pg_lambda(lambda_li, g_li, lb, ub, pg);
+            if (shrink)
+                continue;
+
+            // Update PG bounds
+            max_pg = std::max(max_pg, pg);
+            min_pg = std::min(min_pg, pg);
+            // Compute new lambda_li
+            const Scalar candid = lambda_li - g_li / (beta_scale(beta) * lambda_denom(u_li, i));
+            const Scalar newl = std::max(Scalar(0), std::min(Scalar(1), candid));
+            // Update Lambda and beta
+            if (journal != nullptr && newl != lambda_li)
+                journal->record(l, i, lambda_li);
+            m_Lambda(l, i) = newl;
+            x_axpy(i, -(newl - lambda_li) * u_li, beta);
+
+            // Add to new free variable set
+            new_set.emplace_back(l, i);
+        }
+    }
+    // Update Lambda and beta
+    // Overloaded version based on free variable set
+    template <typename BetaType>
+    inline void update_Lambda_beta(std::vector<std::pair<Index, Index>>& fv_set, Scalar& min_pg, Scalar& max_pg,
+                               BetaType& beta)
+    {
+        if (m_L < 1)
+            return;
+
+        // Permutation
+        shuffle_fv_set(fv_set);
+
+        // Compute shrinking thresholds lb and ub
+        // More details explained in update_xi_beta()
+        constexpr Scalar Inf = std::numeric_limits<Scalar>::infinity();
+        const Scalar lb = (min_pg < Scalar(0)) ? min_pg : -Inf;
+        const Scalar ub = (max_pg > Scalar(0)) ? max_pg : Inf;
+
+        if (run_parallel(beta))
+        {
+            // Each thread updates a part of the free variable set,
+            // see run_async() and run_sync()
+            using FV = std::pair<Index, Index>;
+            internal::ShardResults<FV, Scalar> res(m_n_threads);
+            if (m_sync)
+            {
+                run_sync(fv_set, [&](Index t, const FV* begin, const FV* end, internal::LocalBeta<Scalar>& local_beta) {
+                    res.sets[t].reserve(end - begin);
+                    update_Lambda_beta_shard(begin, end, local_beta, lb, ub, res.min_pg[t], res.max_pg[t], res.sets[t]);
+                });
+            } else {
+                run_async(fv_set, [&](Index t, const FV* begin, const FV* end, internal::AtomicVector<Scalar>& shared_beta) {
+                    res.sets[t].reserve(end - begin);
+                    update_Lambda_beta_shard(begin, end, shared_beta, lb, ub, res.min_pg[t], res.max_pg[t], res.sets[t]);
+                });
+            }
+            res.merge(fv_set, min_pg, max_pg);
+            return;
+        }
+
+        // New free variable set
+        std::vector<std::pair<Index, Index>> new_set;
+        new_set.reserve(fv_set.size());
+        // Compute minimum and maximum projected gradient (PG) for this round
+        min_pg = Inf;
+        max_pg = -Inf;
+        update_Lambda_beta_shard(fv_set.data(), fv_set.data() + fv_set.size(), beta,
+                                 lb, ub, min_pg, max_pg, new_set);
+
+        // Update free variable set
+        fv_set.swap(new_set);
+    }
+
+    // Determine whether to shrink gamma, and compute the projected gradient (PG)
+    // Shrink if (gamma=0 and grad>ub) or (lambda=tau and grad<lb)
+    // PG is zero if (lambda=0 and grad>=0) or (lambda=1 and grad<=0)
+    inline bool pg_gamma(Scalar gamma, Scalar grad, Scalar tau, Scalar lb, Scalar ub, Scalar& pg) const
+    {
+        pg = ((gamma == Scalar(0) && grad >= Scalar(0)) || (gamma == tau && grad <= Scalar(0))) ?
+             Scalar(0) :
+             grad;
+        const bool shrink = (gamma == Scalar(0) && grad > ub) || (gamma == tau && grad < lb);
+        return shrink;
+    }
+    // Denominator in the update of gamma_hi, (s[hi] * ||x[i]||)^2 * scale + 1
+    template <typename BetaType>
+    inline Scalar gamma_denom(Scalar s_hi, Index i, const BetaType&) const
+    {
+        return gamma_denom(s_hi, i);
+    }
+    inline Scalar gamma_denom(Scalar s_hi, Index i, const internal::LocalBeta<Scalar>& beta) const
+    {
+        return beta.sigma * (s_hi * s_hi * m_xi2[i]) + Scalar(1);
+    }
+    // Update Gamma and beta on a shard [begin, end) of the free variable set
+    template <typename BetaType>
+    inline void update_Gamma_beta_shard(
+        const std::pair<Index, Index>* begin, const std::pair<Index, Index>* end,
+        BetaType& beta, Scalar lb, Scalar ub, Scalar& min_pg, Scalar& max_pg,
+        std::vector<std::pair<Index, Index>>& new_set, DualJournal* journal = nullptr)
+    {
+        for (auto rc = begin; rc != end; ++rc)
+        {
+            const Index h = rc->first;
+            const Index i = rc->second;
+
+            // tau_hi can be Inf
+            const Scalar tau_hi = m_Tau(h, i);
+            const Scalar gamma_hi = m_Gamma(h, i);
+            const Scalar s_hi = m_S(h, i);
+            const Scalar t_hi = m_T(h, i);
+
+            // Compute g_hi
+            const Scalar g_hi = gamma_hi - (s_hi * x_dot(i, beta) + t_hi);
+            // PG and shrink
+            Scalar pg;
+            const bool shrink = pg_gamma(gamma_hi, g_hi, tau_hi, lb, ub, pg);
+            if (shrink)
+                continue;
+
+            // Update PG bounds
+            max_pg = std::max(max_pg, pg);
+            min_pg = std::min(min_pg, pg);
+            // Compute new gamma_hi
+            const Scalar candid = gamma_hi - g_hi / gamma_denom(s_hi, i, beta);
+            const Scalar newg = std::max(Scalar(0), std::min(tau_hi, candid));
+            // Update Gamma and beta
+            if (journal != nullptr && newg != gamma_hi)
+                journal->record(h, i, gamma_hi);
+            m_Gamma(h, i) = newg;
+            x_axpy(i, -(newg - gamma_hi) * s_hi, beta);
+
+            // Add to new free variable set
+            new_set.emplace_back(h, i);
+        }
+    }
+    // Update Gamma and beta
+    // Overloaded version based on free variable set
+    template <typename BetaType>
+    inline void update_Gamma_beta(std::vector<std::pair<Index, Index>>& fv_set, Scalar& min_pg, Scalar& max_pg,
+                               BetaType& beta)
+    {
+        if (m_H < 1)
+            return;
+
+        // Permutation
+        shuffle_fv_set(fv_set);
+
+        // Compute shrinking thresholds lb and ub
+        // More details explained in update_xi_beta()
+        constexpr Scalar Inf = std::numeric_limits<Scalar>::infinity();
+        const Scalar lb = (min_pg < Scalar(0)) ? min_pg : -Inf;
+        const Scalar ub = (max_pg > Scalar(0)) ? max_pg : Inf;
+
+        if (run_parallel(beta))
+        {
+            // Parallel version, see update_Lambda_beta()
+            using FV = std::pair<Index, Index>;
+            internal::ShardResults<FV, Scalar> res(m_n_threads);
+            if (m_sync)
+            {
+                run_sync(fv_set, [&](Index t, const FV* begin, const FV* end, internal::LocalBeta<Scalar>& local_beta) {
+                    res.sets[t].reserve(end - begin);
+                    update_Gamma_beta_shard(begin, end, local_beta, lb, ub, res.min_pg[t], res.max_pg[t], res.sets[t]);
+                });
+            } else {
+                run_async(fv_set, [&](Index t, const FV* begin, const FV* end, internal::AtomicVector<Scalar>& shared_beta) {
+                    res.sets[t].reserve(end - begin);
+                    update_Gamma_beta_shard(begin, end, shared_beta, lb, ub, res.min_pg[t], res.max_pg[t], res.sets[t]);
+                });
+            }
+            res.merge(fv_set, min_pg, max_pg);
+            return;
+        }
+
+        // New free variable set
+        std::vector<std::pair<Index, Index>> new_set;
+        new_set.reserve(fv_set.size());
+        // Compute minimum and maximum projected gradient (PG) for this round
+        min_pg = Inf;
+        max_pg = -Inf;
+        update_Gamma_beta_shard(fv_set.data(), fv_set.data() + fv_set.size(), beta,
+                                lb, ub, min_pg, max_pg, new_set);
+
+        // Update free variable set
+        fv_set.swap(new_set);
+    }
+
+    // Readers of the loss parameters used by the fused kernels, with the form
+    // of each parameter resolved once per call, see ParamMatrix::col_reader()
+    struct FusedParams
+    {
+        typename ParamMat::ColReader U, V, S, T, Tau;
+    };
+    inline FusedParams fused_params() const
+    {
+        return FusedParams{m_U.col_reader(), m_V.col_reader(),
+                           m_S.col_reader(), m_T.col_reader(), m_Tau.col_reader()};
+    }
+
+    // Parameters of sample i used by the fused kernels
+    // Only loaded if L = LD or H = HD is fixed at compile time
+    template <int LD, int HD>
+    static inline void load_params(const FusedParams& P, Index i,
+                                   Scalar* u, Scalar* v, Scalar* s, Scalar* t, Scalar* tau)
+    {
+        if (LD > 0)
+        {
+            P.U.col(i, LD, u);
+            P.V.col(i, LD, v);
+        }
+        if (HD > 0)
+        {
+            P.S.col(i, HD, s);
+            P.T.col(i, HD, t);
+            P.Tau.col(i, HD, tau);
+        }
+    }
+
+    // Update Lambda, Gamma, and beta on a shard [begin, end) of the free sample set
+    // A sample is removed from the free set only if all of its (L + H)
+    // dual variables are shrunk
+    template <typename BetaType>
+    inline void update_LH_beta_fused_shard(
+        const Index* begin, const Index* end, BetaType& beta,
+        Scalar lambda_lb, Scalar lambda_ub, Scalar gamma_lb, Scalar gamma_ub,
+        Scalar& lambda_min_pg, Scalar& lambda_max_pg,
+        Scalar& gamma_min_pg, Scalar& gamma_max_pg,
+        std::vector<Index>& new_set)
+    {
+        // Kernels specialized for the (L, H) of the built-in losses, see
+        // update_LH_beta_fused(); the samples whose coordinates are all dead are
+        // not in the free set, so these kernels are used unless some sample has
+        // both dead and live coordinates
+        const bool any_dead = (m_dead_relu + m_dead_rehu > m_dead_sample * (m_L + m_H));
+        if (!any_dead && m_L == 1 && m_H == 0)
+            update_LH_beta_fused_kernel<1, 0>(begin, end, beta, lambda_lb, lambda_ub, gamma_lb, gamma_ub,
+                                              lambda_min_pg, lambda_max_pg, gamma_min_pg, gamma_max_pg, new_set);
+        else if (!any_dead && m_L == 2 && m_H == 0)
+            update_LH_beta_fused_kernel<2, 0>(begin, end, beta, lambda_lb, lambda_ub, gamma_lb, gamma_ub,
+                                              lambda_min_pg, lambda_max_pg, gamma_min_pg, gamma_max_pg, new_set);
+        else if (!any_dead && m_L == 0 && m_H == 1)
+            update_LH_beta_fused_kernel<0, 1>(begin, end, beta, lambda_lb, lambda_ub, gamma_lb, gamma_ub,
+                                              lambda_min_pg, lambda_max_pg, gamma_min_pg, gamma_max_pg, new_set);
+        else if (!any_dead && m_L == 0 && m_H == 2)
+            update_LH_beta_fused_kernel<0, 2>(begin, end, beta, lambda_lb, lambda_ub, gamma_lb, gamma_ub,
+                                              lambda_min_pg, lambda_max_pg, gamma_min_pg, gamma_max_pg, new_set);
+        else
+            update_LH_beta_fused_kernel<Eigen::Dynamic, Eigen::Dynamic>(
+                begin, end, beta, lambda_lb, lambda_ub, gamma_lb, gamma_ub,
+                lambda_min_pg, lambda_max_pg, gamma_min_pg, gamma_max_pg, new_set);
+    }
+
+    template <int LD, int HD, typename BetaType>
+    inline void update_LH_beta_fused_kernel(
+        const Index* begin, const Index* end, BetaType& beta,
+        Scalar lambda_lb, Scalar lambda_ub, Scalar gamma_lb, Scalar gamma_ub,
+        Scalar& lambda_min_pg, Scalar& lambda_max_pg,
+        Scalar& gamma_min_pg, Scalar& gamma_max_pg,
+        std::vector<Index>& new_set)
+    {
+        const Index L = (LD == Eigen::Dynamic) ? m_L : Index(LD);
+        const Index H = (HD == Eigen::Dynamic) ? m_H : Index(HD);
+        constexpr int LS = (LD > 0) ? LD : 1;
+        constexpr int HS = (HD > 0) ? HD : 1;
+        const FusedParams P = fused_params();
+
+        for (auto it = begin; it != end; ++it)
+        {
+            const Index i = *it;
+            const Scalar xi2 = beta_scale(beta) * m_xi2[i];
+            // Margin x[i]'beta, and coefficient of x[i] in the change of beta
+            Scalar xb = x_dot(i, beta);
+            Scalar delta = Scalar(0);
+            // Whether all dual variables of this sample are shrunk
+            bool all_shrink = true;
+
+            Scalar u[LS], v[LS], s[HS], t[HS], tau[HS];
+            load_params<LD, HD>(P, i, u, v, s, t, tau);
+
+            for (Index l = 0; l < L; l++)
+            {
+                const Scalar u_li = (LD > 0) ? u[l] : m_U(l, i);
+                if (LD == Eigen::Dynamic && lambda_dead(u_li, i))
+                    continue;
+                const Scalar v_li = (LD > 0) ? v[l] : m_V(l, i);
+                const Scalar lambda_li = m_Lambda(l, i);
+
+                // Compute g_li
+                const Scalar g_li = -(u_li * xb + v_li);
+                // PG and shrink
+                Scalar pg;
+                const bool shrink = pg_lambda(lambda_li, g_li, lambda_lb, lambda_ub, pg);
+                if (shrink)
+                    continue;
+                all_shrink = false;
+
+                // Update PG bounds
+                lambda_max_pg = std::max(lambda_max_pg, pg);
+                lambda_min_pg = std::min(lambda_min_pg, pg);
+                // Compute new lambda_li
+                const Scalar candid = lambda_li - g_li / (beta_scale(beta) * lambda_denom(u_li, i));
+                const Scalar newl = std::max(Scalar(0), std::min(Scalar(1), candid));
+                // Update Lambda and the margin
+                m_Lambda(l, i) = newl;
+                const Scalar dl = (newl - lambda_li) * u_li;
+                delta -= dl;
+                xb -= dl * xi2;
+            }
+
+            for (Index h = 0; h < H; h++)
+            {
+                const Scalar s_hi = (HD > 0) ? s[h] : m_S(h, i);
+                if (HD == Eigen::Dynamic && gamma_dead(s_hi, i))
+                    continue;
+                // tau_hi can be Inf
+                const Scalar tau_hi = (HD > 0) ? tau[h] : m_Tau(h, i);
+                const Scalar gamma_hi = m_Gamma(h, i);
+                const Scalar t_hi = (HD > 0) ? t[h] : m_T(h, i);
+
+                // Compute g_hi
+                const Scalar g_hi = gamma_hi - (s_hi * xb + t_hi);
+                // PG and shrink
+                Scalar pg;
+                const bool shrink = pg_gamma(gamma_hi, g_hi, tau_hi, gamma_lb, gamma_ub, pg);
+                if (shrink)
+                    continue;
+                all_shrink = false;
+
+                // Update PG bounds
+                gamma_max_pg = std::max(gamma_max_pg, pg);
+                gamma_min_pg = std::min(gamma_min_pg, pg);
+                // Compute new gamma_hi
+                const Scalar candid = gamma_hi - g_hi / gamma_denom(s_hi, i, beta);
+                const Scalar newg = std::max(Scalar(0), std::min(tau_hi, candid));
+                // Update Gamma and the margin
+                m_Gamma(h, i) = newg;
+                const Scalar dg = (newg - gamma_hi) * s_hi;
+                delta -= dg;
+                xb -= dg * xi2;
+            }
+
+            // Update beta
+            if (delta != Scalar(0))
+                x_axpy(i, delta, beta);
+
+            // Add to new free variable set
+            if (!all_shrink)
+                new_set.push_back(i);
+        }
+    }
+    // Update Lambda, Gamma, and beta
+    // Overloaded version of the fused updates based on the free sample set
+    template <typename BetaType>
+    inline void update_LH_beta_fused(
+        std::vector<Index>& fv_set,
+        Scalar& lambda_min_pg, Scalar& lambda_max_pg,
+        Scalar& gamma_min_pg, Scalar& gamma_max_pg,
+        BetaType& beta)
+    {
+        if (m_L < 1 && m_H < 1)
+            return;
+
+        // Permutation
+        shuffle_fv_set(fv_set);
+
+        // Compute shrinking thresholds lb and ub
+        // More details explained in update_xi_beta()
+        constexpr Scalar Inf = std::numeric_limits<Scalar>::infinity();
+        const Scalar lambda_lb = (lambda_min_pg < Scalar(0)) ? lambda_min_pg : -Inf;
+        const Scalar lambda_ub = (lambda_max_pg > Scalar(0)) ? lambda_max_pg : Inf;
+        const Scalar gamma_lb = (gamma_min_pg < Scalar(0)) ? gamma_min_pg : -Inf;
+        const Scalar gamma_ub = (gamma_max_pg > Scalar(0)) ? gamma_max_pg : Inf;
+
+        if (run_parallel(beta))
+        {
+            // Parallel version, see update_Lambda_beta()
+            internal::ShardResults<Index, Scalar> lambda_res(m_n_threads), gamma_res(m_n_threads);
+            if (m_sync)
+            {
+                run_sync(fv_set, [&](Index t, const Index* begin, const Index* end, internal::LocalBeta<Scalar>& local_beta) {
+                    lambda_res.sets[t].reserve(end - begin);
+                    update_LH_beta_fused_shard(begin, end, local_beta,
+                                               lambda_lb, lambda_ub, gamma_lb, gamma_ub,
+                                               lambda_res.min_pg[t], lambda_res.max_pg[t],
+                                               gamma_res.min_pg[t], gamma_res.max_pg[t],
+                                               lambda_res.sets[t]);
+                });
+            } else {
+                run_async(fv_set, [&](Index t, const Index* begin, const Index* end, internal::AtomicVector<Scalar>& shared_beta) {
+                    lambda_res.sets[t].reserve(end - begin);
+                    update_LH_beta_fused_shard(begin, end, shared_beta,
+                                               lambda_lb, lambda_ub, gamma_lb, gamma_ub,
+                                               lambda_res.min_pg[t], lambda_res.max_pg[t],
+                                               gamma_res.min_pg[t], gamma_res.max_pg[t],
+                                               lambda_res.sets[t]);
+                });
+            }
+            lambda_res.merge(fv_set, lambda_min_pg, lambda_max_pg);
+            gamma_res.merge_pg(gamma_min_pg, gamma_max_pg);
+        } else {
+            // New free variable set
+            std::vector<Index> new_set;
+            new_set.reserve(fv_set.size());
+            // Compute minimum and maximum projected gradient (PG) for this round
+            lambda_min_pg = gamma_min_pg = Inf;
+            lambda_max_pg = gamma_max_pg = -Inf;
+            update_LH_beta_fused_shard(fv_set.data(), fv_set.data() + fv_set.size(), beta,
+                                       lambda_lb, lambda_ub, gamma_lb, gamma_ub,
+                                       lambda_min_pg, lambda_max_pg, gamma_min_pg, gamma_max_pg,
+                                       new_set);
+            // Update free variable set
+            fv_set.swap(new_set);
+        }
+
+        // If L = 0 or H = 0, the corresponding PG bounds are not updated,
+        // and we set them to zero so that the convergence test can pass
+        if (m_L < 1)
+            lambda_min_pg = lambda_max_pg = Scalar(0);
+        if (m_H < 1)
+            gamma_min_pg = gamma_max_pg = Scalar(0);
+    }
+
+    // Permute the free variable set of Lambda and/or Gamma before each pass
+    template <typename FV>
+    inline void shuffle_fv_set(std::vector<FV>& fv_set)
+    {
+        if (m_block_size > 0)
+            internal::block_shuffle(fv_set, m_n, m_block_size, m_rng);
+        else
+            internal::random_shuffle(fv_set.begin(), fv_set.end(), m_rng);
+    }
+
+    // =================== Parallel drivers ================= //
+
+    // Asynchronous (Hogwild-style) parallel updates
+    // The shuffled free variable set is split into contiguous shards, and
+    // each thread calls f(t, begin, end, beta) on its shard, where beta is
+    // shared by all threads with lock-free atomic updates
+    template <typename FV, typename Func>
+    inline void run_async(const std::vector<FV>& fv_set, Func f)
+    {
+        m_beta_shared.assign(m_beta);
+        internal::parallel_shards(Index(fv_set.size()), m_n_threads,
+            [&](Index t, Index begin, Index end) {
+                f(t, fv_set.data() + begin, fv_set.data() + end, m_beta_shared);
+            });
+        m_beta_shared.copy_to(m_beta);
+    }
+
+    // Synchronous parallel updates
+    // Samples are partitioned into contiguous blocks owned by the threads. In each
+    // round, thread t calls f(t, begin, end, beta) on the free variables of its own
+    // samples, in the order of the shuffled free set, against a local copy of beta
+    // (with sigma = 1, i.e., as if the thread were alone). The local changes of the
+    // dual variables are then combined as alpha + eta * sum_t delta_t, where eta in
+    // [0, 1] minimizes the dual objective function along the combined change, which
+    // is a convex quadratic in eta; this keeps the dual variables feasible, and eta is
+    // close to 1 when the blocks interact little. The changes are added in the order
+    // of threads, so the result is reproducible for a fixed seed and number of threads
+    template <typename FV, typename Func>
+    inline void run_sync(const std::vector<FV>& fv_set, Func f)
+    {
+        const Index n_threads = m_n_threads;
+        std::vector<std::vector<FV>> parts(n_threads);
+        for (const auto& v: fv_set)
+        {
+            const Index i = internal::sample_index(v);
+            parts[Index((long long)(i) * n_threads / m_n)].push_back(v);
+        }
+
+        const Vector beta0 = m_beta;
+        const DenseMatrix Lambda0 = m_Lambda, Gamma0 = m_Gamma;
+        std::vector<internal::LocalBeta<Scalar>> betas(n_threads);
+        internal::parallel_shards(n_threads, n_threads,
+            [&](Index t, Index, Index) {
+                betas[t].vec = m_beta;
+                betas[t].sigma = Scalar(1);
+                f(t, parts[t].data(), parts[t].data() + parts[t].size(), betas[t]);
+            });
+
+        // Combined changes of beta and the dual variables
+        Vector dbeta = Vector::Zero(m_d);
+        for (Index t = 0; t < n_threads; t++)
+            dbeta.noalias() += betas[t].vec - beta0;
+        m_Lambda -= Lambda0;
+        m_Gamma -= Gamma0;
+
+        // Line search: the dual objective function at alpha + eta * delta is
+        // f(0) + eta * slope + 0.5 * eta^2 * curv, see dual_objfn()
+        Scalar slope = beta0.dot(dbeta), curv = dbeta.squaredNorm();
+        if (m_L > 0)
+            slope -= m_V.dot(m_Lambda);
+        if (m_H > 0)
+        {
+            slope += Gamma0.cwiseProduct(m_Gamma).sum() - m_T.dot(m_Gamma);
+            curv += m_Gamma.squaredNorm();
+        }
+        const Scalar eta = (curv > Scalar(0)) ?
+            std::max(Scalar(0), std::min(Scalar(1), -slope / curv)) : Scalar(1);
+
+        m_beta.noalias() = beta0 + eta * dbeta;
+        m_Lambda = Lambda0 + eta * m_Lambda;
+        m_Gamma = Gamma0 + eta * m_Gamma;
+    }
+
+    // Reset all free variable sets to the full sets, excluding the dead coordinates
+    inline void reset_fv_sets()
+    {
+        internal::reset_fv_set(m_fv_feas, m_K);
+        if (m_fused)
+        {
+            internal::reset_fv_set(m_fv_sample, m_n);
+            if (m_dead_sample > 0 || m_n_fixed_sample > 0)
+                m_fv_sample.erase(std::remove_if(m_fv_sample.begin(), m_fv_sample.end(),
+                    [this](Index i) { return sample_fixed(i) || sample_dead(i); }), m_fv_sample.end());
+        } else {
+            internal::reset_fv_set(m_fv_relu, m_L, m_n);
+            internal::reset_fv_set(m_fv_rehu, m_H, m_n);
+            if (m_dead_relu > 0 || m_n_fixed_relu > 0)
+                m_fv_relu.erase(std::remove_if(m_fv_relu.begin(), m_fv_relu.end(),
+                    [this](const std::pair<Index, Index>& li) {
+                        return lambda_fixed(li.first, li.second) ||
+                               lambda_dead(m_U(li.first, li.second), li.second);
+                    }), m_fv_relu.end());
+            if (m_dead_rehu > 0 || m_n_fixed_rehu > 0)
+                m_fv_rehu.erase(std::remove_if(m_fv_rehu.begin(), m_fv_rehu.end(),
+                    [this](const std::pair<Index, Index>& hi) {
+                        return gamma_fixed(hi.first, hi.second) ||
+                               gamma_dead(m_S(hi.first, hi.second), hi.second);
+                    }), m_fv_rehu.end());
+        }
+    }
+
+    // Whether lambda_li and gamma_hi are dead, or at a bound of their boxes with the
+    // gradient pushing them against the bound, given the margin xb = x[i]' * beta
+    // Such coordinates are not changed by the next update (see pg_lambda() and pg_gamma())
+    inline bool lambda_held(Index l, Index i, Scalar xb) const
+    {
+        const Scalar u_li = m_U(l, i), lambda = m_Lambda(l, i);
+        const Scalar g_li = -(u_li * xb + m_V(l, i));
+        return lambda_dead(u_li, i) ||
+               (lambda == Scalar(0) && g_li > Scalar(0)) || (lambda == Scalar(1) && g_li < Scalar(0));
+    }
+    inline bool gamma_held(Index h, Index i, Scalar xb) const
+    {
+        const Scalar s_hi = m_S(h, i), gamma = m_Gamma(h, i);
+        const Scalar g_hi = gamma - (s_hi * xb + m_T(h, i));
+        return gamma_dead(s_hi, i) ||
+               (gamma == Scalar(0) && g_hi > Scalar(0)) || (gamma == m_Tau(h, i) && g_hi < Scalar(0));
+    }
+
+    // Remove the coordinates held at a bound by their gradients from the free variable
+    // sets, i.e., xi_k = 0, lambda_li in {0, 1}, and gamma_hi in {0, tau_hi}, as decided
+    // by lambda_held() and gamma_held(); in the fused updates, a sample is removed if
+    // all its coordinates are held
+    // After a warm start from a nearby solution, most of these coordinates stay at the
+    // bound, and the others are visited again once the free variables converge
+    inline void drop_fv_at_bounds()
+    {
+        m_fv_feas.erase(std::remove_if(m_fv_feas.begin(), m_fv_feas.end(),
+            [this](Index k) { return m_xi[k] == Scalar(0) && a_dot(k, m_beta) + m_b[k] > Scalar(0); }),
+            m_fv_feas.end());
+        if (m_L + m_H < 1)
+            return;
+
+        Vector xb(m_n);
+        for (Index i = 0; i < m_n; i++)
+            xb[i] = x_dot(i, m_beta);
+        if (m_fused)
+        {
+            m_fv_sample.erase(std::remove_if(m_fv_sample.begin(), m_fv_sample.end(),
+                [this, &xb](Index i) -> bool {
+                    for (Index l = 0; l < m_L; l++)
+                        if (!lambda_held(l, i, xb[i]))
+                            return false;
+                    for (Index h = 0; h < m_H; h++)
+                        if (!gamma_held(h, i, xb[i]))
+                            return false;
+                    return true;
+                }), m_fv_sample.end());
+        } else {
+            m_fv_relu.erase(std::remove_if(m_fv_relu.begin(), m_fv_relu.end(),
+                [this, &xb](const std::pair<Index, Index>& li) {
+                    return lambda_held(li.first, li.second, xb[li.second]);
+                }), m_fv_relu.end());
+            m_fv_rehu.erase(std::remove_if(m_fv_rehu.begin(), m_fv_rehu.end(),
+                [this, &xb](const std::pair<Index, Index>& hi) {
+                    return gamma_held(hi.first, hi.second, xb[hi.second]);
+                }), m_fv_rehu.end());
+        }
+    }
+
+    // Sum of u_li * lambda_li + s_hi * gamma_hi of sample i, whose contribution to beta
+    // is minus this sum times x[i]
+    inline Scalar sample_dual_coef(Index i) const
+    {
+        Scalar coef = Scalar(0);
+        for (Index l = 0; l < m_L; l++)
+            coef += m_U(l, i) * m_Lambda(l, i);
+        for (Index h = 0; h < m_H; h++)
+            coef += m_S(h, i) * m_Gamma(h, i);
+        return coef;
+    }
+
+    // Loss of sample i at the margin z = x[i]'beta
+    inline Scalar sample_loss(Index i, Scalar z) const
+    {
+        Scalar res = Scalar(0);
+        for (Index l = 0; l < m_L; l++)
+            res += std::max(Scalar(0), m_U(l, i) * z + m_V(l, i));
+        for (Index h = 0; h < m_H; h++)
+        {
+            const Scalar r = std::max(Scalar(0), m_S(h, i) * z + m_T(h, i)), tau = m_Tau(h, i);
+            res += (r <= tau) ? Scalar(0.5) * r * r : tau * (r - Scalar(0.5) * tau);
+        }
+        return res;
+    }
+
+    // Make X and the loss parameters reference the data of n samples, used by
+    // append_samples() and remove_samples(); the shapes are checked first
+    inline void rebind_data(Index n, const XInput& X, const ParamMat& U, const ParamMat& V, const ParamMat& S,
+                            const ParamMat& T, const ParamMat& Tau)
+    {
+        static_assert(std::is_same<Storage, StoreAsIs>::value, "changing the samples requires the StoreAsIs policy");
+        const bool relu_ok = (U.rows() == m_L) && (V.rows() == m_L) &&
+                             (m_L == 0 || (U.cols() == n && V.cols() == n));
+        const bool rehu_ok = (S.rows() == m_H) && (T.rows() == m_H) && (Tau.rows() == m_H) &&
+                             (m_H == 0 || (S.cols() == n && T.cols() == n && Tau.cols() == n));
+        if (X.rows() != n || X.cols() != m_d || !relu_ok || !rehu_ok)
+            throw std::invalid_argument("the data of the samples must have the shapes of the old ones");
+
+        m_X.~XStorage();
+        new (&m_X) XStorage(X);
+        m_U = U;
+        m_V = V;
+        m_S = S;
+        m_T = T;
+        m_Tau = Tau;
+        m_n = n;
+    }
+
+    // Restrict the free variable sets to the samples appended by append_samples() and
+    // the old samples drawn for revisiting, so that solve() first converges on these,
+    // and then tests all variables as after shrinking; the focus is used only once
+    inline void focus_fv_sets()
+    {
+        std::vector<char> visit(m_n, 0);
+        std::fill(visit.begin() + m_focus_begin, visit.end(), 1);
+        if (m_focus_begin > 0)
+        {
+            for (Index j = 0; j < m_n_revisit; j++)
+                visit[m_rng(m_focus_begin)] = 1;
+        }
+        m_focus_begin = m_n;
+        m_n_revisit = 0;
+
+        if (m_fused)
+        {
+            m_fv_sample.erase(std::remove_if(m_fv_sample.begin(), m_fv_sample.end(),
+                [&visit](Index i) { return !visit[i]; }), m_fv_sample.end());
+        } else {
+            m_fv_relu.erase(std::remove_if(m_fv_relu.begin(), m_fv_relu.end(),
+                [&visit](const std::pair<Index, Index>& li) { return !visit[li.second]; }), m_fv_relu.end());
+            m_fv_rehu.erase(std::remove_if(m_fv_rehu.begin(), m_fv_rehu.end(),
+                [&visit](const std::pair<Index, Index>& hi) { return !visit[hi.second]; }), m_fv_rehu.end());
+        }
+    }
+
+    // Whether the free variable sets contain all variables
+    inline bool all_fv_sets() const
+    {
+        const bool all_feas = (m_fv_feas.size() == static_cast<std::size_t>(m_K));
+        if (m_fused)
+            return all_feas && (m_fv_sample.size() == static_cast<std::size_t>(m_n - m_dead_sample - m_n_fixed_sample));
+        return all_feas &&
+               (m_fv_relu.size() == static_cast<std::size_t>(m_L * m_n - m_dead_relu - m_n_fixed_relu)) &&
+               (m_fv_rehu.size() == static_cast<std::size_t>(m_H * m_n - m_dead_rehu - m_n_fixed_rehu));
+    }
+
+public:
+    // U, V, S, T, and Tau can be dense matrices or internal::ParamMatrix objects
+    // xi2, if given, holds the precomputed ||x[i]||^2, e.g., of a block of rows that
+    // is solved repeatedly (see ReHLineStreamSolver)
+    ReHLineSolver(const XInput& X, const ParamMat& U, const ParamMat& V,
+                  const ParamMat& S, const ParamMat& T, const ParamMat& Tau,
+                  ConstRefMat A, ConstRefVec b, const Vector* xi2 = nullptr) :
+        m_n(X.rows()), m_d(X.cols()), m_L(U.rows()), m_H(S.rows()), m_K(A.rows()),
+        m_X(X), m_U(U), m_V(V), m_S(S), m_T(T), m_Tau(Tau), m_A(A), m_b(b),
+        m_xi2_buf(m_n), m_xi2(m_xi2_buf.data(), m_n), m_gk_denom(m_K),
+        m_beta(m_d), m_xi(m_K), m_Lambda_buf(m_L, m_n), m_Gamma_buf(m_H, m_n),
+        m_Lambda(m_Lambda_buf.data(), m_L, m_n, Eigen::OuterStride<>(m_Lambda_buf.outerStride())),
+        m_Gamma(m_Gamma_buf.data(), m_H, m_n, Eigen::OuterStride<>(m_Gamma_buf.outerStride())),
+        m_fused(false), m_n_threads(1), m_sync(false), m_block_size(0),
+        m_screen_bounds(false), m_screening(true), m_focus_begin(m_n), m_n_revisit(0)
+    {
+        std::fill(m_local_pg, m_local_pg + 6, Scalar(0));
+
+        // A [K x d], K can be zero
+        if (m_K > 0)
+            m_gk_denom.noalias() = m_A.rowwise().squaredNorm();
+
+        if (xi2 != nullptr)
+            m_xi2.noalias() = *xi2;
+        else
+            m_xi2.noalias() = internal::row_squared_norms(m_X);
+        count_dead();
+        clear_fixed();
+    }
+
+    // Set the dual variables of the dead coordinates to their optimal values,
+    // lambda_li = I(v_li > 0) and gamma_hi = clip(t_hi, 0, tau_hi)
+    inline void fix_dead_duals()
+    {
+        if (m_dead_relu == 0 && m_dead_rehu == 0)
+            return;
+
+        for (Index i = 0; i < m_n; i++)
+        {
+            for (Index l = 0; l < m_L; l++)
+                if (lambda_dead(m_U(l, i), i))
+                    m_Lambda(l, i) = (m_V(l, i) > Scalar(0)) ? Scalar(1) : Scalar(0);
+            for (Index h = 0; h < m_H; h++)
+                if (gamma_dead(m_S(h, i), i))
+                    m_Gamma(h, i) = std::max(Scalar(0), std::min(m_Tau(h, i), m_T(h, i)));
+        }
+    }
+
+    // Initialize primal and dual variables
+    inline void init_params()
+    {
+        // xi >= 0, initialized to be 1
+        if (m_K > 0)
+            m_xi.fill(Scalar(1));
+
+        // Each element of Lambda satisfies 0 <= lambda_li <= 1,
+        // and we use 0.5 to initialize Lambda
+        if (m_L > 0)
+            m_Lambda.fill(Scalar(0.5));
+
+        // Each element of Gamma satisfies 0 <= gamma_hi <= tau_hi,
+        // and we use min(0.5 * tau_hi, 1) to initialize (tau_hi can be Inf)
+        for (Index h = 0; h < m_H; h++)
+        {
+            m_Gamma.row(h).noalias() = (Scalar(0.5) * m_Tau.row(h)).cwiseMin(Scalar(1)).transpose();
+        }
+        fix_dead_duals();
+
+        // zeta is initialized to be zero
+        m_zeta.setZero(m_l1_pen.size());
+
+        // Set primal variable based on duals
+        set_primal();
+
+        // Shrinking thresholds of solve_local()
+        std::fill(m_local_pg, m_local_pg + 6, Scalar(0));
+    }
+
+    // Replace the loss parameters, e.g., after new responses or sample weights, with
+    // the shapes unchanged; the data are referenced as in the constructor
+    // The dual variables are kept as the initial values of the next solve(): Gamma is
+    // projected onto the new [0, tau], the dead coordinates are recounted and fixed
+    // at their optima, and beta is recomputed from the dual variables
+    inline void set_loss_params(const ParamMat& U, const ParamMat& V, const ParamMat& S,
+                                const ParamMat& T, const ParamMat& Tau)
+    {
+        const bool relu_ok = (U.rows() == m_L) && (V.rows() == m_L) &&
+                             (m_L == 0 || (U.cols() == m_n && V.cols() == m_n));
+        const bool rehu_ok = (S.rows() == m_H) && (T.rows() == m_H) && (Tau.rows() == m_H) &&
+                             (m_H == 0 || (S.cols() == m_n && T.cols() == m_n && Tau.cols() == m_n));
+        if (!relu_ok || !rehu_ok)
+            throw std::invalid_argument("the new loss parameters must have the shapes of the old ones");
+
+        m_U = U;
+        m_V = V;
+        m_S = S;
+        m_T = T;
+        m_Tau = Tau;
+
+        for (Index i = 0; i < m_n; i++)
+            for (Index h = 0; h < m_H; h++)
+                m_Gamma(h, i) = std::max(Scalar(0), std::min(m_Tau(h, i), m_Gamma(h, i)));
+        count_dead();
+        fix_dead_duals();
+        set_primal();
+    }
+
+    // Append the samples in rows n, ..., X.rows() - 1 of X and the same columns of the
+    // loss parameters, where n is the current number of samples, and the first n rows and
+    // columns must hold the current data, e.g., in a larger buffer; the data are referenced
+    // as in the constructor (a column-majored X is copied again)
+    // The dual variables of the new samples are set from their margins at the current beta
+    // as in warm_start(), and beta is updated accordingly; the next solve() first visits
+    // the new samples and n_revisit old samples drawn at random, and then all samples
+    inline void append_samples(const XInput& X, const ParamMat& U, const ParamMat& V, const ParamMat& S,
+                               const ParamMat& T, const ParamMat& Tau, Index n_revisit)
+    {
+        const Index n_old = m_n, n = std::max(Index(X.rows()), n_old);
+        rebind_data(n, X, U, V, S, T, Tau);
+
+        resize_samples(n);
+        m_xi2.tail(n - n_old).noalias() = internal::row_squared_norms(m_X.middleRows(n_old, n - n_old));
+        for (Index i = n_old; i < n; i++)
+        {
+            const Scalar xb = x_dot(i, m_beta);
+            for (Index l = 0; l < m_L; l++)
+            {
+                const Scalar u_li = m_U(l, i), v_li = m_V(l, i), z = u_li * xb + v_li;
+                Scalar& lambda = m_Lambda(l, i);
+                if (lambda_dead(u_li, i))
+                    lambda = (v_li > Scalar(0)) ? Scalar(1) : Scalar(0);
+                else
+                    lambda = (z > Scalar(0)) ? Scalar(1) : ((z < Scalar(0)) ? Scalar(0) : Scalar(0.5));
+            }
+            for (Index h = 0; h < m_H; h++)
+            {
+                const Scalar s_hi = m_S(h, i);
+                const Scalar z = gamma_dead(s_hi, i) ? m_T(h, i) : s_hi * xb + m_T(h, i);
+                m_Gamma(h, i) = std::max(Scalar(0), std::min(m_Tau(h, i), z));
+            }
+            x_axpy(i, -sample_dual_coef(i), m_beta);
+
+            Index dead_l, dead_h;
+            count_dead(i, dead_l, dead_h);
+            m_dead_relu += dead_l;
+            m_dead_rehu += dead_h;
+            m_dead_sample += (dead_l + dead_h == m_L + m_H);
+        }
+
+        clear_fixed();
+        m_focus_begin = std::min(m_focus_begin, n_old);
+        m_n_revisit = std::max(m_n_revisit, n_revisit);
+    }
+
+    // Remove the samples in idx, given in increasing order, e.g., the oldest samples of a
+    // sliding window; their contributions to beta are subtracted using the current X, which
+    // must stay valid during the call, and X and the loss parameters are then rebound to the
+    // data of the remaining samples in the same order, e.g., a view without the first rows
+    // The other dual variables are kept, and the next solve() first visits n_revisit samples
+    // drawn at random (and the samples appended since the last solve()), and then all samples
+    inline void remove_samples(const std::vector<Index>& idx, const XInput& X, const ParamMat& U,
+                               const ParamMat& V, const ParamMat& S, const ParamMat& T, const ParamMat& Tau,
+                               Index n_revisit)
+    {
+        const Index n_old = m_n, k = idx.size();
+        for (Index j = 0; j < k; j++)
+        {
+            if (idx[j] < 0 || idx[j] >= n_old || (j > 0 && idx[j] <= idx[j - 1]))
+                throw std::invalid_argument("the removed samples must be distinct indices in increasing order");
+        }
+
+        // Contributions to beta, read before X is rebound
+        Vector beta = m_beta;
+        for (Index j = 0; j < k; j++)
+            x_axpy(idx[j], sample_dual_coef(idx[j]), beta);
+        rebind_data(n_old - k, X, U, V, S, T, Tau);
+        m_beta.swap(beta);
+
+        // Move the variables of the remaining samples to their new positions
+        Index i_new = 0, focus_begin = m_focus_begin;
+        for (Index i = 0, j = 0; i < n_old; i++)
+        {
+            if (j < k && idx[j] == i)
+            {
+                j++;
+                focus_begin -= (i < m_focus_begin);
+                continue;
+            }
+            if (i_new != i)
+            {
+                m_xi2[i_new] = m_xi2[i];
+                m_Lambda.col(i_new) = m_Lambda.col(i);
+                m_Gamma.col(i_new) = m_Gamma.col(i);
+            }
+            i_new++;
+        }
+        resize_samples(m_n);
+
+        count_dead();
+        clear_fixed();
+        m_focus_begin = focus_begin;
+        m_n_revisit = std::max(m_n_revisit, n_revisit);
+    }
+
+    // Approximate leave-one-out margins x[i]'beta[-i] of the samples in idx, where beta[-i]
+    // is beta without the contribution of sample i, followed by n_passes passes of the
+    // coordinate updates of Lambda and Gamma of the other samples, with shrinking as in
+    // solve(); the changed dual variables are restored afterwards, and xi is kept
+    // With n_passes = 0, the margin is x[i]'beta + (u_i'lambda_i + s_i'gamma_i) * ||x[i]||^2,
+    // which for the hinge loss gives the leave-one-out bound of Jaakkola and Haussler (1999);
+    // a sample with no contribution to beta has its exact leave-one-out margin
+    // Each pass costs O(nnz(X) * (L + H)) per sample in idx
+    inline Vector loo_margins(const std::vector<Index>& idx, Index n_passes)
+    {
+        for (Index i: idx)
+        {
+            if (i < 0 || i >= m_n)
+                throw std::invalid_argument("the indices of the samples are out of range");
+        }
+
+        constexpr Scalar Inf = std::numeric_limits<Scalar>::infinity();
+        Vector res(idx.size()), beta(m_d);
+        // Coordinates that are not dead, built on first use, and those of the other samples
+        std::vector<std::pair<Index, Index>> all_relu, all_rehu, set_relu, set_rehu, new_set;
+        DualJournal journal_relu, journal_rehu;
+        for (std::size_t j = 0; j < idx.size(); j++)
+        {
+            const Index i = idx[j];
+            const Scalar coef = sample_dual_coef(i);
+            if (coef == Scalar(0) || n_passes < 1)
+            {
+                res[j] = x_dot(i, m_beta) + coef * m_xi2[i];
+                continue;
+            }
+
+            if (all_relu.empty() && all_rehu.empty())
+            {
+                for (Index k = 0; k < m_n; k++)
+                {
+                    for (Index l = 0; l < m_L; l++)
+                    {
+                        if (!lambda_dead(m_U(l, k), k))
+                            all_relu.emplace_back(l, k);
+                    }
+                    for (Index h = 0; h < m_H; h++)
+                    {
+                        if (!gamma_dead(m_S(h, k), k))
+                            all_rehu.emplace_back(h, k);
+                    }
+                }
+            }
+            const auto other = [i](const std::pair<Index, Index>& rc) -> bool { return rc.second != i; };
+            set_relu.clear();
+            std::copy_if(all_relu.begin(), all_relu.end(), std::back_inserter(set_relu), other);
+            set_rehu.clear();
+            std::copy_if(all_rehu.begin(), all_rehu.end(), std::back_inserter(set_rehu), other);
+
+            beta.noalias() = m_beta;
+            x_axpy(i, coef, beta);
+            // PG bounds of the previous pass, which give the shrinking thresholds
+            Scalar lambda_min_pg = Scalar(0), lambda_max_pg = Scalar(0);
+            Scalar gamma_min_pg = Scalar(0), gamma_max_pg = Scalar(0);
+            for (Index pass = 0; pass < n_passes; pass++)
+            {
+                Scalar lb = (lambda_min_pg < Scalar(0)) ? lambda_min_pg : -Inf;
+                Scalar ub = (lambda_max_pg > Scalar(0)) ? lambda_max_pg : Inf;
+                lambda_min_pg = Inf;
+                lambda_max_pg = -Inf;
+                new_set.clear();
+                update_Lambda_beta_shard(set_relu.data(), set_relu.data() + set_relu.size(), beta,
+                                         lb, ub, lambda_min_pg, lambda_max_pg, new_set, &journal_relu);
+                set_relu.swap(new_set);
+
+                lb = (gamma_min_pg < Scalar(0)) ? gamma_min_pg : -Inf;
+                ub = (gamma_max_pg > Scalar(0)) ? gamma_max_pg : Inf;
+                gamma_min_pg = Inf;
+                gamma_max_pg = -Inf;
+                new_set.clear();
+                update_Gamma_beta_shard(set_rehu.data(), set_rehu.data() + set_rehu.size(), beta,
+                                        lb, ub, gamma_min_pg, gamma_max_pg, new_set, &journal_rehu);
+                set_rehu.swap(new_set);
+            }
+            res[j] = x_dot(i, beta);
+
+            journal_relu.undo(m_Lambda);
+            journal_rehu.undo(m_Gamma);
+        }
+        return res;
+    }
+
+    // Losses of the samples in idx at the margins z
+    inline Vector sample_losses(const std::vector<Index>& idx, const Vector& z) const
+    {
+        if (z.size() != Index(idx.size()))
+            throw std::invalid_argument("the margins must have the size of the indices");
+        Vector res(idx.size());
+        for (std::size_t j = 0; j < idx.size(); j++)
+        {
+            if (idx[j] < 0 || idx[j] >= m_n)
+                throw std::invalid_argument("the indices of the samples are out of range");
+            res[j] = sample_loss(idx[j], z[j]);
+        }
+        return res;
+    }
+
+    // Warm start from the variables of a previous fit, called after init_params()
+    // If Lambda, Gamma, and xi have the sizes of this problem (the empty ones are
+    // ignored), they are projected onto the feasible set, and beta is recomputed
+    // from them; otherwise, if beta has size d, the dual variables are derived
+    // from its margins: lambda_li is 1, 0, or 0.5 as u_li * x[i]'beta + v_li is positive,
+    // negative, or zero, gamma_hi = clip(s_hi * x[i]'beta + t_hi, 0, tau_hi), and xi_k
+    // is set to zero if the k-th constraint is inactive; otherwise, nothing is changed
+    template <typename VecType, typename MatType>
+    inline void warm_start(const VecType& beta, const VecType& xi, const MatType& Lambda, const MatType& Gamma)
+    {
+        const bool dual = (m_L > 0 || m_H > 0 || m_K > 0) &&
+            (m_L == 0 || (Lambda.rows() == m_L && Lambda.cols() == m_n)) &&
+            (m_H == 0 || (Gamma.rows() == m_H && Gamma.cols() == m_n)) &&
+            (m_K == 0 || xi.size() == m_K);
+        if (dual)
+        {
+            if (m_K > 0)
+                m_xi.noalias() = xi.cwiseMax(Scalar(0));
+            if (m_L > 0)
+                m_Lambda.noalias() = Lambda.cwiseMax(Scalar(0)).cwiseMin(Scalar(1));
+            for (Index h = 0; h < m_H; h++)
+                m_Gamma.row(h).noalias() = Gamma.row(h).cwiseMax(Scalar(0)).cwiseMin(m_Tau.row(h).transpose());
+        } else if (beta.size() == m_d) {
+            const Vector Xbeta = internal::mat_vec(m_X, beta);
+            for (Index i = 0; i < m_n; i++)
+            {
+                for (Index l = 0; l < m_L; l++)
+                {
+                    const Scalar z = m_U(l, i) * Xbeta[i] + m_V(l, i);
+                    m_Lambda(l, i) = (z > Scalar(0)) ? Scalar(1) : ((z < Scalar(0)) ? Scalar(0) : Scalar(0.5));
+                }
+                for (Index h = 0; h < m_H; h++)
+                {
+                    const Scalar z = m_S(h, i) * Xbeta[i] + m_T(h, i);
+                    m_Gamma(h, i) = std::max(Scalar(0), std::min(m_Tau(h, i), z));
+                }
+            }
+            for (Index k = 0; k < m_K; k++)
+            {
+                if (m_A.row(k).dot(beta) + m_b[k] > Scalar(0))
+                    m_xi[k] = Scalar(0);
+            }
+        } else {
+            return;
+        }
+        fix_dead_duals();
+        set_primal();
+    }
+
+    inline void set_seed(Index seed) { m_rng.seed(seed); }
+
+    // Add the L1 penalty sum_j l1_pen[j] * |beta[j]| to the primal objective function,
+    // with one dual variable per feature instead of the rows of an identity matrix
+    // appended to X; l1_pen is a [d] vector, or empty for no L1 penalty
+    // Must be called before init_params(), and is only used by solve() and solve_vanilla()
+    inline void set_l1_pen(ConstRefVec l1_pen)
+    {
+        if (l1_pen.size() != 0 && l1_pen.size() != m_d)
+            throw std::invalid_argument("l1_pen must have length zero or the number of columns of X");
+        m_l1_pen = l1_pen;
+    }
+
+    // Whether to update the (L + H) dual variables of each sample together,
+    // which streams each row of X once per iteration
+    inline void set_fused(bool fused) { m_fused = fused; }
+
+    // Number of threads used by solve()
+    // Threads update disjoint shards of the free variable sets of Lambda and Gamma,
+    // and share beta using lock-free atomic updates (Hogwild-style)
+    // If n_threads <= 0, use all available hardware threads
+    inline void set_threads(Index n_threads)
+    {
+        if (n_threads <= 0)
+            n_threads = Index(std::thread::hardware_concurrency());
+        m_n_threads = std::max(Index(1), n_threads);
+    }
+
+    // Whether to use the synchronous parallel updates (CoCoA-style) in solve()
+    // Each thread works on its own block of samples against a local copy of beta,
+    // and the local changes are reduced at the end of each iteration, which gives
+    // deterministic results for a fixed seed and number of threads
+    inline void set_sync(bool sync) { m_sync = sync; }
+
+    // Visit the samples in contiguous blocks of block_size rows in solve(),
+    // with the blocks and the variables within each block shuffled
+    // This keeps the accesses to X local when X is memory-mapped from disk
+    // If block_size <= 0, the free variables are fully shuffled
+    inline void set_block_size(Index block_size) { m_block_size = std::max(Index(0), block_size); }
+
+    // Whether solve() starts from the free variable sets without the coordinates held
+    // at a bound of their boxes (see drop_fv_at_bounds()), which is useful after a warm
+    // start from a nearby solution
+    // The final convergence test is still done on all variables
+    inline void set_screen_bounds(bool screen) { m_screen_bounds = screen; }
+
+    // Whether solve() fixes the coordinates certified by the gap-safe screening
+    // (see screen_gap_safe()) each time the free variables converge
+    inline void set_screening(bool screening) { m_screening = screening; }
+
+    inline Index solve_vanilla(
+        std::vector<Scalar>& dual_objfns, std::vector<Scalar>& primal_objfns,
+        Index max_iter, Scalar tol,
+        Index verbose = 0, Index trace_freq = 100,
+        std::ostream& cout = std::cout)
+    {
+        // PG bounds of zeta, not used in the convergence test
+        Scalar l1_min_pg = Scalar(0), l1_max_pg = Scalar(0);
+        // All samples are visited, so the focus of append_samples() is dropped
+        m_focus_begin = m_n;
+        m_n_revisit = 0;
+
+        // Main iterations
+        Index i = 0;
+        Vector old_xi(m_K), old_beta(m_d), old_zeta(m_zeta.size());
+        for(; i < max_iter; i++)
+        {
+            old_xi.noalias() = m_xi;
+            old_beta.noalias() = m_beta;
+            old_zeta.noalias() = m_zeta;
+
+            update_xi_beta();
+            if (m_fused)
+            {
+                update_LH_beta_fused();
+            } else {
+                update_Lambda_beta();
+                update_Gamma_beta();
+            }
+            update_l1_beta(l1_min_pg, l1_max_pg);
+
+            // Compute difference of xi and beta
+            const Scalar xi_diff = (m_K > 0) ? (m_xi - old_xi).norm() : Scalar(0);
+            const Scalar beta_diff = beta_change(old_beta, old_zeta);
+
+            // Print progress
+            if (verbose && (i % trace_freq == 0))
+            {
+                Scalar dual = dual_objfn();
+                dual_objfns.push_back(dual);
+                Scalar primal = primal_objfn();
+                primal_objfns.push_back(primal);
+                cout << "Iter " << i << ", dual_objfn = " << dual <<
+                    ", primal_objfn = " << primal <<
+                    ", xi_diff = " << xi_diff <<
+                    ", beta_diff = " << beta_diff << std::endl;
+            }
+
+            // Convergence test based on change of variable values
+            const bool vars_conv = (xi_diff < tol) && (beta_diff < tol);
+            if (vars_conv)
+                break;
+        }
+
+        return i;
+    }
+
+    inline Index solve(
+        std::vector<Scalar>& dual_objfns, std::vector<Scalar>& primal_objfns,
+        Index max_iter, Scalar tol,
+        Index verbose = 0, Index trace_freq = 100,
+        std::ostream& cout = std::cout)
+    {
+        // Free variable sets, with no coordinates fixed by the gap-safe screening yet
+        clear_fixed();
+        reset_fv_sets();
+        if (m_screen_bounds)
+            drop_fv_at_bounds();
+        // After append_samples() or remove_samples(), start from the new samples and
+        // the samples drawn for revisiting
+        if (m_focus_begin < m_n || m_n_revisit > 0)
+        {
+            if (verbose)
+                cout << "*** Start from the " << m_n - m_focus_begin << " appended samples and " <<
+                    m_n_revisit << " samples drawn for revisiting" << std::endl;
+            focus_fv_sets();
+        }
+
+        // Minimum and maximum projected gradients of dual variables in each outer iteration
+        // These variables will be updated in update_*_beta() functions below
+        // If some dual variables are not used, the corresponding pg variables
+        // will always be zero, so that the related tests in pg_conv below return true values
+        Scalar xi_min_pg = Scalar(0), lambda_min_pg = Scalar(0), gamma_min_pg = Scalar(0), l1_min_pg = Scalar(0);
+        Scalar xi_max_pg = Scalar(0), lambda_max_pg = Scalar(0), gamma_max_pg = Scalar(0), l1_max_pg = Scalar(0);
+
+        // Main iterations
+        Index i = 0;
+        Vector old_xi(m_K), old_beta(m_d), old_zeta(m_zeta.size());
+        for(; i < max_iter; i++)
+        {
+            old_xi.noalias() = m_xi;
+            old_beta.noalias() = m_beta;
+            old_zeta.noalias() = m_zeta;
+
+            update_xi_beta(m_fv_feas, xi_min_pg, xi_max_pg, m_beta);
+            if (m_fused)
+            {
+                update_LH_beta_fused(m_fv_sample, lambda_min_pg, lambda_max_pg, gamma_min_pg, gamma_max_pg, m_beta);
+            } else {
+                update_Lambda_beta(m_fv_relu, lambda_min_pg, lambda_max_pg, m_beta);
+                update_Gamma_beta(m_fv_rehu, gamma_min_pg, gamma_max_pg, m_beta);
+            }
+            // zeta is always updated in full, since each update is O(1)
+            update_l1_beta(l1_min_pg, l1_max_pg);
+
+            // Compute difference of xi and beta
+            const Scalar xi_diff = (m_K > 0) ? (m_xi - old_xi).norm() : Scalar(0);
+            const Scalar beta_diff = beta_change(old_beta, old_zeta);
+
+            // Convergence test based on change of variable values
+            const bool vars_conv = (xi_diff < tol) && (beta_diff < tol);
+            // Convergence test based on PG
+            const bool pg_conv = (xi_max_pg - xi_min_pg < tol) &&
+                                 (std::abs(xi_max_pg) < tol) &&
+                                 (std::abs(xi_min_pg) < tol) &&
+                                 (lambda_max_pg - lambda_min_pg < tol) &&
+                                 (std::abs(lambda_max_pg) < tol) &&
+                                 (std::abs(lambda_min_pg) < tol) &&
+                                 (gamma_max_pg - gamma_min_pg < tol) &&
+                                 (std::abs(gamma_max_pg) < tol) &&
+                                 (std::abs(gamma_min_pg) < tol) &&
+                                 (std::abs(l1_max_pg) < tol) &&
+                                 (std::abs(l1_min_pg) < tol);
+            // Whether we are using all variables
+            const bool all_vars = all_fv_sets();
+
+            // Print progress
+            if (verbose && (i % trace_freq == 0))
+            {
+                Scalar dual = dual_objfn();
+                dual_objfns.push_back(dual);
+                Scalar primal = primal_objfn();
+                primal_objfns.push_back(primal);
+                cout << "Iter " << i << ", dual_objfn = " << dual <<
+                    ", primal_objfn = " << primal <<
+                    ", xi_diff = " << xi_diff <<
+                    ", beta_diff = " << beta_diff << std::endl;
+                if (verbose >= 2)
+                {
+                    if (m_fused)
+                    {
+                        cout << "    xi (" << m_fv_feas.size() << "/" << m_K <<
+                            "), sample (" << m_fv_sample.size() << "/" << m_n << ")" << std::endl;
+                    } else {
+                        cout << "    xi (" << m_fv_feas.size() << "/" << m_K <<
+                            "), lambda (" << m_fv_relu.size() << "/" << m_L * m_n <<
+                            "), gamma (" << m_fv_rehu.size() << "/" << m_H * m_n << ")" << std::endl;
+                    }
+                    cout << "    xi_pg = (" << xi_min_pg << ", " << xi_max_pg <<
+                        "), lambda_pg = (" << lambda_min_pg << ", " << lambda_max_pg <<
+                        "), gamma_pg = (" << gamma_min_pg << ", " << gamma_max_pg << ")" << std::endl;
+                }
+            }
+
+            // If variable value or PG converges but not on all variables,
+            // use all variables in the next iteration
+            if ((vars_conv || pg_conv) && (!all_vars))
+            {
+                if (verbose)
+                {
+                    cout << "*** Iter " << i <<
+                        ", free variables converge; next test on all variables" << std::endl;
+                }
+                // The free variables are near the optimum, where the duality gap is
+                // small enough to fix some coordinates for good
+                const Index n_fixed = m_screening ? screen_gap_safe() : Index(0);
+                if (verbose && n_fixed > 0)
+                {
+                    cout << "*** Iter " << i << ", gap-safe screening fixes " << n_fixed <<
+                        " coordinates (" << m_n_fixed_relu + m_n_fixed_rehu << " in total)" << std::endl;
+                }
+                reset_fv_sets();
+                xi_min_pg = lambda_min_pg = gamma_min_pg = Scalar(0);
+                xi_max_pg = lambda_max_pg = gamma_max_pg = Scalar(0);
+                // Also recompute beta to improve precision
+                // set_primal();
+                continue;
+            }
+            if (all_vars && (vars_conv || pg_conv) && sync_converged(tol))
+                break;
+        }
+
+        return i;
+    }
+
+    // Local updates of a worker in the distributed solver (CoCoA-style)
+    // The worker owns a block of the samples and/or the linear constraints, and
+    // m_beta holds the current global primal variable set by the coordinator.
+    // The dual variables of the block are updated by n_epochs passes on the local
+    // subproblem, in which the quadratic term of the local change of beta is
+    // scaled by sigma (the number of blocks). Since beta has been changed by the
+    // other blocks, the free variable sets start from the full sets in each call,
+    // and the PG bounds of the previous call are used as the shrinking thresholds.
+    // Returns the change of beta implied by the local updates, and m_beta is
+    // left unchanged until the coordinator sends the new global value
+    // If shrink is false, each pass updates all variables, as in solve_vanilla()
+    inline Vector solve_local(Index n_epochs, Scalar sigma, Scalar tol, bool shrink = true)
+    {
+        internal::LocalBeta<Scalar> beta;
+        beta.vec = m_beta;
+        beta.sigma = sigma;
+
+        reset_fv_sets();
+        Scalar* pg = m_local_pg;
+        for (Index i = 0; i < n_epochs; i++)
+        {
+            if (!shrink)
+                std::fill(pg, pg + 6, Scalar(0));
+            update_xi_beta(m_fv_feas, pg[0], pg[1], beta);
+            if (m_fused)
+            {
+                update_LH_beta_fused(m_fv_sample, pg[2], pg[3], pg[4], pg[5], beta);
+            } else {
+                update_Lambda_beta(m_fv_relu, pg[2], pg[3], beta);
+                update_Gamma_beta(m_fv_rehu, pg[4], pg[5], beta);
+            }
+
+            // If the PG of the free variables converges, use all variables in the next pass
+            bool pg_conv = true;
+            for (int j = 0; j < 6; j += 2)
+                pg_conv = pg_conv && (pg[j + 1] - pg[j] < tol) &&
+                          (std::abs(pg[j]) < tol) && (std::abs(pg[j + 1]) < tol);
+            if (pg_conv && !all_fv_sets())
+            {
+                reset_fv_sets();
+                std::fill(pg, pg + 6, Scalar(0));
+            }
+        }
+
+        return (beta.vec - m_beta) / sigma;
+    }
+
+    // Objective function values used by the distributed solver
+    // At the global beta, the primal objective function is 0.5 * ||beta||^2 plus the
+    // sum of loss_objfn() over the blocks, and the dual objective function is
+    // 0.5 * ||sum of local_primal()||^2 plus the sum of dual_objfn_sep()
+    inline Scalar get_loss_objfn() const { return loss_objfn(); }
+    inline Scalar get_dual_objfn_sep() const { return dual_objfn_sep(); }
+    inline Vector local_primal() const
+    {
+        Vector w;
+        compute_primal(w);
+        return w;
+    }
+
+    Vector& get_beta_ref() { return m_beta; }
+    Vector& get_xi_ref() { return m_xi; }
+    DualMatrix& get_Lambda_ref() { return m_Lambda; }
+    DualMatrix& get_Gamma_ref() { return m_Gamma; }
+};
+
+namespace internal {
+
+// Set the options of a ReHLineSolver, run the solver, and save the result
+template <typename Solver, typename Result, typename Index, typename Scalar>
+void run_solver(
+    Solver& solver, Result& result, Index max_iter, Scalar tol, Index shrink,
+    Index verbose, Index trace_freq, bool fused, Index n_threads, bool sync, Index block_size,
+    const Eigen::Matrix<Scalar, Eigen::Dynamic, 1>& l1_pen, std::ostream& cout, bool warm_start,
+    bool screening
+)
+{
+    solver.set_fused(fused);
+    solver.set_screening(screening);
+    solver.set_l1_pen(l1_pen);
+    solver.set_threads(n_threads);
+    solver.set_sync(sync);
+    solver.set_block_size(block_size);
+
+    // Initialize parameters, warm-started from the variables given in result
+    solver.init_params();
+    if (warm_start)
+        solver.warm_start(result.beta, result.xi, result.Lambda, result.Gamma);
+
+    // Main iterations
+    std::vector<Scalar> dual_objfns;
+    std::vector<Scalar> primal_objfns;
+    Index niter;
+    if (shrink > 0)
+    {
+        solver.set_seed(shrink);
+        niter = solver.solve(dual_objfns, primal_objfns, max_iter, tol, verbose, trace_freq, cout);
+    } else {
+        niter = solver.solve_vanilla(dual_objfns, primal_objfns, max_iter, tol, verbose, trace_freq, cout);
+    }
+
+    // Save result
+    result.beta.swap(solver.get_beta_ref());
+    result.xi.swap(solver.get_xi_ref());
+    result.Lambda = solver.get_Lambda_ref();
+    result.Gamma = solver.get_Gamma_ref();
+    result.niter = niter;
+    result.dual_objfns.swap(dual_objfns);
+    result.primal_objfns.swap(primal_objfns);
+}
+
+}  // namespace internal
+
+// Main solver interface
+// template <typename Matrix = Eigen::MatrixXd, typename Index = int>
+// X can be a dense matrix or a sparse matrix, and the other matrices are dense
+// U, V, S, T, and Tau are dense matrices of the same type, or internal::ParamMatrix
+// objects in the compressed form
+// The storage policy of X can be given as the first template argument,
+// e.g., rehline_solver<StoreQuantized<float>>(...)
+template <typename Storage = StoreAsIs,
+          typename DerivedX, typename DerivedMat, typename DerivedVec, typename Param, typename Index = int>
+void rehline_solver(
+    ReHLineResult<typename DerivedMat::PlainObject, Index>& result,
+    const Eigen::EigenBase<DerivedX>& X, const Eigen::MatrixBase<DerivedMat>& A,
+    const Eigen::MatrixBase<DerivedVec>& b,
+    const Param& U, const Param& V, const Param& S, const Param& T, const Param& Tau,
+    Index max_iter, typename DerivedMat::Scalar tol, Index shrink = 1,
+    Index verbose = 0, Index trace_freq = 100, bool fused = false, Index n_threads = 1,
+    bool sync = false, Index block_size = 0,
+    const Eigen::Matrix<typename DerivedMat::Scalar, Eigen::Dynamic, 1>& l1_pen =
+        Eigen::Matrix<typename DerivedMat::Scalar, Eigen::Dynamic, 1>(),
+    std::ostream& cout = std::cout, bool warm_start = false,
+    bool screening = true
+)
+{
+    // Create solver
+    ReHLineSolver<typename DerivedX::PlainObject, Index, Storage> solver(X.derived(), U, V, S, T, Tau, A, b);
+    internal::run_solver(solver, result, max_iter, tol, shrink, verbose, trace_freq,
+                         fused, n_threads, sync, block_size, l1_pen, cout, warm_start, screening);
+}
+
+// Solver interface for multi-quantile regression with n_rep quantiles
+// The design is [X, e_1; ...; X, e_{n_rep}] (see internal::ReplicatedMatrix),
+// which is never formed, and U, V, S, T, Tau are [L x (n * n_rep)] or [H x (n * n_rep)],
+// with the columns of the l-th quantile in l * n, ..., (l + 1) * n - 1
+// beta is (slope [d], intercepts [n_rep]), and A is [K x (d + n_rep)]
+template <typename DerivedX, typename DerivedMat, typename DerivedVec, typename Param, typename Index = int>
+void rehline_solver_replicated(
+    ReHLineResult<typename DerivedMat::PlainObject, Index>& result,
+    const Eigen::EigenBase<DerivedX>& X, Index n_rep, const Eigen::MatrixBase<DerivedMat>& A,
+    const Eigen::MatrixBase<DerivedVec>& b,
+    const Param& U, const Param& V, const Param& S, const Param& T, const Param& Tau,
+    Index max_iter, typename DerivedMat::Scalar tol, Index shrink = 1,
+    Index verbose = 0, Index trace_freq = 100, bool fused = false, Index n_threads = 1,
+    bool sync = false, Index block_size = 0,
+    const Eigen::Matrix<typename DerivedMat::Scalar, Eigen::Dynamic, 1>& l1_pen =
+        Eigen::Matrix<typename DerivedMat::Scalar, Eigen::Dynamic, 1>(),
+    std::ostream& cout = std::cout, bool warm_start = false,
+    bool screening = true
+)
+{
+    using XMatrix = typename DerivedX::PlainObject;
+    const internal::ReplicatedMatrix<Eigen::Ref<const XMatrix>> Xrep(X.derived(), n_rep);
+    ReHLineSolver<XMatrix, Index, StoreReplicated> solver(Xrep, U, V, S, T, Tau, A, b);
+    internal::run_solver(solver, result, max_iter, tol, shrink, verbose, trace_freq,
+                         fused, n_threads, sync, block_size, l1_pen, cout, warm_start, screening);
+}
+
+// Solver interface for a dense X given as a view of any memory layout (see StoreView),
+// e.g., Eigen::Map<const ColMajorMatrix, 0, Eigen::OuterStride<>> for a column-majored
+// array, which is referenced in place; its rows are then read with a stride
+// The other matrices and the dual variables have the type of A
+template <typename XView, typename DerivedMat, typename DerivedVec, typename Param, typename Index = int>
+void rehline_solver_view(
+    ReHLineResult<typename DerivedMat::PlainObject, Index>& result,
+    const XView& X, const Eigen::MatrixBase<DerivedMat>& A,
+    const Eigen::MatrixBase<DerivedVec>& b,
+    const Param& U, const Param& V, const Param& S, const Param& T, const Param& Tau,
+    Index max_iter, typename DerivedMat::Scalar tol, Index shrink = 1,
+    Index verbose = 0, Index trace_freq = 100, bool fused = false, Index n_threads = 1,
+    bool sync = false, Index block_size = 0,
+    const Eigen::Matrix<typename DerivedMat::Scalar, Eigen::Dynamic, 1>& l1_pen =
+        Eigen::Matrix<typename DerivedMat::Scalar, Eigen::Dynamic, 1>(),
+    std::ostream& cout = std::cout, bool warm_start = false,
+    bool screening = true
+)
+{
+    ReHLineSolver<typename DerivedMat::PlainObject, Index, StoreView<XView>> solver(X, U, V, S, T, Tau, A, b);
+    internal::run_solver(solver, result, max_iter, tol, shrink, verbose, trace_freq,
+                         fused, n_threads, sync, block_size, l1_pen, cout, warm_start, screening);
+}
+
+// Solver interface for a regularization path, the problems whose loss parameters are
+// c * U, c * V, sqrt(c) * S, sqrt(c) * T, and sqrt(c) * Tau for each c in scales, which
+// is how the losses of ReHLine depend on C (U, ..., Tau are those of a reference C)
+// One solver is shared by the path: X, the norms of its rows, and the buffers of the
+// scaled parameters are set up once, and the buffers are rescaled in place for each c
+// Each problem after the first is warm-started from the previous solution, with
+// Lambda kept, Gamma scaled by sqrt(c / c_prev) but kept at tau_hi if it was at the
+// bound, and xi scaled by c / c_prev, which keeps the coordinates at their bounds; with
+// shrinking, these coordinates start out of the free variable sets
+// (see ReHLineSolver::set_screen_bounds()), so a fine path from small to large c
+// mostly works on the samples near the margin
+// The values in scales must be positive, and results[k] is the result of scales[k]
+template <typename DerivedX, typename DerivedMat, typename DerivedVec, typename Param, typename Index = int>
+void rehline_solver_path(
+    std::vector<ReHLineResult<typename DerivedMat::PlainObject, Index>>& results,
+    const Eigen::EigenBase<DerivedX>& X, const Eigen::MatrixBase<DerivedMat>& A,
+    const Eigen::MatrixBase<DerivedVec>& b,
+    const Param& U, const Param& V, const Param& S, const Param& T, const Param& Tau,
+    const std::vector<typename DerivedMat::Scalar>& scales,
+    Index max_iter, typename DerivedMat::Scalar tol, Index shrink = 1,
+    Index verbose = 0, Index trace_freq = 100, bool fused = false, Index n_threads = 1,
+    std::ostream& cout = std::cout
+)
+{
+    using Scalar = typename DerivedMat::Scalar;
+    using XMatrix = typename DerivedX::PlainObject;
+    using DenseMatrix = typename internal::MatrixTraits<XMatrix>::DenseMatrix;
+    using ParamMat = internal::ParamMatrix<DenseMatrix>;
+    using Result = ReHLineResult<typename DerivedMat::PlainObject, Index>;
+
+    for (std::size_t k = 0; k < scales.size(); k++)
+    {
+        if (!(scales[k] > Scalar(0)))
+            throw std::invalid_argument("the scales of the path must be positive");
+    }
+    results.resize(scales.size());
+    if (scales.empty())
+        return;
+
+    // Reference parameters, and the buffers of the scaled ones referenced by the solver
+    const ParamMat U0(U), V0(V), S0(S), T0(T), Tau0(Tau);
+    const Index n = Index(X.rows()), L = Index(U0.rows()), H = Index(S0.rows());
+    DenseMatrix Uc(L, n), Vc(L, n), Sc(H, n), Tc(H, n), Tauc(H, n);
+    auto scale_params = [&](Scalar c) {
+        const Scalar sc = std::sqrt(c);
+        for (Index l = 0; l < L; l++)
+        {
+            Uc.row(l).noalias() = c * U0.row(l).transpose();
+            Vc.row(l).noalias() = c * V0.row(l).transpose();
+        }
+        for (Index h = 0; h < H; h++)
+        {
+            Sc.row(h).noalias() = sc * S0.row(h).transpose();
+            Tc.row(h).noalias() = sc * T0.row(h).transpose();
+            Tauc.row(h).noalias() = sc * Tau0.row(h).transpose();
+        }
+    };
+
+    // The dead coordinates are counted by the constructor, and do not change with c
+    scale_params(scales[0]);
+    ReHLineSolver<XMatrix, Index> solver(X.derived(), ParamMat(Uc), ParamMat(Vc),
+                                         ParamMat(Sc), ParamMat(Tc), ParamMat(Tauc), A, b);
+    solver.set_fused(fused);
+    solver.set_threads(n_threads);
+
+    for (std::size_t k = 0; k < scales.size(); k++)
+    {
+        const Scalar c = scales[k];
+        if (k > 0)
+            scale_params(c);
+        solver.init_params();
+
+        if (k > 0)
+        {
+            const Result& prev = results[k - 1];
+            const Scalar c_prev = scales[k - 1];
+            const Scalar ratio = c / c_prev, sc_prev = std::sqrt(c_prev);
+            const Scalar sratio = std::sqrt(c) / sc_prev;
+            typename Result::Vector xi = ratio * prev.xi;
+            typename DerivedMat::PlainObject Gamma = prev.Gamma;
+            for (Index h = 0; h < H; h++)
+            {
+                for (Index i = 0; i < n; i++)
+                {
+                    // The same product as the buffer of the previous c
+                    const bool at_tau = (prev.Gamma(h, i) == sc_prev * Tau0(h, i));
+                    Gamma(h, i) = at_tau ? Tauc(h, i) : sratio * prev.Gamma(h, i);
+                }
+            }
+            solver.warm_start(prev.beta, xi, prev.Lambda, Gamma);
+            solver.set_screen_bounds(shrink > 0);
+        }
+
+        std::vector<Scalar> dual_objfns;
+        std::vector<Scalar> primal_objfns;
+        Index niter;
+        if (shrink > 0)
+        {
+            solver.set_seed(shrink);
+            niter = solver.solve(dual_objfns, primal_objfns, max_iter, tol, verbose, trace_freq, cout);
+        } else {
+            niter = solver.solve_vanilla(dual_objfns, primal_objfns, max_iter, tol, verbose, trace_freq, cout);
+        }
+
+        // The variables stay in the solver for the next warm start
+        Result& result = results[k];
+        result.beta = solver.get_beta_ref();
+        result.xi = solver.get_xi_ref();
+        result.Lambda = solver.get_Lambda_ref();
+        result.Gamma = solver.get_Gamma_ref();
+        result.niter = niter;
+        result.dual_objfns.swap(dual_objfns);
+        result.primal_objfns.swap(primal_objfns);
+    }
+}
+
+
+// Solver of B problems that share X, A, and b, and differ in the loss parameters,
+// e.g., a grid of C values or the one-vs-rest problems of a multiclass classification
+// The problems are solved together in B lanes: each row x[i] is loaded once per
+// sample for all lanes, the B margins are x[i]' * Beta with Beta stored as [d x B],
+// and the changes of the B betas form one rank-one update Beta += x[i] * delta'
+// The coordinate updates of each lane are those of the fused updates in ReHLineSolver
+// (see internal::lambda_step() and internal::gamma_step()), and all lanes visit the
+// samples in the same cyclic order as ReHLineSolver::solve_vanilla()
+// A lane is no longer updated once it has converged
+// The loss parameters have the same L and H in all lanes, and are stored together
+// with the dual variables in the lane-major order, i.e., the (B * L) or (B * H) values
+// of sample i are contiguous, so that a sample is read from one place for all lanes
+template <typename Matrix = Eigen::MatrixXd, typename Index = int>
+class ReHLineLaneSolver
+{
+private:
+    using Scalar = typename Matrix::Scalar;
+    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+    using DenseMatrix = typename internal::MatrixTraits<Matrix>::DenseMatrix;
+    using ConstRefMat = Eigen::Ref<const DenseMatrix>;
+    using ConstRefVec = Eigen::Ref<const Vector>;
+    using ParamMat = internal::ParamMatrix<DenseMatrix>;
+    // Matrices of the lanes, with the values of a feature, constraint, or sample contiguous
+    using LaneMatrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    using LaneVector = Eigen::Matrix<Scalar, 1, Eigen::Dynamic>;
+
+    template <typename Mat>
+    using RowMajorType = typename std::conditional<
+        Mat::IsRowMajor,
+        Eigen::Ref<const Mat>,
+        typename internal::MatrixTraits<Mat>::RowMajorMatrix
+    >::type;
+    using RMatrix = RowMajorType<Matrix>;
+    using RDenseMatrix = RowMajorType<DenseMatrix>;
 
-        // Compute shrinking thresholds lb and ub
-        // More details explained in update_xi_beta()
-        constexpr Scalar Inf = std::numeric_limits<Scalar>::infinity();
-        const Scalar lb = (min_pg < Scalar(0)) ? min_pg : -Inf;
-        const Scalar ub = (max_pg > Scalar(0)) ? max_pg : Inf;
-        // Compute minimum and maximum projected gradient (PG) for this round
-        min_pg = Inf;
-        max_pg = -Inf;
-        for (auto rc: fv_set)
-        {
-            const Index h = rc.first;
-            const Index i = rc.second;
+    // Dimensions
+    const Index m_n;
+    const Index m_d;
+    const Index m_L;
+    const Index m_H;
+    const Index m_K;
+    const Index m_B;
 
-            // tau_hi can be Inf
-            const Scalar tau_hi = m_Tau(h, i);
-            const Scalar gamma_hi = m_Gamma(h, i);
-            const Scalar s_hi = m_S(h, i);
-            const Scalar t_hi = m_T(h, i);
+    // Input matrices and vectors
+    RMatrix      m_X;
+    RDenseMatrix m_A;
+    ConstRefVec  m_b;
+
+    // Loss parameters [n x (B * L)] or [n x (B * H)], where the lane j of
+    // sample i is in the columns j * L, ..., (j + 1) * L - 1
+    LaneMatrix m_U;
+    LaneMatrix m_V;
+    LaneMatrix m_S;
+    LaneMatrix m_T;
+    LaneMatrix m_Tau;
 
-            // Compute g_hi
-            const Scalar g_hi = gamma_hi - (s_hi * m_X.row(i).dot(m_beta) + t_hi);
-            // PG and shrink
-            Scalar pg;
-            const bool shrink = pg_gamma(gamma_hi, g_hi, tau_hi, lb, ub, pg);
-            if (shrink)
-                continue;
+    // Pre-computed
+    Vector m_xi2;        // ||x[i]||^2
+    Vector m_gk_denom;   // ||a[k]||^2
 
-            // Update PG bounds
-            max_pg = std::max(max_pg, pg);
-            min_pg = std::min(min_pg, pg);
-            // Compute new gamma_hi
-            const Scalar candid = gamma_hi - g_hi / m_ghi_denom(h, i);
-            const Scalar newg = std::max(Scalar(0), std::min(tau_hi, candid));
-            // Update Gamma and beta
-            m_Gamma(h, i) = newg;
-            m_beta.noalias() -= (newg - gamma_hi) * s_hi * m_X.row(i).transpose();
+    // Primal variables [d x B], and dual variables xi [K x B], Lambda [n x (B * L)],
+    // and Gamma [n x (B * H)]
+    LaneMatrix m_beta;
+    LaneMatrix m_xi;
+    LaneMatrix m_Lambda;
+    LaneMatrix m_Gamma;
 
-            // Add to new free variable set
-            new_set.emplace_back(h, i);
-        }
+    // Whether each lane is still updated
+    std::vector<char> m_active;
 
-        // Update free variable set
-        fv_set.swap(new_set);
+    // Copy the parameters of each lane in the lane-major order
+    static LaneMatrix pack_params(const std::vector<ParamMat>& P, Index n, Index rows)
+    {
+        LaneMatrix res(n, Index(P.size()) * rows);
+        for (Index j = 0; j < Index(P.size()); j++)
+        {
+            if (P[j].rows() != rows || (rows > 0 && P[j].cols() != n))
+                throw std::invalid_argument("the loss parameters must have the same L and H in all lanes");
+            for (Index l = 0; l < rows; l++)
+                res.col(j * rows + l).noalias() = P[j].row(l);
+        }
+        return res;
     }
 
-public:
-    ReHLineSolver(ConstRefMat X, ConstRefMat U, ConstRefMat V,
-                  ConstRefMat S, ConstRefMat T, ConstRefMat Tau,
-                  ConstRefMat A, ConstRefVec b) :
-        m_n(X.rows()), m_d(X.cols()), m_L(U.rows()), m_H(S.rows()), m_K(A.rows()),
-        m_X(X), m_U(U), m_V(V), m_S(S), m_T(T), m_Tau(Tau), m_A(A), m_b(b),
-        m_gk_denom(m_K), m_gli_denom(m_L, m_n), m_ghi_denom(m_H, m_n),
-        m_beta(m_d),
-        m_xi(m_K), m_Lambda(m_L, m_n), m_Gamma(m_H, m_n)
+    // Update xi and Beta of the active lanes
+    inline void update_xi_beta()
     {
-        // A [K x d], K can be zero
-        if (m_K > 0)
-            m_gk_denom.noalias() = m_A.rowwise().squaredNorm();
-
-        Vector xi2 = m_X.rowwise().squaredNorm();
-        if (m_L > 0)
+        for (Index k = 0; k < m_K; k++)
         {
-            m_gli_denom.array() = m_U.array().square().rowwise() * xi2.transpose().array();
+            // g_k of all lanes
+            const LaneVector g = m_A.row(k) * m_beta + LaneVector::Constant(m_B, m_b[k]);
+            LaneVector dxi = LaneVector::Zero(m_B);
+            for (Index j = 0; j < m_B; j++)
+            {
+                if (!m_active[j])
+                    continue;
+                const Scalar newxi = std::max(Scalar(0), m_xi(k, j) - g[j] / m_gk_denom[k]);
+                dxi[j] = newxi - m_xi(k, j);
+                m_xi(k, j) = newxi;
+            }
+            m_beta.noalias() += m_A.row(k).transpose() * dxi;
         }
+    }
 
-        if (m_H > 0)
+    // Update Lambda, Gamma, and Beta of the active lanes, one sample at a time
+    inline void update_LH_beta()
+    {
+        LaneVector xb(m_B), delta(m_B);
+        for (Index i = 0; i < m_n; i++)
         {
-            m_ghi_denom.array() = m_S.array().square().rowwise() * xi2.transpose().array() + Scalar(1);
+            const Scalar xi2 = m_xi2[i];
+            if (xi2 == Scalar(0))
+                continue;
+            // Margins x[i]' * Beta of all lanes
+            internal::row_gemv(m_X, i, m_beta, xb);
+            delta.setZero();
+            bool changed = false;
+
+            const Scalar* u = m_U.row(i).data();
+            const Scalar* v = m_V.row(i).data();
+            const Scalar* s = m_S.row(i).data();
+            const Scalar* t = m_T.row(i).data();
+            const Scalar* tau = m_Tau.row(i).data();
+            Scalar* lambda = m_Lambda.row(i).data();
+            Scalar* gamma = m_Gamma.row(i).data();
+            for (Index j = 0; j < m_B; j++)
+            {
+                if (!m_active[j])
+                    continue;
+                Scalar xbj = xb[j], dj = Scalar(0);
+                for (Index l = j * m_L; l < (j + 1) * m_L; l++)
+                {
+                    // Dead coordinates are skipped, see ReHLineSolver::lambda_dead()
+                    const Scalar denom = u[l] * u[l] * xi2;
+                    if (denom == Scalar(0))
+                        continue;
+                    const Scalar newl = internal::lambda_step(lambda[l], u[l], v[l], xbj, denom);
+                    const Scalar dl = (newl - lambda[l]) * u[l];
+                    lambda[l] = newl;
+                    dj -= dl;
+                    xbj -= dl * xi2;
+                }
+                for (Index h = j * m_H; h < (j + 1) * m_H; h++)
+                {
+                    const Scalar denom = s[h] * s[h] * xi2;
+                    if (denom == Scalar(0))
+                        continue;
+                    const Scalar newg = internal::gamma_step(gamma[h], s[h], t[h], tau[h], xbj, denom + Scalar(1));
+                    const Scalar dg = (newg - gamma[h]) * s[h];
+                    gamma[h] = newg;
+                    dj -= dg;
+                    xbj -= dg * xi2;
+                }
+                delta[j] = dj;
+                changed = changed || (dj != Scalar(0));
+            }
+            // Rank-one update of Beta
+            if (changed)
+                internal::row_ger(m_X, i, delta, m_beta);
         }
     }
 
-    // Initialize primal and dual variables
+public:
+    ReHLineLaneSolver(const RMatrix& X, const std::vector<ParamMat>& U, const std::vector<ParamMat>& V,
+                      const std::vector<ParamMat>& S, const std::vector<ParamMat>& T,
+                      const std::vector<ParamMat>& Tau, ConstRefMat A, ConstRefVec b) :
+        m_n(X.rows()), m_d(X.cols()),
+        m_L(U.empty() ? 0 : U[0].rows()), m_H(S.empty() ? 0 : S[0].rows()), m_K(A.rows()),
+        m_B(Index(U.size())),
+        m_X(X), m_A(A), m_b(b),
+        m_xi2(m_n), m_gk_denom(m_K),
+        m_beta(m_d, m_B), m_xi(m_K, m_B), m_Lambda(m_n, m_B * m_L), m_Gamma(m_n, m_B * m_H),
+        m_active(m_B, 1)
+    {
+        if (V.size() != U.size() || S.size() != U.size() || T.size() != U.size() || Tau.size() != U.size())
+            throw std::invalid_argument("U, V, S, T, and Tau must be given for each lane");
+        m_U = pack_params(U, m_n, m_L);
+        m_V = pack_params(V, m_n, m_L);
+        m_S = pack_params(S, m_n, m_H);
+        m_T = pack_params(T, m_n, m_H);
+        m_Tau = pack_params(Tau, m_n, m_H);
+
+        if (m_K > 0)
+            m_gk_denom.noalias() = m_A.rowwise().squaredNorm();
+        m_xi2.noalias() = internal::row_squared_norms(m_X);
+    }
+
+    // Initialize primal and dual variables as in ReHLineSolver::init_params(),
+    // with the dead coordinates fixed at the optimum (see ReHLineSolver::fix_dead_duals())
     inline void init_params()
     {
-        // xi >= 0, initialized to be 1
         if (m_K > 0)
             m_xi.fill(Scalar(1));
+        std::fill(m_active.begin(), m_active.end(), 1);
 
-        // Each element of Lambda satisfies 0 <= lambda_li <= 1,
-        // and we use 0.5 to initialize Lambda
-        if (m_L > 0)
-            m_Lambda.fill(Scalar(0.5));
-
-        // Each element of Gamma satisfies 0 <= gamma_hi <= tau_hi,
-        // and we use min(0.5 * tau_hi, 1) to initialize (tau_hi can be Inf)
-        if (m_H > 0)
+        // The coefficients of x[i] in -beta of each lane
+        LaneMatrix LHterm = LaneMatrix::Zero(m_n, m_B);
+        for (Index i = 0; i < m_n; i++)
         {
-            m_Gamma.noalias() = (Scalar(0.5) * m_Tau).cwiseMin(Scalar(1));
-            // Gamma.fill(std::min(1.0, 0.5 * tau));
+            const Scalar xi2 = m_xi2[i];
+            for (Index j = 0; j < m_B; j++)
+            {
+                for (Index l = j * m_L; l < (j + 1) * m_L; l++)
+                {
+                    const Scalar u_li = m_U(i, l);
+                    m_Lambda(i, l) = (u_li * u_li * xi2 != Scalar(0)) ? Scalar(0.5) :
+                                     (m_V(i, l) > Scalar(0) ? Scalar(1) : Scalar(0));
+                    LHterm(i, j) += u_li * m_Lambda(i, l);
+                }
+                for (Index h = j * m_H; h < (j + 1) * m_H; h++)
+                {
+                    const Scalar s_hi = m_S(i, h), tau_hi = m_Tau(i, h);
+                    m_Gamma(i, h) = (s_hi * s_hi * xi2 != Scalar(0)) ? std::min(Scalar(0.5) * tau_hi, Scalar(1)) :
+                                    std::max(Scalar(0), std::min(tau_hi, m_T(i, h)));
+                    LHterm(i, j) += s_hi * m_Gamma(i, h);
+                }
+            }
         }
 
-        // Set primal variable based on duals
-        set_primal();
+        // Beta = A'xi - X' * LHterm
+        for (Index j = 0; j < m_B; j++)
+            m_beta.col(j).noalias() = -internal::mat_tvec(m_X, LHterm.col(j));
+        if (m_K > 0)
+            m_beta.noalias() += m_A.transpose() * m_xi;
     }
 
-    inline void set_seed(Index seed) { m_rng.seed(seed); }
-
-    inline Index solve_vanilla(
-        std::vector<Scalar>& dual_objfns, std::vector<Scalar>& primal_objfns,
-        Index max_iter, Scalar tol,
-        Index verbose = 0, Index trace_freq = 100,
-        std::ostream& cout = std::cout)
+    // Run the cyclic updates until all lanes converge, and return the number of
+    // iterations of each lane in niter
+    inline void solve(std::vector<Index>& niter, Index max_iter, Scalar tol,
+                      Index verbose = 0, Index trace_freq = 100, std::ostream& cout = std::cout)
     {
-        // Main iterations
-        Index i = 0;
-        Vector old_xi(m_K), old_beta(m_d);
-        for(; i < max_iter; i++)
+        niter.assign(m_B, max_iter);
+        LaneMatrix old_xi, old_beta;
+        Index n_active = m_B;
+        for (Index i = 0; i < max_iter && n_active > 0; i++)
         {
             old_xi.noalias() = m_xi;
             old_beta.noalias() = m_beta;
 
             update_xi_beta();
-            update_Lambda_beta();
-            update_Gamma_beta();
+            update_LH_beta();
 
-            // Compute difference of xi and beta
-            const Scalar xi_diff = (m_K > 0) ? (m_xi - old_xi).norm() : Scalar(0);
-            const Scalar beta_diff = (m_beta - old_beta).norm();
+            // Convergence test of each lane based on change of variable values
+            Scalar max_beta_diff = Scalar(0);
+            for (Index j = 0; j < m_B; j++)
+            {
+                if (!m_active[j])
+                    continue;
+                const Scalar xi_diff = (m_K > 0) ? (m_xi.col(j) - old_xi.col(j)).norm() : Scalar(0);
+                const Scalar beta_diff = (m_beta.col(j) - old_beta.col(j)).norm();
+                max_beta_diff = std::max(max_beta_diff, beta_diff);
+                if (xi_diff < tol && beta_diff < tol)
+                {
+                    m_active[j] = 0;
+                    niter[j] = i;
+                    n_active--;
+                }
+            }
 
             // Print progress
             if (verbose && (i % trace_freq == 0))
             {
-                Scalar dual = dual_objfn();
-                dual_objfns.push_back(dual);
-                Scalar primal = primal_objfn();
-                primal_objfns.push_back(primal);
-                cout << "Iter " << i << ", dual_objfn = " << dual <<
-                    ", primal_objfn = " << primal <<
-                    ", xi_diff = " << xi_diff <<
-                    ", beta_diff = " << beta_diff << std::endl;
+                cout << "Iter " << i << ", active lanes = " << n_active <<
+                    ", max beta_diff = " << max_beta_diff << std::endl;
             }
-
-            // Convergence test based on change of variable values
-            const bool vars_conv = (xi_diff < tol) && (beta_diff < tol);
-            if (vars_conv)
-                break;
         }
+    }
 
-        return i;
+    // beta and xi of lane j
+    Vector get_beta(Index j) const { return m_beta.col(j); }
+    Vector get_xi(Index j) const { return m_xi.col(j); }
+    // Lambda [L x n] and Gamma [H x n] of lane j
+    DenseMatrix get_Lambda(Index j) const { return m_Lambda.middleCols(j * m_L, m_L).transpose(); }
+    DenseMatrix get_Gamma(Index j) const { return m_Gamma.middleCols(j * m_H, m_H).transpose(); }
+};
+
+// Solver interface for B problems sharing X, A, and b (see ReHLineLaneSolver)
+// U, V, S, T, and Tau have one element per problem, and results[j] is the
+// result of the j-th problem, whose objective function values are not recorded
+template <typename DerivedX, typename DerivedMat, typename DerivedVec, typename Param, typename Index = int>
+void rehline_solver_lanes(
+    std::vector<ReHLineResult<typename DerivedMat::PlainObject, Index>>& results,
+    const Eigen::EigenBase<DerivedX>& X, const Eigen::MatrixBase<DerivedMat>& A,
+    const Eigen::MatrixBase<DerivedVec>& b,
+    const std::vector<Param>& U, const std::vector<Param>& V, const std::vector<Param>& S,
+    const std::vector<Param>& T, const std::vector<Param>& Tau,
+    Index max_iter, typename DerivedMat::Scalar tol,
+    Index verbose = 0, Index trace_freq = 100, std::ostream& cout = std::cout
+)
+{
+    using XMatrix = typename DerivedX::PlainObject;
+    using ParamMat = internal::ParamMatrix<typename internal::MatrixTraits<XMatrix>::DenseMatrix>;
+    const std::vector<ParamMat> Up(U.begin(), U.end()), Vp(V.begin(), V.end()), Sp(S.begin(), S.end()),
+                                Tp(T.begin(), T.end()), Taup(Tau.begin(), Tau.end());
+    ReHLineLaneSolver<XMatrix, Index> solver(X.derived(), Up, Vp, Sp, Tp, Taup, A, b);
+    solver.init_params();
+    std::vector<Index> niter;
+    solver.solve(niter, max_iter, tol, verbose, trace_freq, cout);
+
+    const Index B = Index(U.size());
+    results.resize(B);
+    for (Index j = 0; j < B; j++)
+    {
+        results[j].beta = solver.get_beta(j);
+        results[j].xi = solver.get_xi(j);
+        results[j].Lambda = solver.get_Lambda(j);
+        results[j].Gamma = solver.get_Gamma(j);
+        results[j].niter = niter[j];
+        results[j].dual_objfns.clear();
+        results[j].primal_objfns.clear();
+    }
+}
+
+
+// Streaming ReHLine solver for data larger than the memory
+// X is read from a binary file (see internal::RowBlockReader) in blocks of
+// block_rows rows. While the coordinate descent runs on the resident block,
+// a background thread reads the next block into a second buffer.
+// U, V, S, T, Tau, the dual variables, and beta are kept in memory, whose sizes
+// are O((L + H) * n + d) instead of the O(n * d) of X
+// Each resident block is updated by n_epochs passes of the free-set updates in
+// ReHLineSolver (restricted to the rows of the block), and the constraints are
+// updated once per sweep over all blocks
+// The squared row norms of X are computed in the first sweep in init_params(), and
+// are reused by the block solvers in all sweeps
+template <typename Scalar = double, typename Index = int>
+class ReHLineStreamSolver
+{
+private:
+    using Matrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+    using ConstRefMat = Eigen::Ref<const Matrix>;
+    using ConstRefVec = Eigen::Ref<const Vector>;
+    using ParamMat = internal::ParamMatrix<Matrix>;
+    using BlockSolver = ReHLineSolver<Matrix, Index>;
+
+    internal::RowBlockReader<Scalar>& m_reader;
+    internal::SimpleRNG<Index> m_rng;
+
+    const Index m_n;
+    const Index m_d;
+    const Index m_L;
+    const Index m_H;
+    const Index m_K;
+    const Index m_block_rows;
+
+    ParamMat m_U;
+    ParamMat m_V;
+    ParamMat m_S;
+    ParamMat m_T;
+    ParamMat m_Tau;
+
+    // Solver of the constraint block, with an empty X
+    Matrix m_X0;
+    Matrix m_E0;
+    Vector m_b0;
+    BlockSolver m_constr;
+
+    Vector m_beta;
+    Matrix m_Lambda;
+    Matrix m_Gamma;
+
+    // ||x[i]||^2
+    Vector m_xi2;
+    // Whether the free variable sets of the block solvers are shrunk
+    bool m_shrink;
+
+    // Sub-matrix of the columns [begin, begin + nb) of an L x n or H x n matrix
+    static ParamMat cols(const ParamMat& M, Index begin, Index nb)
+    {
+        return M.middle_cols(begin, nb);
+    }
+
+public:
+    ReHLineStreamSolver(internal::RowBlockReader<Scalar>& reader, Index block_rows,
+                        const ParamMat& U, const ParamMat& V,
+                        const ParamMat& S, const ParamMat& T, const ParamMat& Tau,
+                        ConstRefMat A, ConstRefVec b) :
+        m_reader(reader),
+        m_n(reader.rows()), m_d(reader.cols()), m_L(U.rows()), m_H(S.rows()), m_K(A.rows()),
+        m_block_rows(std::max(Index(1), block_rows)),
+        m_U(U), m_V(V), m_S(S), m_T(T), m_Tau(Tau),
+        m_X0(0, m_d), m_E0(0, 0), m_b0(0),
+        m_constr(m_X0, m_E0, m_E0, m_E0, m_E0, m_E0, A, b),
+        m_beta(m_d), m_Lambda(m_L, m_n), m_Gamma(m_H, m_n), m_xi2(m_n), m_shrink(true)
+    {}
+
+    inline void set_seed(Index seed)
+    {
+        m_rng.seed(seed);
+        m_constr.set_seed(seed);
+    }
+
+    inline void set_shrink(bool shrink) { m_shrink = shrink; }
+
+    // Same initial values as ReHLineSolver::init_params(), where beta and the
+    // row norms are computed in one sweep over the data
+    inline void init_params()
+    {
+        m_constr.init_params();
+        if (m_L > 0)
+            m_Lambda.fill(Scalar(0.5));
+        for (Index h = 0; h < m_H; h++)
+            m_Gamma.row(h).noalias() = (Scalar(0.5) * m_Tau.row(h)).cwiseMin(Scalar(1)).transpose();
+
+        m_beta.noalias() = m_constr.get_beta_ref();
+        Matrix buf;
+        for (Index begin = 0; begin < m_n; begin += m_block_rows)
+        {
+            const Index nb = std::min(m_block_rows, m_n - begin);
+            m_reader.read(begin, nb, buf);
+            m_xi2.segment(begin, nb).noalias() = internal::row_squared_norms(buf);
+            Vector LHterm = Vector::Zero(nb);
+            if (m_L > 0)
+                LHterm.noalias() = cols(m_U, begin, nb).colwise_dot(m_Lambda.middleCols(begin, nb));
+            if (m_H > 0)
+                LHterm.noalias() += cols(m_S, begin, nb).colwise_dot(m_Gamma.middleCols(begin, nb));
+            m_beta.noalias() -= buf.transpose() * LHterm;
+        }
     }
 
     inline Index solve(
         std::vector<Scalar>& dual_objfns, std::vector<Scalar>& primal_objfns,
-        Index max_iter, Scalar tol,
+        Index max_iter, Scalar tol, Index n_epochs = 1,
         Index verbose = 0, Index trace_freq = 100,
         std::ostream& cout = std::cout)
     {
-        // Free variable sets
-        internal::reset_fv_set(m_fv_feas, m_K);
-        internal::reset_fv_set(m_fv_relu, m_L, m_n);
-        internal::reset_fv_set(m_fv_rehu, m_H, m_n);
+        const Index n_blocks = (m_n + m_block_rows - 1) / m_block_rows;
+        std::vector<Index> order(n_blocks);
+        std::iota(order.begin(), order.end(), Index(0));
 
-        // Minimum and maximum projected gradients of dual variables in each outer iteration
-        // These variables will be updated in update_*_beta() functions below
-        // If some dual variables are not used, the corresponding pg variables
-        // will always be zero, so that the related tests in pg_conv below return true values
-        Scalar xi_min_pg = Scalar(0), lambda_min_pg = Scalar(0), gamma_min_pg = Scalar(0);
-        Scalar xi_max_pg = Scalar(0), lambda_max_pg = Scalar(0), gamma_max_pg = Scalar(0);
+        // Double buffering: buf[cur] holds the resident block, and the next
+        // block is read into buf[1 - cur] by a background thread
+        Matrix buf[2];
+        int cur = 0;
 
-        // Main iterations
         Index i = 0;
-        Vector old_xi(m_K), old_beta(m_d);
-        for(; i < max_iter; i++)
+        Vector old_beta(m_d);
+        Vector old_xi(m_K);
+        for (; i < max_iter; i++)
         {
-            old_xi.noalias() = m_xi;
             old_beta.noalias() = m_beta;
+            old_xi.noalias() = m_constr.get_xi_ref();
+            const bool trace = verbose && (i % trace_freq == 0);
+            Scalar loss = Scalar(0), dual_sep = m_constr.get_dual_objfn_sep();
 
-            update_xi_beta(m_fv_feas, xi_min_pg, xi_max_pg);
-            update_Lambda_beta(m_fv_relu, lambda_min_pg, lambda_max_pg);
-            update_Gamma_beta(m_fv_rehu, gamma_min_pg, gamma_max_pg);
+            // Constraints
+            if (m_K > 0)
+            {
+                m_constr.get_beta_ref() = m_beta;
+                m_beta.noalias() += m_constr.solve_local(n_epochs, Scalar(1), tol, m_shrink);
+            }
 
-            // Compute difference of xi and beta
-            const Scalar xi_diff = (m_K > 0) ? (m_xi - old_xi).norm() : Scalar(0);
-            const Scalar beta_diff = (m_beta - old_beta).norm();
+            // Visit the blocks in a random order
+            internal::random_shuffle(order.begin(), order.end(), m_rng);
+            const Index first = order[0] * m_block_rows;
+            m_reader.read(first, std::min(m_block_rows, m_n - first), buf[cur]);
+            for (Index k = 0; k < n_blocks; k++)
+            {
+                std::future<void> prefetch;
+                if (k + 1 < n_blocks)
+                {
+                    const Index next = order[k + 1] * m_block_rows;
+                    const Index nb_next = std::min(m_block_rows, m_n - next);
+                    Matrix& next_buf = buf[1 - cur];
+                    prefetch = std::async(std::launch::async, [this, next, nb_next, &next_buf]() {
+                        m_reader.read(next, nb_next, next_buf);
+                    });
+                }
 
-            // Convergence test based on change of variable values
-            const bool vars_conv = (xi_diff < tol) && (beta_diff < tol);
-            // Convergence test based on PG
-            const bool pg_conv = (xi_max_pg - xi_min_pg < tol) &&
-                                 (std::abs(xi_max_pg) < tol) &&
-                                 (std::abs(xi_min_pg) < tol) &&
-                                 (lambda_max_pg - lambda_min_pg < tol) &&
-                                 (std::abs(lambda_max_pg) < tol) &&
-                                 (std::abs(lambda_min_pg) < tol) &&
-                                 (gamma_max_pg - gamma_min_pg < tol) &&
-                                 (std::abs(gamma_max_pg) < tol) &&
-                                 (std::abs(gamma_min_pg) < tol);
-            // Whether we are using all variables
-            const bool all_vars = (m_fv_feas.size() == static_cast<std::size_t>(m_K)) &&
-                                  (m_fv_relu.size() == static_cast<std::size_t>(m_L * m_n)) &&
-                                  (m_fv_rehu.size() == static_cast<std::size_t>(m_H * m_n));
+                const Index begin = order[k] * m_block_rows;
+                const Index nb = Index(buf[cur].rows());
+                const Vector xi2 = m_xi2.segment(begin, nb);
+                BlockSolver block(buf[cur],
+                                  cols(m_U, begin, nb), cols(m_V, begin, nb),
+                                  cols(m_S, begin, nb), cols(m_T, begin, nb), cols(m_Tau, begin, nb),
+                                  m_E0, m_b0, &xi2);
+                block.set_seed(Index(m_rng(std::numeric_limits<Index>::max())));
+                block.get_Lambda_ref() = m_Lambda.middleCols(begin, nb);
+                block.get_Gamma_ref() = m_Gamma.middleCols(begin, nb);
+                block.fix_dead_duals();
+                if (trace)
+                {
+                    // Loss and dual terms at the values in the beginning of this sweep
+                    block.get_beta_ref() = old_beta;
+                    loss += block.get_loss_objfn();
+                    dual_sep += block.get_dual_objfn_sep();
+                }
+                block.get_beta_ref() = m_beta;
+                m_beta.noalias() += block.solve_local(n_epochs, Scalar(1), tol, m_shrink);
+                m_Lambda.middleCols(begin, nb) = block.get_Lambda_ref();
+                m_Gamma.middleCols(begin, nb) = block.get_Gamma_ref();
+
+                if (prefetch.valid())
+                    prefetch.get();
+                cur = 1 - cur;
+            }
 
-            // Print progress
-            if (verbose && (i % trace_freq == 0))
+            const Scalar xi_diff = (m_K > 0) ? (m_constr.get_xi_ref() - old_xi).norm() : Scalar(0);
+            const Scalar beta_diff = (m_beta - old_beta).norm();
+
+            if (trace)
             {
-                Scalar dual = dual_objfn();
+                // beta is kept equal to the primal variable implied by the duals
+                const Scalar dual = Scalar(0.5) * old_beta.squaredNorm() + dual_sep;
+                const Scalar primal = loss + Scalar(0.5) * old_beta.squaredNorm();
                 dual_objfns.push_back(dual);
-                Scalar primal = primal_objfn();
                 primal_objfns.push_back(primal);
                 cout << "Iter " << i << ", dual_objfn = " << dual <<
                     ", primal_objfn = " << primal <<
                     ", xi_diff = " << xi_diff <<
                     ", beta_diff = " << beta_diff << std::endl;
-                if (verbose >= 2)
-                {
-                    cout << "    xi (" << m_fv_feas.size() << "/" << m_K <<
-                        "), lambda (" << m_fv_relu.size() << "/" << m_L * m_n <<
-                        "), gamma (" << m_fv_rehu.size() << "/" << m_H * m_n << ")" << std::endl;
-                    cout << "    xi_pg = (" << xi_min_pg << ", " << xi_max_pg <<
-                        "), lambda_pg = (" << lambda_min_pg << ", " << lambda_max_pg <<
-                        "), gamma_pg = (" << gamma_min_pg << ", " << gamma_max_pg << ")" << std::endl;
-                }
             }
 
-            // If variable value or PG converges but not on all variables,
-            // use all variables in the next iteration
-            if ((vars_conv || pg_conv) && (!all_vars))
-            {
-                if (verbose)
-                {
-                    cout << "*** Iter " << i <<
-                        ", free variables converge; next test on all variables" << std::endl;
-                }
-                internal::reset_fv_set(m_fv_feas, m_K);
-                internal::reset_fv_set(m_fv_relu, m_L, m_n);
-                internal::reset_fv_set(m_fv_rehu, m_H, m_n);
-                xi_min_pg = lambda_min_pg = gamma_min_pg = Scalar(0);
-                xi_max_pg = lambda_max_pg = gamma_max_pg = Scalar(0);
-                // Also recompute beta to improve precision
-                // set_primal();
-                continue;
-            }
-            if (all_vars && (vars_conv || pg_conv))
+            if ((xi_diff < tol) && (beta_diff < tol))
                 break;
         }
 
@@ -744,48 +4037,43 @@ public:
     }
 
     Vector& get_beta_ref() { return m_beta; }
-    Vector& get_xi_ref() { return m_xi; }
+    Vector& get_xi_ref() { return m_constr.get_xi_ref(); }
     Matrix& get_Lambda_ref() { return m_Lambda; }
     Matrix& get_Gamma_ref() { return m_Gamma; }
 };
 
-// Main solver interface
-// template <typename Matrix = Eigen::MatrixXd, typename Index = int>
-template <typename DerivedMat, typename DerivedVec, typename Index = int>
-void rehline_solver(
+// Streaming solver interface
+// X is an n x d row-majored matrix of float (value_size = 4) or double (value_size = 8)
+// stored in the file "path" from byte "offset"
+template <typename DerivedMat, typename DerivedVec, typename Param, typename Index = int>
+void rehline_solver_stream(
     ReHLineResult<typename DerivedMat::PlainObject, Index>& result,
-    const Eigen::MatrixBase<DerivedMat>& X, const Eigen::MatrixBase<DerivedMat>& A,
-    const Eigen::MatrixBase<DerivedVec>& b,
-    const Eigen::MatrixBase<DerivedMat>& U, const Eigen::MatrixBase<DerivedMat>& V,
-    const Eigen::MatrixBase<DerivedMat>& S, const Eigen::MatrixBase<DerivedMat>& T, const Eigen::MatrixBase<DerivedMat>& Tau,
-    Index max_iter, typename DerivedMat::Scalar tol, Index shrink = 1,
-    Index verbose = 0, Index trace_freq = 100,
+    const std::string& path, std::streamoff offset, Index n, Index d, int value_size,
+    const Eigen::MatrixBase<DerivedMat>& A, const Eigen::MatrixBase<DerivedVec>& b,
+    const Param& U, const Param& V, const Param& S, const Param& T, const Param& Tau,
+    Index block_rows, Index max_iter, typename DerivedMat::Scalar tol, Index n_epochs = 1,
+    Index shrink = 1, Index verbose = 0, Index trace_freq = 100,
     std::ostream& cout = std::cout
 )
 {
-    // Create solver
-    ReHLineSolver<typename DerivedMat::PlainObject, Index> solver(X, U, V, S, T, Tau, A, b);
-
-    // Initialize parameters
-    solver.init_params();
-
-    // Main iterations
-    std::vector<typename DerivedMat::Scalar> dual_objfns;
-    std::vector<typename DerivedMat::Scalar> primal_objfns;
-    Index niter;
+    using Scalar = typename DerivedMat::Scalar;
+    internal::RowBlockReader<Scalar> reader(path, offset, n, d, value_size);
+    ReHLineStreamSolver<Scalar, Index> solver(reader, block_rows, U, V, S, T, Tau, A, b);
+    // As in internal::run_solver(), a positive shrink is also the seed
     if (shrink > 0)
-    {
         solver.set_seed(shrink);
-        niter = solver.solve(dual_objfns, primal_objfns, max_iter, tol, verbose, trace_freq, cout);
-    } else {
-        niter = solver.solve_vanilla(dual_objfns, primal_objfns, max_iter, tol, verbose, trace_freq, cout);
-    }
+    solver.set_shrink(shrink > 0);
+    solver.init_params();
+
+    std::vector<Scalar> dual_objfns;
+    std::vector<Scalar> primal_objfns;
+    const Index niter = solver.solve(dual_objfns, primal_objfns, max_iter, tol, n_epochs,
+                                     verbose, trace_freq, cout);
 
-    // Save result
     result.beta.swap(solver.get_beta_ref());
-    result.xi.swap(solver.get_xi_ref());
-    result.Lambda.swap(solver.get_Lambda_ref());
-    result.Gamma.swap(solver.get_Gamma_ref());
+    result.xi = solver.get_xi_ref();
+    result.Lambda = solver.get_Lambda_ref();
+    result.Gamma = solver.get_Gamma_ref();
     result.niter = niter;
     result.dual_objfns.swap(dual_objfns);
     result.primal_objfns.swap(primal_objfns);
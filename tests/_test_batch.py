@@ -0,0 +1,36 @@
+## Test the batched solver on simulated per-segment SVMs sharing one X
+import numpy as np
+from rehline import ReHLine_solver, ReHLine_batch_solver
+
+np.random.seed(1024)
+# simulate classification datasets of different sizes
+n, d, C = 5000, 5, 0.5
+X = np.random.randn(n, d)
+problems = []
+for k, n_k in enumerate([200, 5000, 1000, 50]):
+    beta0 = np.random.randn(d)
+    y = np.sign(X[:n_k].dot(beta0) + np.random.randn(n_k))
+    X_k = X if n_k == n else X[:n_k]
+    problems.append({'X': X_k, 'U': -C*y.reshape(1, -1), 'V': C*np.ones((1, n_k))})
+
+## solve the problems in one call, and one by one
+results = ReHLine_batch_solver(problems, tol=1e-6, n_jobs=3)
+for prob, result in zip(problems, results):
+    result_k = ReHLine_solver(prob['X'], prob['U'], prob['V'], tol=1e-6, verbose=0, fused=None)
+    print('n = %d, niter = %d, max abs difference: %.3e'
+          %(prob['X'].shape[0], result.niter, np.max(np.abs(result.beta - result_k.beta))))
+    assert np.max(np.abs(result.beta - result_k.beta)) < 1e-6
+
+## solve the SVMs of a grid of C on the same X and y together in lanes
+from rehline import ReHLine_lane_solver
+
+beta0 = np.random.randn(d)
+y = np.sign(X.dot(beta0) + np.random.randn(n))
+Cs = [0.05, 0.5, 5.]
+losses = [{'U': -C_k*y.reshape(1, -1), 'V': C_k*np.ones((1, n))} for C_k in Cs]
+results = ReHLine_lane_solver(X, losses, max_iter=100000, tol=1e-6)
+for C_k, loss, result in zip(Cs, losses, results):
+    result_k = ReHLine_solver(X, loss['U'], loss['V'], max_iter=100000, tol=1e-6, verbose=0)
+    print('lanes, C = %g, niter = %d, max abs difference: %.3e'
+          %(C_k, result.niter, np.max(np.abs(result.beta - result_k.beta))))
+    assert np.max(np.abs(result.beta - result_k.beta)) < 1e-4
@@ -0,0 +1,41 @@
+## Test distributed SVM with worker processes on simulated dataset
+import numpy as np
+from rehline import ReHLine, ReHLine_distributed
+
+if __name__ == '__main__':
+    np.random.seed(1024)
+    # simulate classification dataset
+    n, d, C = 3000, 5, 0.5
+    X = np.random.randn(n, d)
+    beta0 = np.random.randn(d)
+    y = np.sign(X.dot(beta0) + np.random.randn(n))
+
+    ## solution provided by ReHLine in a single process
+    clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6)
+    clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+    clf.fit(X=X)
+
+    ## solution provided by 3 workers, each owning 1000 samples
+    blocks = [{'X': X[k::3], 'U': clf.U[:, k::3], 'V': clf.V[:, k::3]} for k in range(3)]
+    for transport in ['tcp', 'unix']:
+        res = ReHLine_distributed(blocks, tol=1e-6, n_epochs=2, transport=transport, verbose=1)
+        print('solution privided by rehline (single): %s' %clf.coef_)
+        print('solution privided by rehline (%s, %d rounds): %s' %(transport, res.niter, res.beta))
+        assert np.max(np.abs(res.beta - clf.coef_)) < 1e-3
+
+    ## with the linear constraints A * beta + b >= 0, i.e., beta_0 >= 0.5 and beta_1 <= 0.2,
+    ## which are kept by the coordinator
+    A = np.zeros((2, d))
+    A[0, 0], A[1, 1] = 1., -1.
+    b = np.array([-.5, .2])
+    clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000, A=A, b=b)
+    clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+    clf.fit(X=X)
+    res = ReHLine_distributed(blocks, A=A, b=b, tol=1e-6, max_iter=100000)
+    infeas = max(0., -np.min(A.dot(res.beta) + b))
+    print('solution privided by rehline (single): %s' %clf.coef_)
+    print('solution privided by rehline (constrained, %d rounds): %s, infeas = %.2e'
+          %(res.niter, res.beta, infeas))
+    assert res.niter < 100000
+    assert infeas < 1e-6
+    assert np.max(np.abs(res.beta - clf.coef_)) < 1e-3
@@ -11,7 +11,7 @@ C = 0.5
 
 ## solution provided by ReHLine
 # build-in hinge loss for svm
-clf = ReHLine(loss={'name': 'svm'}, C=C)
+clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000)
 clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
 
 # specific the param of FairSVM
@@ -26,3 +26,5 @@ print('solution privided by rehline: %s' %clf.coef_)
 score = X@clf.coef_
 cor_sen = np.mean(score * X_sen)
 print('correlation btw score and X_sen is: %.3f' %cor_sen)
+# the fairness constraints |cor_sen| <= 0.01 hold up to the solver tolerance
+assert abs(cor_sen) <= .01 + 1e-4
@@ -0,0 +1,42 @@
+## Test the fused per-sample updates against the separate updates on simulated dataset
+import numpy as np
+from rehline import ReHLine_solver, relu, rehu
+
+np.random.seed(1024)
+# simulate regression dataset
+n, d, C = 2000, 5, 0.1
+X = np.random.randn(n, d)
+y = X.dot(np.random.randn(d)) + np.random.randn(n)
+
+def objfn(res, U, V, S, T, Tau):
+    score = X.dot(res.beta)
+    obj = 0.5*res.beta.dot(res.beta)
+    if U.shape[0] > 0:
+        obj += np.sum(relu(U*score + V))
+    if S.shape[0] > 0:
+        obj += np.sum(rehu(S*score + T, Tau))
+    return obj
+
+# L = 2 ReLU terms (check loss), H = 1 ReHU term (Huber-type loss), or both
+empty = np.empty(shape=(0, 0))
+U = np.vstack([-C*0.3*np.ones(n), C*0.7*np.ones(n)])
+V = np.vstack([C*0.3*y, -C*0.7*y])
+S = -np.sqrt(C)*np.ones((1, n))
+T = np.sqrt(C)*y.reshape(1, -1)
+Tau = np.ones((1, n))
+losses = {'L = 2': (U, V, empty, empty, empty),
+          'H = 1': (empty, empty, S, T, Tau),
+          'L = 2, H = 1': (U, V, S, T, Tau)}
+# A * beta + b >= 0, i.e., beta_0 >= 0.5 and beta_1 <= 0.2
+A = np.zeros((2, d))
+A[0, 0], A[1, 1] = 1., -1.
+b = np.array([-.5, .2])
+for name, (U_, V_, S_, T_, Tau_) in losses.items():
+    for constr in [False, True]:
+        A_, b_ = (A, b) if constr else (np.empty(shape=(0, d)), np.empty(shape=(0)))
+        res = [ReHLine_solver(X, U_, V_, Tau=Tau_, S=S_, T=T_, A=A_, b=b_, max_iter=100000,
+                              tol=1e-7, fused=fused, verbose=0) for fused in [False, True]]
+        obj = [objfn(r, U_, V_, S_, T_, Tau_) for r in res]
+        print('%s, constr = %s: objfn %.8f (separate), %.8f (fused)' %(name, constr, obj[0], obj[1]))
+        assert abs(obj[1] - obj[0]) <= 1e-6*abs(obj[0])
+        assert np.max(np.abs(res[1].beta - res[0].beta)) < 1e-3
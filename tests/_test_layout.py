@@ -0,0 +1,43 @@
+## Test the fits on data matrices of any memory layout on simulated dataset
+import numpy as np
+from scipy import sparse
+from rehline import ReHLine
+
+np.random.seed(1024)
+# simulate classification dataset
+n, d, C = 2000, 5, 0.5
+X_big = np.random.randn(2*n, 2*d)
+X = np.ascontiguousarray(X_big[::2, ::2])
+beta0 = np.random.randn(d)
+y = np.sign(X.dot(beta0) + np.random.randn(n))
+
+def fit(X, **kwargs):
+    clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000, **kwargs)
+    clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+    clf.fit(X=X)
+    return clf.coef_
+
+## solution provided by ReHLine on a C-ordered array
+sol = fit(X)
+
+## column-major and strided views are referenced in place, also in the strict mode
+views = {'column-major': np.asfortranarray(X),
+         'strided': X_big[::2, ::2],
+         'strided column-major': np.asfortranarray(X_big)[::2, ::2]}
+for name, Xv in views.items():
+    for strict in [False, True]:
+        sol_v = fit(Xv, strict=strict)
+        print('%s, strict = %s: max abs difference %.3e' %(name, strict, np.max(np.abs(sol_v - sol))))
+        assert np.max(np.abs(sol_v - sol)) < 1e-5
+
+## inputs that would be copied are rejected in the strict mode
+for name, Xc in {'int64': np.rint(10*X).astype(np.int64),
+                 'CSC': sparse.csc_matrix(X),
+                 'strided with x_storage': X_big[::2, ::2]}.items():
+    kwargs = {'x_storage': 'float32'} if name == 'strided with x_storage' else {}
+    try:
+        fit(Xc, strict=True, **kwargs)
+    except ValueError:
+        print('%s: rejected in the strict mode' %name)
+    else:
+        raise AssertionError('%s should be rejected in the strict mode' %name)
@@ -0,0 +1,46 @@
+## Test the fits on a data matrix stored on disk on simulated dataset
+import os
+import tempfile
+import numpy as np
+from rehline import ReHLine, load_memmap
+
+np.random.seed(1024)
+# simulate classification dataset
+n, d, C = 3000, 5, 0.5
+X = np.random.randn(n, d)
+beta0 = np.random.randn(d)
+y = np.sign(X.dot(beta0) + np.random.randn(n))
+
+## solution provided by ReHLine with X in memory
+clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000)
+clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+clf.fit(X=X)
+
+with tempfile.TemporaryDirectory() as tmpdir:
+    path = os.path.join(tmpdir, 'X.npy')
+    np.save(path, X)
+    X_map = load_memmap(path)
+
+    ## solution provided by ReHLine on the memory map, read in place, with the
+    ## samples visited in a full shuffle or in contiguous blocks of rows
+    for block_size in [0, 256]:
+        clf_map = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000,
+                          block_size=block_size)
+        clf_map.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+        clf_map.fit(X=X_map)
+        print('solution privided by rehline (memmap, block_size = %d): %s' %(block_size, clf_map.coef_))
+        if block_size == 0:
+            assert np.array_equal(clf_map.coef_, clf.coef_)
+        assert np.max(np.abs(clf_map.coef_ - clf.coef_)) < 1e-4
+
+    ## solution provided by the streaming solver, with and without shrinking
+    for shrink in [0, 1]:
+        clf_stream = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000,
+                             shrink=shrink, stream_rows=128)
+        clf_stream.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+        clf_stream.fit(X=X_map)
+        err = np.max(np.abs(clf_stream.coef_ - clf.coef_))
+        print('solution privided by rehline (in memory): %s' %clf.coef_)
+        print('solution privided by rehline (stream, shrink = %d): %s' %(shrink, clf_stream.coef_))
+        assert err < 1e-4
+    del X_map
@@ -0,0 +1,74 @@
+## Test the parallel updates against the sequential solver on simulated dataset
+import numpy as np
+from rehline import ReHLine
+
+np.random.seed(1024)
+# simulate classification dataset
+n, d, C = 5000, 10, 0.1
+X = np.random.randn(n, d)
+beta0 = np.random.randn(d)
+y = np.sign(X.dot(beta0) + np.random.randn(n))
+
+def objective(clf, X):
+    coef = clf.coef_
+    return np.sum(clf.call_ReLHLoss(X.dot(coef))) + 0.5*coef.dot(coef)
+
+## asynchronous (Hogwild-style) updates of a shared beta by 4 threads
+for loss in ['svm', 'sSVM']:
+    for fused in [False, True]:
+        clfs = []
+        for n_jobs in [1, 4]:
+            clf = ReHLine(loss={'name': loss}, C=C, tol=1e-6, max_iter=100000,
+                          fused=fused, n_jobs=n_jobs)
+            clf.make_ReLHLoss(X=X, y=y, loss={'name': loss})
+            clf.fit(X=X)
+            clfs.append(clf)
+        obj_seq, obj_async = objective(clfs[0], X), objective(clfs[1], X)
+        print('%s, fused = %s: objective %.6f (sequential), %.6f (async)'
+              %(loss, fused, obj_seq, obj_async))
+        assert abs(obj_async - obj_seq) <= 1e-4*obj_seq
+        assert np.max(np.abs(clfs[1].coef_ - clfs[0].coef_)) < 1e-2
+
+## synchronous parallel updates, with and without the linear constraints
+# A * beta + b >= 0, i.e., beta_0 >= 0.5 and beta_1 <= 0.2
+A = np.zeros((2, d))
+A[0, 0], A[1, 1] = 1., -1.
+b = np.array([-.5, .2])
+for loss in ['svm', 'sSVM']:
+    for constr in [False, True]:
+        for fused in [False, True]:
+            clfs = []
+            for n_jobs, sync in [(1, False), (4, True)]:
+                clf = ReHLine(loss={'name': loss}, C=C, tol=1e-6, max_iter=100000,
+                              fused=fused, n_jobs=n_jobs, sync=sync)
+                clf.make_ReLHLoss(X=X, y=y, loss={'name': loss})
+                if constr:
+                    clf.A, clf.b = A, b
+                clf.fit(X=X)
+                clfs.append(clf)
+            obj_seq, obj_sync = objective(clfs[0], X), objective(clfs[1], X)
+            infeas = -np.min(A.dot(clfs[1].coef_) + b) if constr else 0.
+            print('%s, constr = %s, fused = %s: objective %.6f (sequential), %.6f (sync), '
+                  'infeasibility %.2e' %(loss, constr, fused, obj_seq, obj_sync, infeas))
+            assert abs(obj_sync - obj_seq) <= 1e-4*obj_seq
+            assert np.max(np.abs(clfs[1].coef_ - clfs[0].coef_)) < 1e-2
+            assert infeas < 1e-4
+
+## concurrent fits from Python threads, which release the GIL in the solver
+from concurrent.futures import ThreadPoolExecutor
+
+def fit_C(C_k):
+    clf = ReHLine(loss={'name': 'svm'}, C=C_k, tol=1e-6, max_iter=100000)
+    clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+    clf.fit(X=X)
+    return clf.coef_
+
+Cs = [0.01, 0.1, 1., 10.]
+sols = [fit_C(C_k) for C_k in Cs]
+with ThreadPoolExecutor(max_workers=4) as pool:
+    sols_concurrent = list(pool.map(fit_C, Cs))
+for C_k, sol, sol_concurrent in zip(Cs, sols, sols_concurrent):
+    print('C = %g: max abs difference of the concurrent fit %.3e'
+          %(C_k, np.max(np.abs(sol_concurrent - sol))))
+    # Each fit has its own solver and seed, so the results are identical
+    assert np.array_equal(sol_concurrent, sol)
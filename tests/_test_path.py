@@ -0,0 +1,25 @@
+## Test the regularization path of a smoothed SVM against separate fits
+import numpy as np
+from rehline import ReHLine
+
+np.random.seed(1024)
+# simulate classification dataset
+n, d = 5000, 5
+X = np.random.randn(n, d)
+beta0 = np.random.randn(d)
+y = np.sign(X.dot(beta0) + np.random.randn(n))
+
+## fit the path of C in one call, warm-starting each C from the previous one
+Cs = np.logspace(-3, 0, 10)
+clf = ReHLine(loss={'name': 'sSVM'}, C=1., tol=1e-6)
+clf.make_ReLHLoss(X=X, y=y, loss={'name': 'sSVM'})
+coef_path = clf.fit_path(X, Cs)
+
+## fit each C from scratch
+for C, coef, niter in zip(Cs, coef_path, clf.n_iter_path_):
+    clf_C = ReHLine(loss={'name': 'sSVM'}, C=C, tol=1e-6)
+    clf_C.make_ReLHLoss(X=X, y=y, loss={'name': 'sSVM'})
+    clf_C.fit(X)
+    print('C = %.3e, niter = %d (from scratch: %d), max abs difference: %.3e'
+          %(C, niter, clf_C.n_iter_, np.max(np.abs(coef - clf_C.coef_))))
+    assert np.max(np.abs(coef - clf_C.coef_)) < 1e-4
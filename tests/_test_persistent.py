@@ -0,0 +1,78 @@
+## Test the refits of a persistent solver against fits from scratch
+import numpy as np
+from rehline import ReHLine_persistent, ReHLine_solver
+
+np.random.seed(1024)
+# simulate classification dataset
+n, d, C = 5000, 5, 0.01
+X = np.random.randn(n, d)
+beta0 = np.random.randn(d)
+y = np.sign(X.dot(beta0) + np.random.randn(n))
+
+## SVM: U = -C * y, V = C
+solver = ReHLine_persistent(X, U=-C*y.reshape(1, -1), V=C*np.ones((1, n)))
+niter = solver.solve(max_iter=10000, tol=1e-6)
+print('first fit, niter = %d' %niter)
+
+## flip 1% of the labels, and refit from the previous variables
+y[::100] = -y[::100]
+solver.set_loss(U=-C*y.reshape(1, -1))
+niter = solver.solve(max_iter=10000, tol=1e-6)
+res = ReHLine_solver(X, U=-C*y.reshape(1, -1), V=C*np.ones((1, n)), max_iter=10000, tol=1e-6, verbose=0)
+print('new labels, niter = %d (from scratch: %d), max abs difference: %.3e'
+      %(niter, res.niter, np.max(np.abs(solver.beta - res.beta))))
+assert np.max(np.abs(solver.beta - res.beta)) < 1e-4
+
+## drop 10% of the samples with zero weights
+w = np.ones(n)
+w[5::10] = 0.
+solver.set_sample_weight(w)
+niter = solver.solve(max_iter=10000, tol=1e-6)
+res = ReHLine_solver(X, U=-C*w*y.reshape(1, -1), V=C*w.reshape(1, -1), max_iter=10000, tol=1e-6, verbose=0)
+print('sample weights, niter = %d (from scratch: %d), max abs difference: %.3e'
+      %(niter, res.niter, np.max(np.abs(solver.beta - res.beta))))
+assert np.max(np.abs(solver.beta - res.beta)) < 1e-4
+
+## append new samples in batches, and refit from the current variables
+solver = ReHLine_persistent(X[:4000], U=-C*y[:4000].reshape(1, -1), V=C*np.ones((1, 4000)))
+solver.solve(max_iter=10000, tol=1e-6)
+for start in range(4000, n, 250):
+    Xb, yb = X[start:start+250], y[start:start+250]
+    solver.append(Xb, U=-C*yb.reshape(1, -1), V=C*np.ones((1, len(yb))))
+    niter = solver.solve(max_iter=10000, tol=1e-6)
+res = ReHLine_solver(X, U=-C*y.reshape(1, -1), V=C*np.ones((1, n)), max_iter=10000, tol=1e-6, verbose=0)
+print('appended samples, niter = %d (from scratch: %d), max abs difference: %.3e'
+      %(niter, res.niter, np.max(np.abs(solver.beta - res.beta))))
+assert np.max(np.abs(solver.beta - res.beta)) < 1e-4
+
+## slide a window of 4000 samples over the data, and refit from the current variables
+solver = ReHLine_persistent(X[:4000], U=-C*y[:4000].reshape(1, -1), V=C*np.ones((1, 4000)))
+solver.solve(max_iter=10000, tol=1e-6)
+for start in range(4000, n, 250):
+    Xb, yb = X[start:start+250], y[start:start+250]
+    solver.remove(np.arange(250))
+    solver.append(Xb, U=-C*yb.reshape(1, -1), V=C*np.ones((1, len(yb))))
+    niter = solver.solve(max_iter=10000, tol=1e-6)
+Xw, yw = X[n-4000:], y[n-4000:]
+res = ReHLine_solver(Xw, U=-C*yw.reshape(1, -1), V=C*np.ones((1, 4000)), max_iter=10000, tol=1e-6, verbose=0)
+print('sliding window, niter = %d (from scratch: %d), max abs difference: %.3e'
+      %(niter, res.niter, np.max(np.abs(solver.beta - res.beta))))
+assert np.max(np.abs(solver.beta - res.beta)) < 1e-4
+
+## approximate leave-one-out margins against refits without each sample
+m, C = 300, 0.5
+solver = ReHLine_persistent(X[:m], U=-C*y[:m].reshape(1, -1), V=C*np.ones((1, m)))
+solver.solve(max_iter=10000, tol=1e-8)
+idx = np.arange(0, m, 10)
+exact = np.zeros(len(idx))
+for j, i in enumerate(idx):
+    keep = np.arange(m) != i
+    res = ReHLine_solver(X[:m][keep], U=-C*y[:m][keep].reshape(1, -1), V=C*np.ones((1, m-1)),
+                         max_iter=10000, tol=1e-8, verbose=0)
+    exact[j] = X[i].dot(res.beta)
+beta, Lambda = solver.beta.copy(), solver.Lambda.copy()
+for n_passes in [0, 1, 10]:
+    loo = solver.loo_decision_function(idx, n_passes=n_passes)
+    assert np.array_equal(solver.beta, beta) and np.array_equal(solver.Lambda, Lambda)
+    print('leave-one-out, n_passes = %d, mean abs difference: %.3e, errors: %d (exact: %d)'
+          %(n_passes, np.mean(np.abs(loo - exact)), np.sum(y[idx]*loo <= 0), np.sum(y[idx]*exact <= 0)))
@@ -0,0 +1,49 @@
+## Test the planning of a custom loss with constant terms on simulated dataset
+import numpy as np
+from rehline import ReHLine
+
+np.random.seed(1024)
+# simulate classification dataset
+n, d, C = 1000, 3, 0.5
+X = np.random.randn(n, d)
+beta0 = np.random.randn(d)
+y = np.sign(X.dot(beta0) + np.random.randn(n))
+
+## SVM given as a custom loss with an extra zero ReLU term and an extra
+## ReHU term with Tau = 0, both of which are constant
+U = np.vstack([-C*y, np.zeros(n)])
+V = np.vstack([C*np.ones(n), np.ones(n)])
+S = np.ones((1, n))
+T = np.ones((1, n))
+Tau = np.zeros((1, n))
+clf = ReHLine(loss={'name': 'custom'}, C=C, tol=1e-6, U=U, V=V, S=S, T=T, Tau=Tau)
+clf.fit(X=X)
+print('plan: %s' %clf.plan_)
+
+## solution provided by ReHLine with the SVM loss
+clf_svm = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6)
+clf_svm.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+clf_svm.fit(X=X)
+
+print('solution privided by rehline (custom): %s' %clf.coef_)
+print('solution privided by rehline (svm): %s' %clf_svm.coef_)
+print('max abs difference: %.3e' %np.max(np.abs(clf.coef_ - clf_svm.coef_)))
+assert np.max(np.abs(clf.coef_ - clf_svm.coef_)) < 1e-4
+
+## dead coordinates: the samples with zero weight (u_li = 0) or a zero row of X have
+## no effect on beta, so the fit must match the fit without these samples
+sample_weight = np.ones(n)
+sample_weight[::7] = 0.
+X_dead = X.copy()
+X_dead[3::11] = 0.
+keep = (sample_weight > 0) & np.any(X_dead != 0, axis=1)
+for fused in [False, True]:
+    clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000, fused=fused)
+    clf.make_ReLHLoss(X=X_dead, y=y, loss={'name': 'svm'})
+    clf.fit(X=X_dead, sample_weight=sample_weight)
+    clf_kept = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000, fused=fused)
+    clf_kept.make_ReLHLoss(X=X[keep], y=y[keep], loss={'name': 'svm'})
+    clf_kept.fit(X=X[keep])
+    print('fused = %s, max abs difference with %d dead samples: %.3e'
+          %(fused, n - keep.sum(), np.max(np.abs(clf.coef_ - clf_kept.coef_))))
+    assert np.max(np.abs(clf.coef_ - clf_kept.coef_)) < 1e-4
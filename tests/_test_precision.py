@@ -0,0 +1,53 @@
+## Test the solvers in lower precisions against double precision on simulated dataset
+import numpy as np
+from rehline import ReHLine
+
+np.random.seed(1024)
+# simulate classification dataset
+n, d, C = 5000, 10, 0.5
+X = np.random.randn(n, d)
+beta0 = np.random.randn(d)
+y = np.sign(X.dot(beta0) + np.random.randn(n))
+
+def objective(clf, coef):
+    # Evaluated in double precision on the original X
+    coef = np.asarray(coef, dtype=np.float64)
+    return np.sum(clf.call_ReLHLoss(X.dot(coef))) + 0.5*coef.dot(coef)
+
+clfs = {}
+for loss in ['svm', 'sSVM']:
+    clf = ReHLine(loss={'name': loss}, C=C, tol=1e-6, max_iter=100000)
+    clf.make_ReLHLoss(X=X, y=y, loss={'name': loss})
+    clf.fit(X=X)
+    clfs[loss] = clf
+
+## single precision: a float32 X is solved in float32
+for loss, clf in clfs.items():
+    clf32 = ReHLine(loss={'name': loss}, C=C, tol=1e-4, max_iter=100000)
+    clf32.make_ReLHLoss(X=X, y=y, loss={'name': loss})
+    clf32.fit(X=X.astype(np.float32))
+    obj, obj32 = objective(clf, clf.coef_), objective(clf, clf32.coef_)
+    print('%s: objective %.6f (float64), %.6f (float32)' %(loss, obj, obj32))
+    assert clf32.coef_.dtype == np.float32
+    assert abs(obj32 - obj) <= 1e-4*obj
+    assert np.max(np.abs(clf32.coef_ - clf.coef_)) < 1e-2
+
+## X stored in a lower precision, with beta and the dual variables in double
+for loss, clf in clfs.items():
+    # float32 storage solves the problem of the rounded X exactly
+    clf_r = ReHLine(loss={'name': loss}, C=C, tol=1e-6, max_iter=100000)
+    clf_r.make_ReLHLoss(X=X, y=y, loss={'name': loss})
+    clf_r.fit(X=X.astype(np.float32).astype(np.float64))
+    for x_storage in ['float32', 'bfloat16', 'int8']:
+        clf_q = ReHLine(loss={'name': loss}, C=C, tol=1e-6, max_iter=100000, x_storage=x_storage)
+        clf_q.make_ReLHLoss(X=X, y=y, loss={'name': loss})
+        clf_q.fit(X=X)
+        obj, obj_q = objective(clf, clf.coef_), objective(clf, clf_q.coef_)
+        print('%s, x_storage = %s: objective %.6f (float64), %.6f (quantized)'
+              %(loss, x_storage, obj, obj_q))
+        assert clf_q.coef_.dtype == np.float64
+        # The quantization error of X is about 2^-8 for bfloat16 and 2^-8 of the
+        # largest entry of each row for int8
+        assert abs(obj_q - obj) <= 1e-2*obj
+        if x_storage == 'float32':
+            assert np.max(np.abs(clf_q.coef_ - clf_r.coef_)) < 1e-6
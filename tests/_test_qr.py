@@ -0,0 +1,30 @@
+## Test multi-quantile regression on simulated dataset
+import numpy as np
+from rehline import ReHLine
+
+np.random.seed(1024)
+# simulate regression dataset
+n, d, C = 1000, 5, 0.5
+X = np.random.randn(n, d)
+beta0 = np.random.randn(d)
+y = X.dot(beta0) + np.random.randn(n)
+loss = {'name': 'QR', 'qt': [.1, .5, .9]}
+
+## solution provided by ReHLine on the implicit design
+clf = ReHLine(loss=loss, C=C, tol=1e-6)
+X_qr = clf.make_ReLHLoss(X=X, y=y, loss=loss)
+clf.fit(X=X_qr)
+sol_implicit = clf.coef_
+
+## solution provided by ReHLine on the materialized design
+clf_fake = ReHLine(loss=loss, C=C, tol=1e-6)
+clf_fake.make_ReLHLoss(X=X, y=y, loss=loss)
+clf_fake.fit(X=X_qr.toarray())
+sol_fake = clf_fake.coef_
+
+print('solution privided by rehline (implicit): %s' %sol_implicit)
+print('solution privided by rehline (materialized): %s' %sol_fake)
+print('max abs difference: %.3e' %np.max(np.abs(sol_implicit - sol_fake)))
+print(clf.decision_function(X_qr)[::n][:3])
+assert np.max(np.abs(sol_implicit - sol_fake)) < 1e-4
+assert np.allclose(clf.decision_function(X_qr), X_qr.toarray() @ sol_implicit)
@@ -0,0 +1,30 @@
+## Test SVM on simulated sparse dataset
+import numpy as np
+from scipy import sparse
+from rehline import ReHLine
+
+np.random.seed(1024)
+# simulate classification dataset
+n, d, C = 1000, 50, 0.5
+X = sparse.random(n, d, density=0.05, format='csr', random_state=1024)
+beta0 = np.random.randn(d)
+y = np.sign(X @ beta0 + .1*np.random.randn(n))
+
+## solution provided by ReHLine on the dense matrix
+clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6)
+clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+clf.fit(X=X.toarray())
+sol_dense = clf.coef_
+
+## solution provided by ReHLine on the CSR matrix
+clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6)
+clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+clf.fit(X=X)
+sol_sparse = clf.coef_
+
+print('solution privided by rehline (dense): %s' %sol_dense[:5])
+print('solution privided by rehline (sparse): %s' %sol_sparse[:5])
+print('max abs difference: %.3e' %np.max(np.abs(sol_dense - sol_sparse)))
+print(clf.decision_function(X[:3]))
+assert np.max(np.abs(sol_dense - sol_sparse)) < 1e-4
+assert np.allclose(clf.decision_function(X[:3]), X[:3] @ sol_sparse)
@@ -20,12 +20,16 @@ print('solution privided by liblinear: %s' %sol)
 
 ## solution provided by ReHLine
 # build-in loss
-clf = ReHLine(loss={'name': 'svm'}, C=C)
+clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000)
 clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
 clf.fit(X=X)
+sol_builtin = clf.coef_
 
 print('solution privided by rehline: %s' %clf.coef_)
 print(clf.decision_function([[.1,.2,.3]]))
+obj = [np.sum(clf.call_ReLHLoss(X.dot(coef))) + 0.5*coef.dot(coef) for coef in (sol, clf.coef_)]
+assert obj[1] <= obj[0] + 1e-4*obj[0]
+assert np.max(np.abs(clf.coef_ - sol)) < 1e-2
 
 # manually specify params
 n, d = X.shape
@@ -33,9 +37,104 @@ U = -(C*y).reshape(1,-1)
 L = U.shape[0]
 V = (C*np.array(np.ones(n))).reshape(1,-1)
 
-clf = ReHLine(loss={'name': 'svm'}, C=C)
+clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000)
 clf.U, clf.V = U, V
 clf.fit(X=X)
 
 print('solution privided by rehline: %s' %clf.coef_)
-print(clf.decision_function([[.1,.2,.3]]))
\ No newline at end of file
+print(clf.decision_function([[.1,.2,.3]]))
+assert np.max(np.abs(clf.coef_ - sol_builtin)) < 1e-4
+assert np.allclose(clf.decision_function([[.1,.2,.3]]), np.dot([.1,.2,.3], clf.coef_))
+
+## L1 penalty: append_l1() after make_ReLHLoss(), against the l1_pen of the solver
+lam1 = 1.0
+for name in ['svm', 'sSVM', 'huber']:
+    loss = {'name': name, 'tau': 1.0} if name == 'huber' else {'name': name}
+    yl = X.dot(beta0) + np.random.randn(n) if name == 'huber' else y
+    clf = ReHLine(loss=loss, C=C, tol=1e-6, max_iter=100000)
+    clf.make_ReLHLoss(X=X, y=yl, loss=loss)
+    X_fake = clf.append_l1(X, l1_pen=lam1)
+    clf.fit(X=X_fake)
+    clf_l1 = ReHLine(loss=loss, C=C, tol=1e-6, max_iter=100000, l1_pen=lam1)
+    clf_l1.make_ReLHLoss(X=X, y=yl, loss=loss)
+    clf_l1.fit(X=X)
+    print('%s with append_l1: %s, with l1_pen: %s' %(name, clf.coef_, clf_l1.coef_))
+    assert np.max(np.abs(clf.coef_ - clf_l1.coef_)) < 1e-3
+
+## a large L1 penalty, which soft-thresholds beta to zero in the first sweep
+## although the solution is not zero
+lam1 = 5.0
+for name in ['svm', 'sSVM']:
+    clf = ReHLine(loss={'name': name}, C=C, tol=1e-6, max_iter=100000)
+    clf.make_ReLHLoss(X=X, y=y, loss={'name': name})
+    clf.fit(X=clf.append_l1(X, l1_pen=lam1))
+    for shrink in [0, 1]:
+        clf_l1 = ReHLine(loss={'name': name}, C=C, tol=1e-6, max_iter=100000, shrink=shrink, l1_pen=lam1)
+        clf_l1.make_ReLHLoss(X=X, y=y, loss={'name': name})
+        clf_l1.fit(X=X)
+        obj = [np.sum(clf_l1.call_ReLHLoss(X.dot(coef))) + 0.5*coef.dot(coef) + lam1*np.sum(np.abs(coef))
+               for coef in (clf.coef_, clf_l1.coef_)]
+        print('%s with l1_pen = %.1f, shrink = %d: niter %d, objfn %.4f (append_l1: %.4f)'
+              %(name, lam1, shrink, clf_l1.n_iter_, obj[1], obj[0]))
+        assert np.any(clf_l1.coef_ != 0) and obj[1] <= obj[0] + 1e-2 * abs(obj[0])
+
+## single precision: the gap-safe screening in the shrinking solver must not
+## change the solution of the solver without shrinking (and screening)
+from rehline import ReHLine_solver
+
+def svm_objfn(X, y, C, beta):
+    beta = beta.astype(np.float64)
+    return C*np.maximum(0., 1. - y*X.astype(np.float64).dot(beta)).sum() + 0.5*beta.dot(beta)
+
+np.random.seed(2)
+n, d, C = 100000, 5, 0.01
+X = np.random.randn(n, d).astype(np.float32)
+y = np.sign(X.dot(np.random.randn(d)) + np.random.randn(n))
+U, V = -C*y.reshape(1, -1), C*np.ones((1, n))
+res0 = ReHLine_solver(X, U, V, max_iter=10000, tol=1e-5, shrink=0, verbose=0)
+obj0 = svm_objfn(X, y, C, res0.beta)
+for tol in [1e-5, 1e-3]:
+    res = ReHLine_solver(X, U, V, max_iter=10000, tol=tol, shrink=1, verbose=0)
+    obj = svm_objfn(X, y, C, res.beta)
+    print('float32, tol = %.0e: objfn %.4f, without shrinking %.4f' %(tol, obj, obj0))
+    assert obj <= obj0 + 1e-3 * abs(obj0)
+
+## the fused updates visit all coordinates of a sample, so the screening fixes whole
+## samples only; the solution must match the one without screening
+np.random.seed(3)
+n, d, C = 20000, 10, 0.01
+X = np.random.randn(n, d)
+y = X[:, 0] + np.random.randn(n)
+# two ReLU terms per sample, as in quantile regression, and a ReHU term
+U = np.vstack([-C*0.3*np.ones(n), C*0.7*np.ones(n)])
+V = np.vstack([C*0.3*y, -C*0.7*y])
+S, T, Tau = -np.sqrt(C)*np.ones((1, n)), np.sqrt(C)*(y - .5).reshape(1, -1), np.ones((1, n))
+res = [ReHLine_solver(X, U, V, Tau=Tau, S=S, T=T, max_iter=100000, tol=1e-7, fused=True,
+                      verbose=0, screening=screening) for screening in [False, True]]
+print('fused, screening off/on: beta %s / %s' %(res[0].beta, res[1].beta))
+assert np.max(np.abs(res[1].beta - res[0].beta)) < 1e-4
+
+## warm start: refit after a few labels change, from the previous solution
+np.random.seed(4)
+n, d, C = 5000, 5, 0.5
+X = np.random.randn(n, d)
+y = np.sign(X.dot(np.random.randn(d)) + np.random.randn(n))
+clf = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000)
+clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+clf.fit(X=X)
+y[:50] = -y[:50]
+clf.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+clf.fit(X=X, warm_start=True)
+clf_cold = ReHLine(loss={'name': 'svm'}, C=C, tol=1e-6, max_iter=100000)
+clf_cold.make_ReLHLoss(X=X, y=y, loss={'name': 'svm'})
+clf_cold.fit(X=X)
+print('warm start: niter %d (cold start: %d), max abs difference %.3e'
+      %(clf.n_iter_, clf_cold.n_iter_, np.max(np.abs(clf.coef_ - clf_cold.coef_))))
+assert np.max(np.abs(clf.coef_ - clf_cold.coef_)) < 1e-4
+
+# ReHLine_solver warm-started from a previous result
+U, V = -C*y.reshape(1, -1), C*np.ones((1, n))
+res_cold = ReHLine_solver(X, U, V, max_iter=100000, tol=1e-6, verbose=0)
+res_warm = ReHLine_solver(X, U, V, max_iter=100000, tol=1e-6, verbose=0, warm_start=res_cold)
+print('warm start from the solution: niter %d' %res_warm.niter)
+assert np.max(np.abs(res_warm.beta - res_cold.beta)) < 1e-4